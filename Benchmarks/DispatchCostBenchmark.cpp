@@ -0,0 +1,1808 @@
+// DispatchCostBenchmark.cpp
+
+// Conceptual Description:
+// Every example in this project is built on virtual interfaces: decorators wrap a Component*, Sorter calls through a
+// SortStrategy, iterators are walked with four virtual calls per element, TCPConnection forwards every event to a TCPState,
+// factories hand back a std::unique_ptr<Shape>, Car owns its Engine through a pointer and BetterFilter asks an
+// ISpecification about every product. This file measures what that costs once the collections get large.
+//
+// For each module the same workload is run five ways:
+//  - virtual           the design from the example file, including its incidental costs
+//                      (per-traversal iterator allocation, string lookup in the factory, by-value item copies in BetterFilter).
+//  - template          the concrete type is resolved by a compile-time generated dispatcher (StaticKinds::Dispatch)
+//                      and the call is inlined; objects are plain values with no vtable.
+//  - variant           objects are stored by value in a std::variant and called through std::visit.
+//  - function_pointer  objects carry a hand-written function pointer instead of a vtable pointer.
+//  - batched           objects are segregated by type up front and each group is processed by its own monomorphic loop.
+// The State module adds a virtual_flyweight row that keeps the virtual calls but shares state objects instead of
+// allocating a new one on every transition, so the two costs of TCPConnection can be told apart.
+//
+// Every variant of a module computes the same checksum from the same input, and a mismatch fails the run,
+// so a faster row can never be faster because it skipped work.
+//
+// Output:
+//  - A table with ns/op, instructions/op and branch-misses/op (hardware counters via perf_event_open on Linux;
+//    reported as null where the counters are unavailable) and the speed-up over the virtual row.
+//  - A JSON file with the same rows, so runs can be diffed to catch regressions. With --json - the JSON goes to stdout
+//    and the table to stderr. Bad options and a report that cannot be written exit with status 2.
+//
+// Usage:
+//  DispatchCostBenchmark [--sizes 1024,65536,1048576] [--min-ms 100] [--trials 3]
+//                        [--modules decorator,strategy,...] [--json dispatch_cost.json | --json -]
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Measurement infrastructure
+
+// Stops the compiler from caching memory across benchmark passes, so every pass really re-reads its data.
+inline void ClobberMemory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct CounterSample
+{
+    bool valid = false;
+    std::uint64_t instructions = 0;
+    std::uint64_t branch_misses = 0;
+};
+
+// Counts user-space instructions and branch misses for the calling thread.
+// Both counters are opened as one group so they are always scheduled together; if the kernel multiplexes the
+// group the counts are scaled by enabled/running time. Where perf_event_open is missing or not permitted
+// (non-Linux, containers, perf_event_paranoid) Available() is false and every sample is invalid.
+class PerfCounters
+{
+public:
+    PerfCounters()
+    {
+#if defined(__linux__)
+        leader_ = Open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+        if (leader_ >= 0) {
+            branch_misses_ = Open(PERF_COUNT_HW_BRANCH_MISSES, leader_);
+            if (branch_misses_ < 0) {
+                close(leader_);
+                leader_ = -1;
+            }
+        }
+#endif
+    }
+
+    ~PerfCounters()
+    {
+#if defined(__linux__)
+        if (branch_misses_ >= 0) close(branch_misses_);
+        if (leader_ >= 0) close(leader_);
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool Available() const { return leader_ >= 0; }
+
+    void Start()
+    {
+#if defined(__linux__)
+        if (!Available()) return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    CounterSample Stop()
+    {
+        CounterSample sample;
+#if defined(__linux__)
+        if (!Available()) return sample;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        struct
+        {
+            std::uint64_t count;
+            std::uint64_t time_enabled;
+            std::uint64_t time_running;
+            std::uint64_t values[2];
+        } data{};
+        if (read(leader_, &data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data.count != 2 || data.time_running == 0) {
+            return sample;
+        }
+        const double scale = static_cast<double>(data.time_enabled) / static_cast<double>(data.time_running);
+        sample.valid = true;
+        sample.instructions = static_cast<std::uint64_t>(static_cast<double>(data.values[0]) * scale);
+        sample.branch_misses = static_cast<std::uint64_t>(static_cast<double>(data.values[1]) * scale);
+#endif
+        return sample;
+    }
+
+private:
+#if defined(__linux__)
+    static int Open(std::uint64_t config, int group)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = group < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+
+    int leader_ = -1;
+    int branch_misses_ = -1;
+};
+
+struct BenchmarkOptions
+{
+    std::vector<std::size_t> sizes{ 1024, 65536, 1048576 };
+    std::vector<std::string> modules;   // empty means all
+    double min_time_ms = 100.0;
+    int trials = 3;
+    std::string json_path = "dispatch_cost.json";
+};
+
+struct Measurement
+{
+    std::string module;
+    std::string variant;
+    std::size_t working_set = 0;
+    std::uint64_t ops = 0;
+    double ns_per_op = 0.0;
+    CounterSample counters;
+    std::uint64_t checksum = 0;
+    bool checksum_ok = true;
+    double speedup = 1.0;   // relative to the module's virtual row at the same working set
+};
+
+// Runs kernels and collects one Measurement per (module, variant, working set).
+// A kernel performs one pass over its working set and returns a checksum of what it computed.
+// The first pass is a warm-up whose duration decides how many passes make up a trial; the fastest of
+// options.trials trials is reported, and the warm-up checksum is compared with the module's first row.
+class BenchmarkRunner
+{
+public:
+    // The table goes to stderr when the JSON report goes to stdout, so the report can be piped.
+    explicit BenchmarkRunner(BenchmarkOptions options)
+        : options_(std::move(options)), table_(options_.json_path == "-" ? stderr : stdout) {}
+
+    const BenchmarkOptions& Options() const { return options_; }
+    bool CountersAvailable() const { return counters_.Available(); }
+    const std::vector<Measurement>& Results() const { return results_; }
+
+    bool AllChecksumsAgree() const
+    {
+        return std::all_of(results_.begin(), results_.end(), [](const Measurement& m) { return m.checksum_ok; });
+    }
+
+    template <typename Kernel>
+    void Run(const std::string& module, const std::string& variant, std::size_t working_set, std::uint64_t ops_per_pass, Kernel&& kernel)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const auto warm_start = Clock::now();
+        const std::uint64_t checksum = kernel();
+        ClobberMemory();
+        const double warm_ns = std::max(1.0, static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - warm_start).count()));
+        const std::uint64_t passes = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(options_.min_time_ms * 1e6 / warm_ns)));
+
+        Measurement best;
+        best.module = module;
+        best.variant = variant;
+        best.working_set = working_set;
+        best.ops = passes * ops_per_pass;
+        best.ns_per_op = std::numeric_limits<double>::infinity();
+        best.checksum = checksum;
+
+        for (int trial = 0; trial < options_.trials; ++trial) {
+            std::uint64_t total = 0;
+            counters_.Start();
+            const auto start = Clock::now();
+            for (std::uint64_t pass = 0; pass < passes; ++pass) {
+                total += kernel();
+                ClobberMemory();
+            }
+            const auto stop = Clock::now();
+            const CounterSample sample = counters_.Stop();
+            sink_ = total;
+
+            const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+            const double ns_per_op = ns / static_cast<double>(best.ops);
+            if (ns_per_op < best.ns_per_op) {
+                best.ns_per_op = ns_per_op;
+                best.counters = sample;
+            }
+        }
+
+        const auto key = std::make_pair(module, working_set);
+        const auto reference = references_.find(key);
+        if (reference == references_.end()) {
+            references_.emplace(key, best);
+        }
+        else {
+            best.checksum_ok = best.checksum == reference->second.checksum;
+            best.speedup = reference->second.ns_per_op / best.ns_per_op;
+        }
+
+        PrintRow(best);
+        results_.push_back(std::move(best));
+    }
+
+    std::FILE* Table() const { return table_; }
+
+    void PrintHeader() const
+    {
+        std::fprintf(table_, "%-10s %-18s %10s %10s %10s %10s %8s\n", "module", "variant", "elements", "ns/op", "instr/op", "brmiss/op", "speedup");
+    }
+
+    void WriteJson(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "  \"benchmark\": \"dispatch_cost\",\n";
+        out << "  \"compiler\": \"" << CompilerName() << "\",\n";
+        out << "  \"perf_counters\": " << (counters_.Available() ? "true" : "false") << ",\n";
+        out << "  \"min_time_ms\": " << options_.min_time_ms << ",\n";
+        out << "  \"trials\": " << options_.trials << ",\n";
+        out << "  \"results\": [\n";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Measurement& m = results_[i];
+            out << "    {\"module\": \"" << m.module << "\", \"variant\": \"" << m.variant << "\""
+                << ", \"working_set\": " << m.working_set
+                << ", \"ops\": " << m.ops
+                << ", \"ns_per_op\": " << Number(m.ns_per_op)
+                << ", \"instructions_per_op\": " << PerOp(m, m.counters.instructions)
+                << ", \"branch_misses_per_op\": " << PerOp(m, m.counters.branch_misses)
+                << ", \"speedup_vs_virtual\": " << Number(m.speedup)
+                << ", \"checksum\": " << m.checksum
+                << ", \"checksum_ok\": " << (m.checksum_ok ? "true" : "false") << "}"
+                << (i + 1 < results_.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+private:
+    static std::string Number(double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.4f", value);
+        return buffer;
+    }
+
+    static std::string PerOp(const Measurement& m, std::uint64_t count)
+    {
+        if (!m.counters.valid) return "null";
+        return Number(static_cast<double>(count) / static_cast<double>(m.ops));
+    }
+
+    static std::string CompilerName()
+    {
+#if defined(__clang__)
+        return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+        return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    void PrintRow(const Measurement& m) const
+    {
+        const std::string instructions = PerOp(m, m.counters.instructions);
+        const std::string misses = PerOp(m, m.counters.branch_misses);
+        std::fprintf(table_, "%-10s %-18s %10zu %10.2f %10s %10s %7.2fx%s\n",
+            m.module.c_str(), m.variant.c_str(), m.working_set, m.ns_per_op,
+            m.counters.valid ? instructions.c_str() : "-", m.counters.valid ? misses.c_str() : "-",
+            m.speedup, m.checksum_ok ? "" : "  CHECKSUM MISMATCH");
+        std::fflush(table_);
+    }
+
+    BenchmarkOptions options_;
+    std::FILE* table_;
+    PerfCounters counters_;
+    std::vector<Measurement> results_;
+    std::map<std::pair<std::string, std::size_t>, Measurement> references_;
+    volatile std::uint64_t sink_ = 0;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Compile-time dispatch over a closed set of types
+
+template <typename T>
+struct TypeTag
+{
+    using type = T;
+};
+
+// A closed list of concrete types. Dispatch(kind, f) calls f(TypeTag<T>{}) for the kind-th type through a chain of
+// compares the compiler can see through, so f's body is inlined once per type and no indirect call is left.
+template <typename... Ts>
+class StaticKinds
+{
+public:
+    static constexpr std::size_t count = sizeof...(Ts);
+    using Variant = std::variant<Ts...>;
+
+    template <typename F>
+    static decltype(auto) Dispatch(std::size_t kind, F&& f)
+    {
+        return DispatchFrom<0, Ts...>(kind, f);
+    }
+
+    // Calls f(TypeTag<T>{}, index) for every type in order.
+    template <typename F>
+    static void ForEach(F&& f)
+    {
+        ForEachIndexed(f, std::index_sequence_for<Ts...>{});
+    }
+
+private:
+    template <std::size_t I, typename First, typename... Rest, typename F>
+    static decltype(auto) DispatchFrom(std::size_t kind, F& f)
+    {
+        if constexpr (sizeof...(Rest) == 0) {
+            return f(TypeTag<First>{});
+        }
+        else {
+            if (kind == I) return f(TypeTag<First>{});
+            return DispatchFrom<I + 1, Rest...>(kind, f);
+        }
+    }
+
+    template <typename F, std::size_t... I>
+    static void ForEachIndexed(F& f, std::index_sequence<I...>)
+    {
+        (f(TypeTag<Ts>{}, I), ...);
+    }
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Shared workload generation. Every variant of a module is built from the same kinds and values.
+
+std::vector<std::uint8_t> RandomKinds(std::size_t n, std::size_t kind_count, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(kind_count) - 1);
+    std::vector<std::uint8_t> kinds(n);
+    for (auto& kind : kinds) kind = static_cast<std::uint8_t>(pick(rng));
+    return kinds;
+}
+
+std::vector<unsigned> RandomValues(std::size_t n, unsigned bound, std::uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<unsigned> pick(1, bound);
+    std::vector<unsigned> values(n);
+    for (auto& value : values) value = pick(rng);
+    return values;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Decorator (DecoratorExample.cpp)
+
+namespace decorator
+{
+    // The classes from DecoratorExample.cpp, with Operation() returning a value instead of printing it.
+    class Component {
+    public:
+        virtual ~Component() = default;
+        virtual unsigned Operation() const = 0;
+    };
+
+    class ConcreteComponent : public Component {
+        unsigned value_;
+    public:
+        explicit ConcreteComponent(unsigned value) : value_(value) {}
+        unsigned Operation() const override { return value_; }
+    };
+
+    class Decorator : public Component {
+    protected:
+        Component* component_;
+    public:
+        Decorator(Component* component) : component_(component) {}
+        unsigned Operation() const override { return component_->Operation(); }
+    };
+
+    class ConcreteDecoratorA : public Decorator {
+    public:
+        ConcreteDecoratorA(Component* component) : Decorator(component) {}
+        unsigned Operation() const override { return Decorator::Operation() * 3u + 1u; }
+    };
+
+    class ConcreteDecoratorB : public Decorator {
+    public:
+        ConcreteDecoratorB(Component* component) : Decorator(component) {}
+        unsigned Operation() const override { return Decorator::Operation() ^ 0x5bd1e995u; }
+    };
+
+    // The same decorators composed at compile time: each wrapper holds what it decorates by value.
+    struct Plain {
+        unsigned value;
+        explicit Plain(unsigned v) : value(v) {}
+        unsigned Operation() const { return value; }
+    };
+
+    template <typename Inner>
+    struct WithA {
+        Inner inner;
+        explicit WithA(unsigned v) : inner(v) {}
+        unsigned Operation() const { return inner.Operation() * 3u + 1u; }
+    };
+
+    template <typename Inner>
+    struct WithB {
+        Inner inner;
+        explicit WithB(unsigned v) : inner(v) {}
+        unsigned Operation() const { return inner.Operation() ^ 0x5bd1e995u; }
+    };
+
+    // Kind 0 is a bare component, 1 and 2 are singly decorated, 3 is B(A(component)).
+    using Kinds = StaticKinds<Plain, WithA<Plain>, WithB<Plain>, WithB<WithA<Plain>>>;
+
+    template <typename T>
+    unsigned Invoke(unsigned value) { return T(value).Operation(); }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const auto kinds = RandomKinds(n, Kinds::count, 0xdec0 + n);
+        const auto values = RandomValues(n, 1u << 30, 0xdec1 + n);
+
+        {
+            std::vector<std::unique_ptr<Component>> nodes;
+            std::vector<const Component*> items;
+            items.reserve(n);
+            auto own = [&](std::unique_ptr<Component> node) {
+                nodes.push_back(std::move(node));
+                return nodes.back().get();
+            };
+            for (std::size_t i = 0; i < n; ++i) {
+                Component* c = own(std::make_unique<ConcreteComponent>(values[i]));
+                switch (kinds[i]) {
+                case 1: c = own(std::make_unique<ConcreteDecoratorA>(c)); break;
+                case 2: c = own(std::make_unique<ConcreteDecoratorB>(c)); break;
+                case 3: c = own(std::make_unique<ConcreteDecoratorB>(own(std::make_unique<ConcreteDecoratorA>(c)))); break;
+                default: break;
+                }
+                items.push_back(c);
+            }
+            runner.Run("decorator", "virtual", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const Component* c : items) sum += c->Operation();
+                return sum;
+            });
+        }
+        {
+            struct Tagged { std::uint8_t kind; unsigned value; };
+            std::vector<Tagged> items(n);
+            for (std::size_t i = 0; i < n; ++i) items[i] = { kinds[i], values[i] };
+            runner.Run("decorator", "template", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const Tagged& item : items) {
+                    sum += Kinds::Dispatch(item.kind, [&](auto tag) {
+                        using T = typename decltype(tag)::type;
+                        return T(item.value).Operation();
+                    });
+                }
+                return sum;
+            });
+        }
+        {
+            std::vector<Kinds::Variant> items;
+            items.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    items.emplace_back(std::in_place_type<T>, values[i]);
+                });
+            }
+            runner.Run("decorator", "variant", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const auto& item : items) sum += std::visit([](const auto& c) { return c.Operation(); }, item);
+                return sum;
+            });
+        }
+        {
+            struct Bound { unsigned (*operation)(unsigned); unsigned value; };
+            std::vector<Bound> items(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                auto operation = Kinds::Dispatch(kinds[i], [](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return &Invoke<T>;
+                });
+                items[i] = { operation, values[i] };
+            }
+            runner.Run("decorator", "function_pointer", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const Bound& item : items) sum += item.operation(item.value);
+                return sum;
+            });
+        }
+        {
+            std::array<std::vector<unsigned>, Kinds::count> batches;
+            for (std::size_t i = 0; i < n; ++i) batches[kinds[i]].push_back(values[i]);
+            runner.Run("decorator", "batched", n, n, [&] {
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (unsigned value : batches[kind]) sum += T(value).Operation();
+                });
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Strategy (StrategyExample.cpp)
+
+namespace strategy
+{
+    // Every job sorts one block of this many ints.
+    constexpr std::size_t block = 8;
+
+    // The algorithms from StrategyExample.cpp as plain classes, so every dispatch style runs identical sorting code.
+    struct BubbleSort {
+        static void Sort(std::vector<int>& data) {
+            int n = static_cast<int>(data.size());
+            for (int i = 0; i < n - 1; i++) {
+                for (int j = 0; j < n - i - 1; j++) {
+                    if (data[j] > data[j + 1]) {
+                        std::swap(data[j], data[j + 1]);
+                    }
+                }
+            }
+        }
+    };
+
+    struct QuickSort {
+        static void Sort(std::vector<int>& data) {
+            Quicksort(data, 0, static_cast<int>(data.size()) - 1);
+        }
+
+    private:
+        static void Quicksort(std::vector<int>& data, int low, int high) {
+            if (low < high) {
+                int pivot_index = Partition(data, low, high);
+                Quicksort(data, low, pivot_index - 1);
+                Quicksort(data, pivot_index + 1, high);
+            }
+        }
+
+        static int Partition(std::vector<int>& data, int low, int high) {
+            int pivot = data[high];
+            int i = low - 1;
+            for (int j = low; j <= high - 1; j++) {
+                if (data[j] <= pivot) {
+                    i++;
+                    std::swap(data[i], data[j]);
+                }
+            }
+            std::swap(data[i + 1], data[high]);
+            return i + 1;
+        }
+    };
+
+    // The virtual design from StrategyExample.cpp.
+    class SortStrategy {
+    public:
+        virtual ~SortStrategy() = default;
+        virtual void Sort(std::vector<int>& data) = 0;
+    };
+
+    template <typename Algorithm>
+    class VirtualSort : public SortStrategy {
+    public:
+        void Sort(std::vector<int>& data) override { Algorithm::Sort(data); }
+    };
+
+    class Sorter {
+    public:
+        Sorter(std::unique_ptr<SortStrategy> strategy) : strategy_(std::move(strategy)) {}
+        void Sort(std::vector<int>& data) { strategy_->Sort(data); }
+    private:
+        std::unique_ptr<SortStrategy> strategy_;
+    };
+
+    using Kinds = StaticKinds<BubbleSort, QuickSort>;
+
+    std::uint64_t Digest(const std::vector<int>& sorted)
+    {
+        return static_cast<std::uint64_t>(sorted[0]) + 7u * static_cast<std::uint64_t>(sorted[block / 2]) + 13u * static_cast<std::uint64_t>(sorted[block - 1]);
+    }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const auto kinds = RandomKinds(n, Kinds::count, 0x5070 + n);
+        const auto raw = RandomValues(n * block, 1000000, 0x5071 + n);
+        const std::vector<int> pool(raw.begin(), raw.end());
+        std::vector<int> scratch(block);
+
+        // Loads job i's block into the scratch vector every strategy sorts in place.
+        auto load = [&](std::size_t job) {
+            scratch.assign(pool.begin() + static_cast<std::ptrdiff_t>(job * block), pool.begin() + static_cast<std::ptrdiff_t>((job + 1) * block));
+        };
+
+        {
+            std::vector<Sorter> sorters;
+            sorters.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    sorters.emplace_back(std::make_unique<VirtualSort<T>>());
+                });
+            }
+            runner.Run("strategy", "virtual", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    load(i);
+                    sorters[i].Sort(scratch);
+                    sum += Digest(scratch);
+                }
+                return sum;
+            });
+        }
+        runner.Run("strategy", "template", n, n, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                load(i);
+                Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    T::Sort(scratch);
+                });
+                sum += Digest(scratch);
+            }
+            return sum;
+        });
+        {
+            std::vector<Kinds::Variant> strategies;
+            strategies.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    strategies.emplace_back(std::in_place_type<T>);
+                });
+            }
+            runner.Run("strategy", "variant", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    load(i);
+                    std::visit([&](auto& s) { s.Sort(scratch); }, strategies[i]);
+                    sum += Digest(scratch);
+                }
+                return sum;
+            });
+        }
+        {
+            using SortFunction = void (*)(std::vector<int>&);
+            std::vector<SortFunction> strategies(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                strategies[i] = Kinds::Dispatch(kinds[i], [](auto tag) -> SortFunction {
+                    using T = typename decltype(tag)::type;
+                    return &T::Sort;
+                });
+            }
+            runner.Run("strategy", "function_pointer", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    load(i);
+                    strategies[i](scratch);
+                    sum += Digest(scratch);
+                }
+                return sum;
+            });
+        }
+        {
+            std::array<std::vector<std::uint32_t>, Kinds::count> batches;
+            for (std::size_t i = 0; i < n; ++i) batches[kinds[i]].push_back(static_cast<std::uint32_t>(i));
+            runner.Run("strategy", "batched", n, n, [&] {
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (std::uint32_t job : batches[kind]) {
+                        load(job);
+                        T::Sort(scratch);
+                        sum += Digest(scratch);
+                    }
+                });
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Iterator (IteratorExample.cpp)
+
+namespace iterator
+{
+    // Elements per aggregate.
+    constexpr int length = 16;
+
+    // Iterator and Aggregate from IteratorExample.cpp, plus a reversed aggregate so the iterator type varies.
+    class Iterator {
+    public:
+        virtual ~Iterator() {}
+        virtual void first() = 0;
+        virtual void next() = 0;
+        virtual bool is_done() const = 0;
+        virtual int current() const = 0;
+    };
+
+    class Aggregate {
+    public:
+        virtual ~Aggregate() {}
+        virtual std::unique_ptr<Iterator> Create_iterator() = 0;
+        virtual int size() const = 0;
+        virtual int operator[](int index) const = 0;
+    };
+
+    class ConcreteIterator : public Iterator {
+        Aggregate* aggregate_;
+        int current_;
+    public:
+        ConcreteIterator(Aggregate* aggregate) : aggregate_(aggregate), current_(0) {}
+        void first() override { current_ = 0; }
+        void next() override { current_++; }
+        bool is_done() const override { return current_ == aggregate_->size(); }
+        int current() const override { return (*aggregate_)[current_]; }
+    };
+
+    class ReverseIterator : public Iterator {
+        Aggregate* aggregate_;
+        int current_;
+    public:
+        ReverseIterator(Aggregate* aggregate) : aggregate_(aggregate), current_(0) {}
+        void first() override { current_ = aggregate_->size() - 1; }
+        void next() override { current_--; }
+        bool is_done() const override { return current_ < 0; }
+        int current() const override { return (*aggregate_)[current_]; }
+    };
+
+    class ConcreteAggregate : public Aggregate {
+        std::vector<int> data_;
+    public:
+        ConcreteAggregate(const std::vector<int>& data) : data_(data) {}
+        std::unique_ptr<Iterator> Create_iterator() override { return std::make_unique<ConcreteIterator>(this); }
+        int size() const override { return static_cast<int>(data_.size()); }
+        int operator[](int index) const override { return data_[index]; }
+    };
+
+    class ReversedAggregate : public ConcreteAggregate {
+    public:
+        using ConcreteAggregate::ConcreteAggregate;
+        std::unique_ptr<Iterator> Create_iterator() override { return std::make_unique<ReverseIterator>(this); }
+    };
+
+    // Non-virtual cursors over a span, with the same first/next/is_done/current protocol.
+    struct ForwardCursor {
+        const int* data;
+        int size;
+        int i = 0;
+        ForwardCursor(const int* d, int n) : data(d), size(n) {}
+        void first() { i = 0; }
+        void next() { i++; }
+        bool is_done() const { return i == size; }
+        int current() const { return data[i]; }
+    };
+
+    struct ReverseCursor {
+        const int* data;
+        int size;
+        int i = 0;
+        ReverseCursor(const int* d, int n) : data(d), size(n) {}
+        void first() { i = size - 1; }
+        void next() { i--; }
+        bool is_done() const { return i < 0; }
+        int current() const { return data[i]; }
+    };
+
+    using Kinds = StaticKinds<ForwardCursor, ReverseCursor>;
+
+    // The traversal every variant performs: an order-sensitive hash of the aggregate's elements.
+    template <typename Cursor>
+    unsigned Traverse(Cursor cursor)
+    {
+        unsigned hash = 0;
+        for (cursor.first(); !cursor.is_done(); cursor.next()) hash = hash * 31u + static_cast<unsigned>(cursor.current());
+        return hash;
+    }
+
+    template <typename Cursor>
+    unsigned TraverseAt(const int* data, int size) { return Traverse(Cursor(data, size)); }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const std::size_t aggregates = std::max<std::size_t>(1, n / length);
+        const std::size_t elements = aggregates * length;
+        const auto kinds = RandomKinds(aggregates, Kinds::count, 0x17e0 + n);
+        const auto raw = RandomValues(elements, 1u << 20, 0x17e1 + n);
+        const std::vector<int> pool(raw.begin(), raw.end());
+        auto at = [&](std::size_t aggregate) { return pool.data() + aggregate * length; };
+
+        {
+            std::vector<std::unique_ptr<Aggregate>> items;
+            items.reserve(aggregates);
+            for (std::size_t a = 0; a < aggregates; ++a) {
+                const std::vector<int> data(at(a), at(a) + length);
+                if (kinds[a] == 0) items.push_back(std::make_unique<ConcreteAggregate>(data));
+                else items.push_back(std::make_unique<ReversedAggregate>(data));
+            }
+            runner.Run("iterator", "virtual", elements, elements, [&] {
+                std::uint64_t sum = 0;
+                for (const auto& aggregate : items) {
+                    auto it = aggregate->Create_iterator();
+                    unsigned hash = 0;
+                    for (it->first(); !it->is_done(); it->next()) hash = hash * 31u + static_cast<unsigned>(it->current());
+                    sum += hash;
+                }
+                return sum;
+            });
+        }
+        runner.Run("iterator", "template", elements, elements, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t a = 0; a < aggregates; ++a) {
+                sum += Kinds::Dispatch(kinds[a], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return Traverse(T(at(a), length));
+                });
+            }
+            return sum;
+        });
+        {
+            std::vector<Kinds::Variant> cursors;
+            cursors.reserve(aggregates);
+            for (std::size_t a = 0; a < aggregates; ++a) {
+                Kinds::Dispatch(kinds[a], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    cursors.emplace_back(std::in_place_type<T>, at(a), length);
+                });
+            }
+            runner.Run("iterator", "variant", elements, elements, [&] {
+                std::uint64_t sum = 0;
+                for (const auto& cursor : cursors) sum += std::visit([](auto c) { return Traverse(c); }, cursor);
+                return sum;
+            });
+        }
+        {
+            using TraverseFunction = unsigned (*)(const int*, int);
+            std::vector<TraverseFunction> traversals(aggregates);
+            for (std::size_t a = 0; a < aggregates; ++a) {
+                traversals[a] = Kinds::Dispatch(kinds[a], [](auto tag) -> TraverseFunction {
+                    using T = typename decltype(tag)::type;
+                    return &TraverseAt<T>;
+                });
+            }
+            runner.Run("iterator", "function_pointer", elements, elements, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t a = 0; a < aggregates; ++a) sum += traversals[a](at(a), length);
+                return sum;
+            });
+        }
+        {
+            std::array<std::vector<std::uint32_t>, Kinds::count> batches;
+            for (std::size_t a = 0; a < aggregates; ++a) batches[kinds[a]].push_back(static_cast<std::uint32_t>(a));
+            runner.Run("iterator", "batched", elements, elements, [&] {
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (std::uint32_t a : batches[kind]) sum += Traverse(T(at(a), length));
+                });
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// State (StateExample.cpp)
+
+namespace state
+{
+    enum class Event : std::uint8_t { Open, Close, Send };
+
+    // Transitions follow StateExample.cpp, with one addition so connections do not all end up parked in CLOSED:
+    // a passive open of a closed connection puts it back into LISTEN, as it does in TCP.
+    // Acknowledge in ESTABLISHED counts the acknowledged segment.
+
+    class TCPConnection;
+
+    class TCPState
+    {
+    public:
+        virtual ~TCPState() = default;
+        virtual void Open(TCPConnection* t) = 0;
+        virtual void Close(TCPConnection* t) = 0;
+        virtual void Acknowledge(TCPConnection* t) = 0;
+        virtual unsigned Id() const = 0;
+    };
+
+    class TCPListen;
+
+    // StateExample.cpp's TCPConnection. The example allocates a new state object on every transition and never frees
+    // the old one; here the connection owns it, or, in flyweight mode, points at one shared instance per state class.
+    class TCPConnection
+    {
+    public:
+        explicit TCPConnection(bool flyweight);
+        void ActiveOpen() { state_->Open(this); }
+        void Close() { state_->Close(this); }
+        void Send() { state_->Acknowledge(this); }
+        unsigned StateId() const { return state_->Id(); }
+        unsigned acknowledged = 0;
+
+        // The old state may be the caller; states return immediately after changing the connection's state.
+        template <typename S>
+        void ChangeState()
+        {
+            if (flyweight_) {
+                static S shared;
+                state_ = &shared;
+            }
+            else {
+                owned_ = std::make_unique<S>();
+                state_ = owned_.get();
+            }
+        }
+
+    private:
+        bool flyweight_;
+        TCPState* state_ = nullptr;
+        std::unique_ptr<TCPState> owned_;
+    };
+
+    class TCPEstablished;
+    class TCPCloseWait;
+    class TCPClosed;
+
+    class TCPListen : public TCPState
+    {
+    public:
+        void Open(TCPConnection* t) override;
+        void Close(TCPConnection* t) override;
+        void Acknowledge(TCPConnection* /* t */) override { /* Do nothing */ }
+        unsigned Id() const override { return 0; }
+    };
+
+    class TCPEstablished : public TCPState
+    {
+    public:
+        void Open(TCPConnection* /* t */) override { /* Do nothing */ }
+        void Close(TCPConnection* t) override;
+        void Acknowledge(TCPConnection* t) override { t->acknowledged++; }
+        unsigned Id() const override { return 1; }
+    };
+
+    class TCPCloseWait : public TCPState
+    {
+    public:
+        void Open(TCPConnection* /* t */) override { /* Do nothing */ }
+        void Close(TCPConnection* t) override;
+        void Acknowledge(TCPConnection* /* t */) override { /* Do nothing */ }
+        unsigned Id() const override { return 2; }
+    };
+
+    class TCPClosed : public TCPState
+    {
+    public:
+        void Open(TCPConnection* t) override;
+        void Close(TCPConnection* /* t */) override { /* Do nothing */ }
+        void Acknowledge(TCPConnection* /* t */) override { /* Do nothing */ }
+        unsigned Id() const override { return 3; }
+    };
+
+    TCPConnection::TCPConnection(bool flyweight) : flyweight_(flyweight) { ChangeState<TCPListen>(); }
+
+    void TCPListen::Open(TCPConnection* t) { t->ChangeState<TCPEstablished>(); }
+    void TCPListen::Close(TCPConnection* t) { t->ChangeState<TCPClosed>(); }
+    void TCPEstablished::Close(TCPConnection* t) { t->ChangeState<TCPCloseWait>(); }
+    void TCPCloseWait::Close(TCPConnection* t) { t->ChangeState<TCPClosed>(); }
+    void TCPClosed::Open(TCPConnection* t) { t->ChangeState<TCPListen>(); }
+
+    // The same machine as plain state types. On() handles one event and returns the index of the next state.
+    struct Listen {
+        static std::uint8_t On(Event e, unsigned& /* acknowledged */) {
+            if (e == Event::Open) return 1;
+            if (e == Event::Close) return 3;
+            return 0;
+        }
+    };
+
+    struct Established {
+        static std::uint8_t On(Event e, unsigned& acknowledged) {
+            if (e == Event::Close) return 2;
+            if (e == Event::Send) acknowledged++;
+            return 1;
+        }
+    };
+
+    struct CloseWait {
+        static std::uint8_t On(Event e, unsigned& /* acknowledged */) { return e == Event::Close ? 3 : 2; }
+    };
+
+    struct Closed {
+        static std::uint8_t On(Event e, unsigned& /* acknowledged */) { return e == Event::Open ? 0 : 3; }
+    };
+
+    using Kinds = StaticKinds<Listen, Established, CloseWait, Closed>;
+
+    // The slice of the event stream connection 0 sees in a pass; it moves every pass so states keep mixing.
+    class EventWindow
+    {
+    public:
+        explicit EventWindow(std::size_t n) : n_(n) {}
+        std::size_t Next()
+        {
+            const std::size_t offset = offset_;
+            offset_ = (offset_ + 7919) % n_;
+            return offset;
+        }
+    private:
+        std::size_t n_;
+        std::size_t offset_ = 0;
+    };
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        // Two events to one close, so connections spend most of their time open.
+        const auto draws = RandomKinds(2 * n, 5, 0x57a7 + n);
+        std::vector<Event> events(draws.size());
+        for (std::size_t i = 0; i < draws.size(); ++i) {
+            events[i] = draws[i] < 2 ? Event::Open : draws[i] == 2 ? Event::Close : Event::Send;
+        }
+
+        auto run_virtual = [&](const char* variant, bool flyweight) {
+            std::vector<TCPConnection> connections;
+            connections.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) connections.emplace_back(flyweight);
+            EventWindow window(n);
+            runner.Run("state", variant, n, n, [&] {
+                const Event* slice = events.data() + window.Next();
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    TCPConnection& c = connections[i];
+                    switch (slice[i]) {
+                    case Event::Open: c.ActiveOpen(); break;
+                    case Event::Close: c.Close(); break;
+                    case Event::Send: c.Send(); break;
+                    }
+                    sum += c.StateId() + 1 + c.acknowledged;
+                }
+                return sum;
+            });
+        };
+        run_virtual("virtual", false);
+        run_virtual("virtual_flyweight", true);
+
+        {
+            struct Connection { std::uint8_t state = 0; unsigned acknowledged = 0; };
+            std::vector<Connection> connections(n);
+            EventWindow window(n);
+            runner.Run("state", "template", n, n, [&] {
+                const Event* slice = events.data() + window.Next();
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    Connection& c = connections[i];
+                    c.state = Kinds::Dispatch(c.state, [&](auto tag) {
+                        using T = typename decltype(tag)::type;
+                        return T::On(slice[i], c.acknowledged);
+                    });
+                    sum += c.state + 1u + c.acknowledged;
+                }
+                return sum;
+            });
+        }
+        {
+            struct Connection { Kinds::Variant state; unsigned acknowledged = 0; };
+            std::vector<Connection> connections(n);
+            EventWindow window(n);
+            runner.Run("state", "variant", n, n, [&] {
+                const Event* slice = events.data() + window.Next();
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    Connection& c = connections[i];
+                    const std::uint8_t next = std::visit([&](auto& s) { return s.On(slice[i], c.acknowledged); }, c.state);
+                    if (next != c.state.index()) {
+                        Kinds::Dispatch(next, [&](auto tag) {
+                            using T = typename decltype(tag)::type;
+                            c.state.template emplace<T>();
+                        });
+                    }
+                    sum += next + 1u + c.acknowledged;
+                }
+                return sum;
+            });
+        }
+        {
+            using Handler = std::uint8_t (*)(Event, unsigned&);
+            std::array<Handler, Kinds::count> handlers{};
+            Kinds::ForEach([&](auto tag, std::size_t kind) {
+                using T = typename decltype(tag)::type;
+                handlers[kind] = &T::On;
+            });
+            struct Connection { Handler state; std::uint8_t id; unsigned acknowledged; };
+            std::vector<Connection> connections(n, Connection{ handlers[0], 0, 0 });
+            EventWindow window(n);
+            runner.Run("state", "function_pointer", n, n, [&] {
+                const Event* slice = events.data() + window.Next();
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    Connection& c = connections[i];
+                    c.id = c.state(slice[i], c.acknowledged);
+                    c.state = handlers[c.id];
+                    sum += c.id + 1u + c.acknowledged;
+                }
+                return sum;
+            });
+        }
+        {
+            // Connections are kept in one bucket per state and move between buckets on transitions.
+            std::array<std::vector<std::uint32_t>, Kinds::count> buckets;
+            std::array<std::vector<std::uint32_t>, Kinds::count> next_buckets;
+            for (std::size_t i = 0; i < n; ++i) buckets[0].push_back(static_cast<std::uint32_t>(i));
+            std::vector<unsigned> acknowledged(n, 0);
+            EventWindow window(n);
+            runner.Run("state", "batched", n, n, [&] {
+                const Event* slice = events.data() + window.Next();
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (std::uint32_t id : buckets[kind]) {
+                        const std::uint8_t next = T::On(slice[id], acknowledged[id]);
+                        next_buckets[next].push_back(id);
+                        sum += next + 1u + acknowledged[id];
+                    }
+                });
+                for (std::size_t kind = 0; kind < Kinds::count; ++kind) {
+                    buckets[kind].swap(next_buckets[kind]);
+                    next_buckets[kind].clear();
+                }
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Factory Method (FM_SimpleExample.cpp)
+
+namespace factory
+{
+    // The shapes from FM_SimpleExample.cpp, given a size, with Draw() returning the area it would cover instead of printing.
+    class Shape
+    {
+    public:
+        virtual ~Shape() = default;
+        virtual unsigned Draw() const = 0;
+    };
+
+    class Circle : public Shape
+    {
+    public:
+        explicit Circle(unsigned radius) : radius_(radius) {}
+        unsigned Draw() const override { return radius_ * radius_ * 355u / 113u; }
+    private:
+        unsigned radius_;
+    };
+
+    class Square : public Shape
+    {
+    public:
+        explicit Square(unsigned side) : side_(side) {}
+        unsigned Draw() const override { return side_ * side_; }
+    private:
+        unsigned side_;
+    };
+
+    class ShapeFactory
+    {
+    public:
+        static std::unique_ptr<Shape> CreateShape(std::string type, unsigned size)
+        {
+            if (type == "circle") {
+                return std::make_unique<Circle>(size);
+            }
+            else if (type == "square") {
+                return std::make_unique<Square>(size);
+            }
+            else {
+                return nullptr;
+            }
+        }
+    };
+
+    // Shapes as values: creating one is constructing it in place.
+    struct CircleValue {
+        unsigned radius;
+        explicit CircleValue(unsigned r) : radius(r) {}
+        unsigned Draw() const { return radius * radius * 355u / 113u; }
+    };
+
+    struct SquareValue {
+        unsigned side;
+        explicit SquareValue(unsigned s) : side(s) {}
+        unsigned Draw() const { return side * side; }
+    };
+
+    using Kinds = StaticKinds<CircleValue, SquareValue>;
+
+    Kinds::Variant CreateShapeValue(std::size_t kind, unsigned size)
+    {
+        return Kinds::Dispatch(kind, [&](auto tag) {
+            using T = typename decltype(tag)::type;
+            return Kinds::Variant(std::in_place_type<T>, size);
+        });
+    }
+
+    template <typename T>
+    unsigned CreateAndDraw(unsigned size) { return T(size).Draw(); }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const auto kinds = RandomKinds(n, Kinds::count, 0xfac0 + n);
+        const auto sizes = RandomValues(n, 1000, 0xfac1 + n);
+
+        {
+            const std::array<std::string, Kinds::count> names{ "circle", "square" };
+            std::vector<std::string> requests(n);
+            for (std::size_t i = 0; i < n; ++i) requests[i] = names[kinds[i]];
+            runner.Run("factory", "virtual", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    auto shape = ShapeFactory::CreateShape(requests[i], sizes[i]);
+                    sum += shape->Draw();
+                }
+                return sum;
+            });
+        }
+        runner.Run("factory", "template", n, n, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                sum += Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return T(sizes[i]).Draw();
+                });
+            }
+            return sum;
+        });
+        runner.Run("factory", "variant", n, n, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                const Kinds::Variant shape = CreateShapeValue(kinds[i], sizes[i]);
+                sum += std::visit([](const auto& s) { return s.Draw(); }, shape);
+            }
+            return sum;
+        });
+        {
+            using Creator = unsigned (*)(unsigned);
+            std::array<Creator, Kinds::count> creators{};
+            Kinds::ForEach([&](auto tag, std::size_t kind) {
+                using T = typename decltype(tag)::type;
+                creators[kind] = &CreateAndDraw<T>;
+            });
+            runner.Run("factory", "function_pointer", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < n; ++i) sum += creators[kinds[i]](sizes[i]);
+                return sum;
+            });
+        }
+        {
+            std::array<std::vector<unsigned>, Kinds::count> batches;
+            for (std::size_t i = 0; i < n; ++i) batches[kinds[i]].push_back(sizes[i]);
+            runner.Run("factory", "batched", n, n, [&] {
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (unsigned size : batches[kind]) sum += T(size).Draw();
+                });
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Dependency Injection (DependencyInjection.cpp)
+
+namespace injection
+{
+    // The engines from DependencyInjection.cpp, with a per-engine tuning value and Horsepower() in place of printing.
+    class Engine
+    {
+    public:
+        explicit Engine(unsigned tuning) : tuning_(tuning) {}
+        virtual ~Engine() = default;
+        virtual unsigned Horsepower() const { return 150 + tuning_; }
+    protected:
+        unsigned tuning_;
+    };
+
+    class ElectricEngine : public Engine
+    {
+    public:
+        using Engine::Engine;
+        unsigned Horsepower() const override { return 300 + 2 * tuning_; }
+    };
+
+    class TestEngine : public Engine
+    {
+    public:
+        using Engine::Engine;
+        unsigned Horsepower() const override { return 1; }
+    };
+
+    class Car
+    {
+    private:
+        std::unique_ptr<Engine> engine;
+    public:
+        Car(std::unique_ptr<Engine>&& e) : engine(std::move(e)) {}
+        unsigned Power() const { return engine->Horsepower(); }
+    };
+
+    // Engines held by value, as in CompileTimeInjector.cpp's StaticCar.
+    struct CombustionEngineValue {
+        unsigned tuning;
+        unsigned Horsepower() const { return 150 + tuning; }
+    };
+
+    struct ElectricEngineValue {
+        unsigned tuning;
+        unsigned Horsepower() const { return 300 + 2 * tuning; }
+    };
+
+    struct TestEngineValue {
+        unsigned tuning;
+        unsigned Horsepower() const { return 1; }
+    };
+
+    template <typename E>
+    struct StaticCar {
+        E engine;
+        explicit StaticCar(unsigned tuning) : engine{ tuning } {}
+        unsigned Power() const { return engine.Horsepower(); }
+    };
+
+    using Kinds = StaticKinds<StaticCar<CombustionEngineValue>, StaticCar<ElectricEngineValue>, StaticCar<TestEngineValue>>;
+
+    template <typename T>
+    unsigned PowerOf(unsigned tuning) { return T(tuning).Power(); }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const auto kinds = RandomKinds(n, Kinds::count, 0xd100 + n);
+        const auto tunings = RandomValues(n, 100, 0xd101 + n);
+
+        {
+            std::vector<Car> cars;
+            cars.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                switch (kinds[i]) {
+                case 0: cars.emplace_back(std::make_unique<Engine>(tunings[i])); break;
+                case 1: cars.emplace_back(std::make_unique<ElectricEngine>(tunings[i])); break;
+                default: cars.emplace_back(std::make_unique<TestEngine>(tunings[i])); break;
+                }
+            }
+            runner.Run("injection", "virtual", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const Car& car : cars) sum += car.Power();
+                return sum;
+            });
+        }
+        runner.Run("injection", "template", n, n, [&] {
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < n; ++i) {
+                sum += Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return T(tunings[i]).Power();
+                });
+            }
+            return sum;
+        });
+        {
+            std::vector<Kinds::Variant> cars;
+            cars.reserve(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                Kinds::Dispatch(kinds[i], [&](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    cars.emplace_back(std::in_place_type<T>, tunings[i]);
+                });
+            }
+            runner.Run("injection", "variant", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const auto& car : cars) sum += std::visit([](const auto& c) { return c.Power(); }, car);
+                return sum;
+            });
+        }
+        {
+            struct BoundCar { unsigned (*power)(unsigned); unsigned tuning; };
+            std::vector<BoundCar> cars(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                auto power = Kinds::Dispatch(kinds[i], [](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return &PowerOf<T>;
+                });
+                cars[i] = { power, tunings[i] };
+            }
+            runner.Run("injection", "function_pointer", n, n, [&] {
+                std::uint64_t sum = 0;
+                for (const BoundCar& car : cars) sum += car.power(car.tuning);
+                return sum;
+            });
+        }
+        {
+            std::array<std::vector<unsigned>, Kinds::count> batches;
+            for (std::size_t i = 0; i < n; ++i) batches[kinds[i]].push_back(tunings[i]);
+            runner.Run("injection", "batched", n, n, [&] {
+                std::uint64_t sum = 0;
+                Kinds::ForEach([&](auto tag, std::size_t kind) {
+                    using T = typename decltype(tag)::type;
+                    for (unsigned tuning : batches[kind]) sum += T(tuning).Power();
+                });
+                return sum;
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Open/Closed filter (openClosedPrinciple.cpp)
+
+namespace filter
+{
+    enum class Color : std::uint8_t { red, green, blue };
+    enum class Size : std::uint8_t { small, medium, large };
+
+    struct Product
+    {
+        std::string name;
+        Color color;
+        Size size;
+    };
+
+    // The interfaces from openClosedPrinciple.cpp, with the size and conjunction specifications a caller adds next.
+    template <typename T>
+    struct ISpecification
+    {
+        virtual ~ISpecification() = default;
+        virtual bool IsSatisfied(T* item) = 0;
+    };
+
+    template <typename T>
+    struct IFilter
+    {
+        virtual ~IFilter() = default;
+        virtual std::vector<T*> Filter(std::vector<T*> items, ISpecification<T>& spec) = 0;
+    };
+
+    struct BetterFilter : IFilter<Product>
+    {
+        std::vector<Product*> Filter(std::vector<Product*> items, ISpecification<Product>& spec) override
+        {
+            std::vector<Product*> result;
+            for (auto& item : items)
+            {
+                if (spec.IsSatisfied(item))
+                {
+                    result.push_back(item);
+                }
+            }
+            return result;
+        }
+    };
+
+    struct ColorSpecification : ISpecification<Product>
+    {
+        Color color;
+        ColorSpecification(Color color) : color(color) {}
+        bool IsSatisfied(Product* item) override { return item->color == color; }
+    };
+
+    struct SizeSpecification : ISpecification<Product>
+    {
+        Size size;
+        SizeSpecification(Size size) : size(size) {}
+        bool IsSatisfied(Product* item) override { return item->size == size; }
+    };
+
+    struct AndSpecification : ISpecification<Product>
+    {
+        ISpecification<Product>& first;
+        ISpecification<Product>& second;
+        AndSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+        bool IsSatisfied(Product* item) override { return first.IsSatisfied(item) && second.IsSatisfied(item); }
+    };
+
+    // Specifications as values. Test() works on bare columns so the batched variant can use them too.
+    struct ColorIs {
+        Color color;
+        bool Test(Color c, Size) const { return c == color; }
+        bool operator()(const Product& p) const { return Test(p.color, p.size); }
+    };
+
+    struct SizeIs {
+        Size size;
+        bool Test(Color, Size s) const { return s == size; }
+        bool operator()(const Product& p) const { return Test(p.color, p.size); }
+    };
+
+    template <typename A, typename B>
+    struct Both {
+        A first;
+        B second;
+        bool Test(Color c, Size s) const { return first.Test(c, s) && second.Test(c, s); }
+        bool operator()(const Product& p) const { return Test(p.color, p.size); }
+    };
+
+    using Query = std::variant<ColorIs, SizeIs, Both<ColorIs, SizeIs>>;
+
+    template <typename Predicate>
+    std::vector<const Product*> FilterBy(const std::vector<const Product*>& items, const Predicate& predicate)
+    {
+        std::vector<const Product*> result;
+        for (const Product* item : items) {
+            if (predicate(*item)) result.push_back(item);
+        }
+        return result;
+    }
+
+    template <typename Spec>
+    bool TestProduct(const Product& p, const void* spec) { return (*static_cast<const Spec*>(spec))(p); }
+
+    // The three queries every variant runs per pass: green things, large things, large green things.
+    const ColorIs green{ Color::green };
+    const SizeIs large{ Size::large };
+    const Both<ColorIs, SizeIs> large_green{ green, large };
+
+    std::uint64_t Score(std::size_t query, std::size_t matches) { return (query + 1) * matches; }
+
+    void Run(BenchmarkRunner& runner, std::size_t n)
+    {
+        const auto colors = RandomKinds(n, 3, 0xf170 + n);
+        const auto sizes = RandomKinds(n, 3, 0xf171 + n);
+        std::vector<Product> products(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            products[i] = { "Product " + std::to_string(i), static_cast<Color>(colors[i]), static_cast<Size>(sizes[i]) };
+        }
+        const std::uint64_t ops = 3 * static_cast<std::uint64_t>(n);
+
+        {
+            std::vector<Product*> items;
+            items.reserve(n);
+            for (auto& p : products) items.push_back(&p);
+            BetterFilter bf;
+            ColorSpecification green_spec(Color::green);
+            SizeSpecification large_spec(Size::large);
+            AndSpecification large_green_spec(green_spec, large_spec);
+            const std::array<ISpecification<Product>*, 3> queries{ &green_spec, &large_spec, &large_green_spec };
+            runner.Run("filter", "virtual", n, ops, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t q = 0; q < queries.size(); ++q) sum += Score(q, bf.Filter(items, *queries[q]).size());
+                return sum;
+            });
+        }
+
+        std::vector<const Product*> items;
+        items.reserve(n);
+        for (const auto& p : products) items.push_back(&p);
+
+        runner.Run("filter", "template", n, ops, [&] {
+            return Score(0, FilterBy(items, green).size())
+                + Score(1, FilterBy(items, large).size())
+                + Score(2, FilterBy(items, large_green).size());
+        });
+        {
+            const std::array<Query, 3> queries{ Query(green), Query(large), Query(large_green) };
+            runner.Run("filter", "variant", n, ops, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t q = 0; q < queries.size(); ++q) {
+                    const Query& query = queries[q];
+                    auto matches = FilterBy(items, [&](const Product& p) {
+                        return std::visit([&](const auto& spec) { return spec(p); }, query);
+                    });
+                    sum += Score(q, matches.size());
+                }
+                return sum;
+            });
+        }
+        {
+            struct Predicate { bool (*test)(const Product&, const void*); const void* spec; };
+            const std::array<Predicate, 3> queries{
+                Predicate{ &TestProduct<ColorIs>, &green },
+                Predicate{ &TestProduct<SizeIs>, &large },
+                Predicate{ &TestProduct<Both<ColorIs, SizeIs>>, &large_green } };
+            runner.Run("filter", "function_pointer", n, ops, [&] {
+                std::uint64_t sum = 0;
+                for (std::size_t q = 0; q < queries.size(); ++q) {
+                    const Predicate& predicate = queries[q];
+                    auto matches = FilterBy(items, [&](const Product& p) { return predicate.test(p, predicate.spec); });
+                    sum += Score(q, matches.size());
+                }
+                return sum;
+            });
+        }
+        {
+            // A filter has one item type, so the batched form segregates fields instead: one column per attribute.
+            std::vector<Color> color_column(n);
+            std::vector<Size> size_column(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                color_column[i] = products[i].color;
+                size_column[i] = products[i].size;
+            }
+            auto filter_columns = [&](const auto& spec) {
+                std::vector<std::uint32_t> result;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (spec.Test(color_column[i], size_column[i])) result.push_back(static_cast<std::uint32_t>(i));
+                }
+                return result;
+            };
+            runner.Run("filter", "batched", n, ops, [&] {
+                return Score(0, filter_columns(green).size())
+                    + Score(1, filter_columns(large).size())
+                    + Score(2, filter_columns(large_green).size());
+            });
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::vector<std::string> SplitList(const std::string& text)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, ',')) {
+        if (!part.empty()) parts.push_back(part);
+    }
+    return parts;
+}
+
+// Converts the whole of `text` with `parse` (std::stoull etc.); throws std::invalid_argument on trailing characters.
+template <typename Parse>
+auto ParseNumber(const std::string& text, Parse parse)
+{
+    std::size_t used = 0;
+    const auto value = parse(text, &used);
+    if (used != text.size()) throw std::invalid_argument(text);
+    return value;
+}
+
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return false;
+        }
+        const std::string value = argv[++i];
+        try {
+            if (arg == "--sizes") {
+                options.sizes.clear();
+                for (const auto& size : SplitList(value)) {
+                    const auto elements = ParseNumber(size, [](const std::string& s, std::size_t* used) { return std::stoull(s, used); });
+                    if (elements == 0) throw std::invalid_argument(size);
+                    options.sizes.push_back(static_cast<std::size_t>(elements));
+                }
+                if (options.sizes.empty()) throw std::invalid_argument(value);
+            }
+            else if (arg == "--modules") {
+                options.modules = SplitList(value);
+            }
+            else if (arg == "--min-ms") {
+                options.min_time_ms = ParseNumber(value, [](const std::string& s, std::size_t* used) { return std::stod(s, used); });
+            }
+            else if (arg == "--trials") {
+                options.trials = std::max(1, ParseNumber(value, [](const std::string& s, std::size_t* used) { return std::stoi(s, used); }));
+            }
+            else if (arg == "--json") {
+                options.json_path = value;
+            }
+            else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+        catch (const std::logic_error&) {
+            // std::invalid_argument and std::out_of_range from the conversions above
+            std::cerr << "invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: " << argv[0] << " [--sizes a,b,c] [--modules m1,m2] [--min-ms ms] [--trials t] [--json path|-]" << std::endl;
+        return 2;
+    }
+
+    const std::vector<std::pair<std::string, void (*)(BenchmarkRunner&, std::size_t)>> modules{
+        { "decorator", &decorator::Run },
+        { "strategy", &strategy::Run },
+        { "iterator", &iterator::Run },
+        { "state", &state::Run },
+        { "factory", &factory::Run },
+        { "injection", &injection::Run },
+        { "filter", &filter::Run },
+    };
+
+    // Open the report before measuring anything, so a bad path fails in milliseconds rather than after the run.
+    std::ofstream file;
+    if (options.json_path != "-") {
+        file.open(options.json_path);
+        if (!file) {
+            std::cerr << "cannot open " << options.json_path << " for writing" << std::endl;
+            return 2;
+        }
+    }
+
+    BenchmarkRunner runner(options);
+    if (!runner.CountersAvailable()) {
+        std::fprintf(runner.Table(), "Hardware counters unavailable (perf_event_open failed or unsupported); reporting time only.\n");
+    }
+    runner.PrintHeader();
+
+    for (const auto& [name, run] : modules) {
+        if (!options.modules.empty() && std::find(options.modules.begin(), options.modules.end(), name) == options.modules.end()) continue;
+        for (std::size_t size : options.sizes) run(runner, size);
+    }
+
+    std::ostream& out = options.json_path == "-" ? std::cout : file;
+    runner.WriteJson(out);
+    out.flush();
+    if (file.is_open()) file.close();
+    if (!out) {
+        std::cerr << "failed to write results to " << (options.json_path == "-" ? "stdout" : options.json_path) << std::endl;
+        return 2;
+    }
+    if (options.json_path != "-") {
+        std::fprintf(runner.Table(), "Results written to %s\n", options.json_path.c_str());
+    }
+
+    if (!runner.AllChecksumsAgree()) {
+        std::cerr << "Checksum mismatch: some variants did not compute the same result as the virtual design." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,483 @@
+// Tracing.h
+
+// Description:
+// A small tracing facility shared by the examples, for finding out where time goes inside hot paths such as
+// Sorter::Sort, TCPConnection's events, BetterFilter::Filter and PersistenceManager::Save.
+//
+//  - TRACE_SCOPE("name") opens a span that closes at the end of the enclosing scope.
+//    TRACE_COUNTER("name", value) records a counter sample and TRACE_INSTANT("name") a point event.
+//    Names must be string literals (or otherwise outlive the trace); only the pointer is recorded.
+//  - Each thread writes fixed-size 32-byte binary events into its own single-producer ring buffer, so recording
+//    never takes a lock and never touches another thread's cache lines. A full ring drops the event and counts it
+//    rather than stalling the traced code.
+//  - Timestamps are raw TSC reads (__rdtsc) where available and steady_clock nanoseconds elsewhere;
+//    they are converted to microseconds only at export, using a calibration against steady_clock.
+//  - The Tracer drains every ring, either on demand (Collect) or from a background collector thread,
+//    and writes Chrome trace JSON, which chrome://tracing and ui.perfetto.dev both open. It keeps at most
+//    EventLimit() collected events in memory (a few million by default); later events are counted and discarded,
+//    so a long traced run ends with a truncated trace instead of an ever-growing heap.
+//
+// Cost when disabled: a span checks one relaxed atomic flag on entry, a branch that is never taken while tracing
+// is off, and its destructor tests the span's own start field. Defining TRACING_DISABLED removes the macros entirely.
+//
+// Usage:
+//  tracing::Session session;                   // traces to $TRACE_OUTPUT if set, otherwise does nothing
+//  tracing::Session session("run.trace.json"); // always traces to the given file
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACING_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACING_HAS_TSC 1
+#endif
+
+namespace tracing
+{
+    enum class EventType : std::uint8_t { Complete, Counter, Instant };
+
+    // One recorded event. Spans are stored once, when they end, as a start timestamp plus a duration,
+    // so a dropped event can never leave an unmatched begin or end behind.
+    struct TraceEvent
+    {
+        std::uint64_t timestamp;   // ticks; start time for spans
+        const char* name;
+        std::int64_t value;        // duration in ticks for spans, the sample for counters
+        EventType type;
+    };
+
+    static_assert(sizeof(TraceEvent) <= 32, "trace events are meant to stay at 32 bytes");
+
+    namespace detail
+    {
+        inline std::atomic<bool> enabled{ false };
+    }
+
+    inline bool Enabled() noexcept
+    {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    inline std::uint64_t Now() noexcept
+    {
+#if defined(TRACING_HAS_TSC)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // A single-producer, single-consumer ring of events. The owning thread pushes, the collector drains.
+    // head_ and tail_ live on separate cache lines; the producer keeps a cached copy of tail_ so it only reads
+    // the collector's line when the ring looks full.
+    class EventRing
+    {
+    public:
+        static constexpr std::size_t capacity = std::size_t(1) << 16;
+
+        EventRing(std::uint32_t thread_id, std::string thread_name)
+            : thread_id_(thread_id), thread_name_(std::move(thread_name)), slots_(new TraceEvent[capacity]) {}
+
+        bool Push(const TraceEvent& event) noexcept
+        {
+            const std::uint64_t head = head_.load(std::memory_order_relaxed);
+            if (head - cached_tail_ >= capacity) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ >= capacity) {
+                    dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            slots_[head & (capacity - 1)] = event;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Hands every event published so far to f and frees their slots. Only the collector calls this.
+        template <typename F>
+        std::size_t Drain(F&& f)
+        {
+            const std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+            const std::uint64_t head = head_.load(std::memory_order_acquire);
+            for (std::uint64_t i = tail; i != head; ++i) f(slots_[i & (capacity - 1)]);
+            tail_.store(head, std::memory_order_release);
+            return static_cast<std::size_t>(head - tail);
+        }
+
+        std::uint32_t ThreadId() const { return thread_id_; }
+        const std::string& ThreadName() const { return thread_name_; }
+        std::uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        const std::uint32_t thread_id_;
+        const std::string thread_name_;
+        std::unique_ptr<TraceEvent[]> slots_;
+
+        alignas(64) std::atomic<std::uint64_t> head_{ 0 };
+        std::uint64_t cached_tail_ = 0;
+        std::atomic<std::uint64_t> dropped_{ 0 };
+        alignas(64) std::atomic<std::uint64_t> tail_{ 0 };
+    };
+
+    // An event drained from a ring, tagged with the thread that recorded it.
+    struct CollectedEvent
+    {
+        TraceEvent event;
+        std::uint32_t thread_id;
+    };
+
+    class Tracer
+    {
+    public:
+        static constexpr std::size_t default_event_limit = std::size_t(1) << 22;   // 4M events, 160 MB
+
+        static Tracer& Instance()
+        {
+            static Tracer tracer;
+            return tracer;
+        }
+
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+
+        ~Tracer() { StopCollector(); }
+
+        void Enable() { detail::enabled.store(true, std::memory_order_relaxed); }
+        void Disable() { detail::enabled.store(false, std::memory_order_relaxed); }
+
+        // The calling thread's ring, registered on first use. Rings outlive their threads so nothing is lost
+        // when a traced thread exits before the collector runs.
+        EventRing& LocalRing()
+        {
+            thread_local EventRing* ring = nullptr;
+            if (ring == nullptr) ring = Register();
+            return *ring;
+        }
+
+        void Record(const TraceEvent& event) noexcept { LocalRing().Push(event); }
+
+        // Drains every ring into the collected event list.
+        std::size_t Collect()
+        {
+            std::vector<std::shared_ptr<EventRing>> rings;
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                rings = rings_;
+            }
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            std::size_t drained = 0;
+            for (const auto& ring : rings) {
+                const std::uint32_t thread_id = ring->ThreadId();
+                drained += ring->Drain([&](const TraceEvent& event) {
+                    if (collected_.size() < event_limit_) collected_.push_back({ event, thread_id });
+                    else ++discarded_;
+                });
+            }
+            return drained;
+        }
+
+        // Caps the number of collected events kept in memory; events collected beyond it are discarded.
+        void SetEventLimit(std::size_t limit)
+        {
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            event_limit_ = limit;
+        }
+
+        std::size_t EventLimit()
+        {
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            return event_limit_;
+        }
+
+        std::uint64_t DiscardedEvents()
+        {
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            return discarded_;
+        }
+
+        // Drains the rings every interval on a background thread, so long runs do not overflow them.
+        void StartCollector(std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+        {
+            std::lock_guard<std::mutex> lock(collector_mutex_);
+            if (collector_.joinable()) return;
+            stop_collector_ = false;
+            collector_ = std::thread([this, interval] {
+                std::unique_lock<std::mutex> wait_lock(collector_mutex_);
+                while (!stop_collector_) {
+                    wake_collector_.wait_for(wait_lock, interval, [this] { return stop_collector_; });
+                    wait_lock.unlock();
+                    Collect();
+                    wait_lock.lock();
+                }
+            });
+        }
+
+        void StopCollector()
+        {
+            {
+                std::lock_guard<std::mutex> lock(collector_mutex_);
+                if (!collector_.joinable()) return;
+                stop_collector_ = true;
+            }
+            wake_collector_.notify_all();
+            collector_.join();
+        }
+
+        std::uint64_t DroppedEvents() const
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            std::uint64_t dropped = 0;
+            for (const auto& ring : rings_) dropped += ring->Dropped();
+            return dropped;
+        }
+
+        // Collects whatever is still in the rings and writes everything collected so far as Chrome trace JSON.
+        void WriteChromeTrace(std::ostream& out)
+        {
+            Collect();
+            const double ticks_per_us = TicksPerMicrosecond();
+
+            std::vector<std::pair<std::uint32_t, std::string>> threads;
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex_);
+                for (const auto& ring : rings_) threads.emplace_back(ring->ThreadId(), ring->ThreadName());
+            }
+
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+            bool first = true;
+            auto separator = [&] {
+                if (!first) out << ",\n";
+                first = false;
+            };
+            for (const auto& [thread_id, thread_name] : threads) {
+                separator();
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_id
+                    << ",\"args\":{\"name\":\"" << Escape(thread_name) << "\"}}";
+            }
+            for (const CollectedEvent& collected : collected_) {
+                const TraceEvent& e = collected.event;
+                separator();
+                out << "{\"name\":\"" << Escape(e.name) << "\",\"pid\":1,\"tid\":" << collected.thread_id
+                    << ",\"ts\":" << FormatMicroseconds(static_cast<double>(static_cast<std::int64_t>(e.timestamp - origin_ticks_)) / ticks_per_us);
+                switch (e.type) {
+                case EventType::Complete:
+                    out << ",\"ph\":\"X\",\"dur\":" << FormatMicroseconds(static_cast<double>(e.value) / ticks_per_us);
+                    break;
+                case EventType::Counter:
+                    out << ",\"ph\":\"C\",\"args\":{\"value\":" << e.value << "}";
+                    break;
+                case EventType::Instant:
+                    out << ",\"ph\":\"i\",\"s\":\"t\"";
+                    break;
+                }
+                out << "}";
+            }
+            out << "\n]}\n";
+        }
+
+        bool WriteChromeTrace(const std::string& path)
+        {
+            std::ofstream out(path);
+            if (!out) return false;
+            WriteChromeTrace(out);
+            return static_cast<bool>(out);
+        }
+
+        // Forgets every collected event; rings stay registered.
+        void Clear()
+        {
+            Collect();
+            std::lock_guard<std::mutex> lock(collect_mutex_);
+            collected_.clear();
+            discarded_ = 0;
+        }
+
+    private:
+        Tracer() : origin_ticks_(Now()), origin_time_(std::chrono::steady_clock::now()) {}
+
+        EventRing* Register()
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            const auto id = static_cast<std::uint32_t>(rings_.size() + 1);
+            rings_.push_back(std::make_shared<EventRing>(id, "thread " + std::to_string(id)));
+            return rings_.back().get();
+        }
+
+        // Measures the tick rate over the whole run so far; a run shorter than 10 ms is padded so the
+        // ratio is not dominated by the resolution of the clocks.
+        double TicksPerMicrosecond() const
+        {
+#if defined(TRACING_HAS_TSC)
+            auto elapsed = std::chrono::steady_clock::now() - origin_time_;
+            while (elapsed < std::chrono::milliseconds(10)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                elapsed = std::chrono::steady_clock::now() - origin_time_;
+            }
+            const std::uint64_t ticks = Now() - origin_ticks_;
+            const double us = std::chrono::duration<double, std::micro>(elapsed).count();
+            return static_cast<double>(ticks) / us;
+#else
+            return 1000.0;
+#endif
+        }
+
+        static std::string FormatMicroseconds(double us)
+        {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.3f", us);
+            return buffer;
+        }
+
+        static std::string Escape(const std::string& text)
+        {
+            std::string escaped;
+            for (char c : text) {
+                if (c == '"' || c == '\\') escaped += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+            }
+            return escaped;
+        }
+
+        const std::uint64_t origin_ticks_;
+        const std::chrono::steady_clock::time_point origin_time_;
+
+        mutable std::mutex rings_mutex_;
+        std::vector<std::shared_ptr<EventRing>> rings_;
+
+        std::mutex collect_mutex_;
+        std::vector<CollectedEvent> collected_;
+        std::size_t event_limit_ = default_event_limit;
+        std::uint64_t discarded_ = 0;
+
+        std::mutex collector_mutex_;
+        std::condition_variable wake_collector_;
+        std::thread collector_;
+        bool stop_collector_ = false;
+    };
+
+    // RAII span. Records nothing, and reads no clock, unless tracing was enabled when the span opened.
+    class Span
+    {
+    public:
+        explicit Span(const char* name) noexcept : name_(name), start_(0)
+        {
+            if (Enabled()) start_ = Now();
+        }
+
+        ~Span()
+        {
+            if (start_ != 0) {
+                const std::uint64_t end = Now();
+                Tracer::Instance().Record({ start_, name_, static_cast<std::int64_t>(end - start_), EventType::Complete });
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* name_;
+        std::uint64_t start_;
+    };
+
+    inline void RecordCounter(const char* name, std::int64_t value) noexcept
+    {
+        if (Enabled()) Tracer::Instance().Record({ Now(), name, value, EventType::Counter });
+    }
+
+    inline void RecordInstant(const char* name) noexcept
+    {
+        if (Enabled()) Tracer::Instance().Record({ Now(), name, 0, EventType::Instant });
+    }
+
+    // Enables tracing for the lifetime of the session and writes the trace when it ends.
+    // The default constructor only traces when the TRACE_OUTPUT environment variable names an output file,
+    // so instrumented programs run untraced unless asked.
+    class Session
+    {
+    public:
+        Session() : path_(Environment("TRACE_OUTPUT")) { Begin(); }
+        explicit Session(std::string path) : path_(std::move(path)) { Begin(); }
+
+        ~Session()
+        {
+            if (path_.empty()) return;
+            Tracer& tracer = Tracer::Instance();
+            tracer.Disable();
+            tracer.StopCollector();
+            if (!tracer.WriteChromeTrace(path_)) {
+                std::fprintf(stderr, "tracing: could not write %s\n", path_.c_str());
+            }
+            else {
+                if (const std::uint64_t dropped = tracer.DroppedEvents()) {
+                    std::fprintf(stderr, "tracing: %llu events dropped, rings were full\n", static_cast<unsigned long long>(dropped));
+                }
+                if (const std::uint64_t discarded = tracer.DiscardedEvents()) {
+                    std::fprintf(stderr, "tracing: trace truncated at %zu events, %llu later events discarded\n",
+                        tracer.EventLimit(), static_cast<unsigned long long>(discarded));
+                }
+            }
+        }
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+    private:
+        void Begin()
+        {
+            if (path_.empty()) return;
+            Tracer& tracer = Tracer::Instance();
+            tracer.StartCollector();
+            tracer.Enable();
+        }
+
+        static std::string Environment(const char* name)
+        {
+#if defined(_MSC_VER)
+            char* value = nullptr;
+            std::size_t length = 0;
+            if (_dupenv_s(&value, &length, name) != 0 || value == nullptr) return {};
+            std::string result(value);
+            std::free(value);
+            return result;
+#else
+            const char* value = std::getenv(name);
+            return value ? value : "";
+#endif
+        }
+
+        std::string path_;
+    };
+}
+
+#define TRACING_CONCAT_INNER(a, b) a##b
+#define TRACING_CONCAT(a, b) TRACING_CONCAT_INNER(a, b)
+
+#if defined(TRACING_DISABLED)
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#else
+#define TRACE_SCOPE(name) ::tracing::Span TRACING_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) ::tracing::RecordCounter(name, static_cast<std::int64_t>(value))
+#define TRACE_INSTANT(name) ::tracing::RecordInstant(name)
+#endif
@@ -0,0 +1,344 @@
+// CompileTimeInjector.cpp
+
+// Conceptual Description:
+// DependencyInjection.cpp wires a Car with its Engine by hand, and every dependency lives on the heap behind a virtual start().
+// A DI container moves the wiring out of client code, but the usual runtime container (a map from type to factory function)
+// pays for that with a hash lookup, a std::function call and a heap allocation for every node it builds.
+//
+// A compile-time container resolves the whole dependency graph while the program is being compiled:
+//  - Bindings are types. Bind<Key, Impl, Deps...> says "whoever asks for Key gets an Impl built from the Deps keys".
+//  - Missing and cyclic bindings are found by constexpr functions and reported with static_assert, not at runtime.
+//  - Create<Key>() returns the fully wired object by value. Every dependency is constructed in place inside its owner,
+//    so there is no lookup, no allocation and no virtual call left at runtime.
+
+// Example Description:
+// In this example, the same Engine, ElectricEngine and TestEngine classes are used three ways:
+//  1. Hand wiring, exactly like DependencyInjection.cpp (Car owns a std::unique_ptr<Engine>).
+//  2. RuntimeInjector, a map-based container keyed by std::type_index.
+//  3. di::Injector, where the car is a StaticCar<E> holding its engine by value.
+// Swapping in the TestEngine is a different binding list (TestBindings), not a different code path.
+// main() then benchmarks the cost of building one car graph with each approach.
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+class Engine
+{
+public:
+    Engine() {}
+    virtual ~Engine() = default;
+    virtual void start() { std::cout << "Start the engine" << std::endl; }
+    virtual int Horsepower() const { return 150; }
+};
+
+class ElectricEngine : public Engine
+{
+public:
+    ElectricEngine() {}
+    void start() override { std::cout << "Start the electric engine" << std::endl; }
+    int Horsepower() const override { return 300; }
+};
+
+class TestEngine : public Engine
+{
+public:
+    TestEngine() {}
+    void start() override { std::cout << "Start the test engine" << std::endl; }
+    int Horsepower() const override { return 1; }
+};
+
+// The hand-wired car from DependencyInjection.cpp.
+class Car
+{
+private:
+    std::unique_ptr<Engine> engine;
+public:
+    Car(std::unique_ptr<Engine>&& e) : engine(std::move(e)) {}
+    void start() { engine->start(); }
+    int Horsepower() const { return engine->Horsepower(); }
+};
+
+// The container-built car. The engine is a member, not a pointer, so engine_.start() is a direct call.
+// The in_place constructor receives one "maker" per dependency and initializes the member from the maker's result,
+// which C++17 guarantees is constructed directly in engine_ (no copy, no move).
+template <typename E>
+class StaticCar
+{
+private:
+    E engine_;
+public:
+    template <typename MakeEngine>
+    explicit StaticCar(std::in_place_t, MakeEngine&& make_engine) : engine_(make_engine()) {}
+    void start() { engine_.start(); }
+    int Horsepower() const { return engine_.Horsepower(); }
+};
+
+// Tag type used as the key for "a car". It is never defined; keys only need to be distinct types.
+struct Vehicle;
+
+namespace di
+{
+    template <typename... Ts>
+    struct TypeList {};
+
+    // Binds Key to a concrete Impl. If DepKeys is not empty, Impl is constructed as Impl(std::in_place, make_dep...).
+    template <typename Key, typename Impl, typename... DepKeys>
+    struct Bind
+    {
+        using key = Key;
+        using deps = TypeList<DepKeys...>;
+        template <typename...>
+        using impl = Impl;
+    };
+
+    // Binds Key to Template<resolved DepKeys...>, e.g. BindTemplate<Vehicle, StaticCar, Engine> -> StaticCar<ElectricEngine>.
+    template <typename Key, template <typename...> class Template, typename... DepKeys>
+    struct BindTemplate
+    {
+        using key = Key;
+        using deps = TypeList<DepKeys...>;
+        template <typename... Resolved>
+        using impl = Template<Resolved...>;
+    };
+
+    enum class Status { ok, missing, cycle, ambiguous };
+
+    template <typename... Bindings>
+    class Injector
+    {
+        static constexpr std::size_t npos = sizeof...(Bindings);
+
+        template <typename Key>
+        static constexpr std::size_t Count()
+        {
+            return (std::size_t{ 0 } + ... + std::size_t{ std::is_same_v<Key, typename Bindings::key> });
+        }
+
+        template <typename Key>
+        static constexpr std::size_t IndexOf()
+        {
+            constexpr bool matches[] = { std::is_same_v<Key, typename Bindings::key>..., false };
+            std::size_t i = 0;
+            while (i < npos && !matches[i])
+            {
+                ++i;
+            }
+            return i;
+        }
+
+        template <typename Key>
+        using BindingFor = std::tuple_element_t<IndexOf<Key>(), std::tuple<Bindings...>>;
+
+        template <typename Key, typename... Visiting>
+        static constexpr Status Check()
+        {
+            if constexpr ((std::is_same_v<Key, Visiting> || ...))
+            {
+                return Status::cycle;
+            }
+            else if constexpr (Count<Key>() == 0)
+            {
+                return Status::missing;
+            }
+            else if constexpr (Count<Key>() > 1)
+            {
+                return Status::ambiguous;
+            }
+            else
+            {
+                return CheckDeps(typename BindingFor<Key>::deps{}, TypeList<Visiting..., Key>{});
+            }
+        }
+
+        template <typename... Deps, typename... Path>
+        static constexpr Status CheckDeps(TypeList<Deps...>, TypeList<Path...>)
+        {
+            Status status = Status::ok;
+            ((status = (status == Status::ok ? Check<Deps, Path...>() : status)), ...);
+            return status;
+        }
+
+        template <typename Key, typename DepList = typename BindingFor<Key>::deps>
+        struct ResolveImpl;
+
+        template <typename Key, typename... Deps>
+        struct ResolveImpl<Key, TypeList<Deps...>>
+        {
+            using type = typename BindingFor<Key>::template impl<typename ResolveImpl<Deps>::type...>;
+        };
+
+        template <typename Key, typename... Deps>
+        static constexpr typename ResolveImpl<Key>::type Build(TypeList<Deps...>)
+        {
+            using T = typename ResolveImpl<Key>::type;
+            if constexpr (sizeof...(Deps) == 0)
+            {
+                return T();
+            }
+            else
+            {
+                return T(std::in_place, [] { return Build<Deps>(typename BindingFor<Deps>::deps{}); }...);
+            }
+        }
+
+    public:
+        // Status of the graph rooted at Key. Usable in static_assert to check a binding set without building anything.
+        template <typename Key>
+        static constexpr Status Validate()
+        {
+            return Check<Key>();
+        }
+
+        // The concrete type Create<Key>() returns. Only valid for a graph that validates.
+        template <typename Key>
+        using Resolve = typename ResolveImpl<Key>::type;
+
+        template <typename Key>
+        static constexpr auto Create()
+        {
+            constexpr Status status = Validate<Key>();
+            static_assert(status != Status::missing, "di::Injector: a key in this graph has no binding");
+            static_assert(status != Status::cycle, "di::Injector: the bindings for this graph contain a cycle");
+            static_assert(status != Status::ambiguous, "di::Injector: a key in this graph is bound more than once");
+            if constexpr (status == Status::ok)
+            {
+                return Build<Key>(typename BindingFor<Key>::deps{});
+            }
+        }
+    };
+}
+
+// The production and test configurations differ only in which Engine binding they contain.
+using ProductionBindings = di::Injector<
+    di::Bind<Engine, ElectricEngine>,
+    di::BindTemplate<Vehicle, StaticCar, Engine>>;
+
+using TestBindings = di::Injector<
+    di::Bind<Engine, TestEngine>,
+    di::BindTemplate<Vehicle, StaticCar, Engine>>;
+
+static_assert(std::is_same_v<ProductionBindings::Resolve<Vehicle>, StaticCar<ElectricEngine>>);
+static_assert(std::is_same_v<TestBindings::Resolve<Vehicle>, StaticCar<TestEngine>>);
+
+// Validation is constexpr, so broken graphs can be checked without instantiating Create().
+// Calling Create<Vehicle>() on either of these would stop compilation with the matching static_assert message.
+struct Gearbox;
+struct Clutch;
+using MissingEngine = di::Injector<di::BindTemplate<Vehicle, StaticCar, Engine>>;
+using CyclicBindings = di::Injector<di::Bind<Gearbox, Engine, Clutch>, di::Bind<Clutch, Engine, Gearbox>>;
+static_assert(MissingEngine::Validate<Vehicle>() == di::Status::missing);
+static_assert(CyclicBindings::Validate<Gearbox>() == di::Status::cycle);
+
+// A conventional runtime container: one std::function factory per interface, looked up by std::type_index.
+class RuntimeInjector
+{
+private:
+    std::unordered_map<std::type_index, std::function<void*()>> factories_;
+public:
+    template <typename Interface, typename Impl, typename... Deps>
+    void Bind()
+    {
+        factories_[typeid(Interface)] = [this]
+        {
+            return static_cast<void*>(static_cast<Interface*>(new Impl(Resolve<Deps>()...)));
+        };
+    }
+
+    template <typename Interface>
+    std::unique_ptr<Interface> Resolve()
+    {
+        auto it = factories_.find(typeid(Interface));
+        if (it == factories_.end())
+        {
+            throw std::runtime_error(std::string("RuntimeInjector: no binding for ") + typeid(Interface).name());
+        }
+        return std::unique_ptr<Interface>(static_cast<Interface*>(it->second()));
+    }
+};
+
+// Optimization barrier: the compiler must assume `value` is read and may have been changed here, so a graph whose
+// construction is known at compile time still has to be built, and its result cannot be folded into a constant.
+template <typename T>
+inline void DoNotOptimize(T& value)
+{
+#if !defined(_MSC_VER) || defined(__clang__)
+    asm volatile("" : "+m"(value) : : "memory");
+#else
+    static void* volatile escape;
+    escape = const_cast<void*>(static_cast<const void*>(&value));
+    _ReadWriteBarrier();
+#endif
+}
+
+template <typename BuildCar>
+double NanosecondsPerGraph(int iterations, BuildCar&& build_car, long long& checksum)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        int horsepower = build_car();
+        DoNotOptimize(horsepower);
+        checksum += horsepower;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+int main()
+{
+    // Production configuration
+    auto car = ProductionBindings::Create<Vehicle>();
+    car.start();
+
+    // Test configuration: same code, different bindings
+    auto test_car = TestBindings::Create<Vehicle>();
+    test_car.start();
+
+    // Same graph through the runtime container
+    RuntimeInjector runtime;
+    runtime.Bind<Engine, ElectricEngine>();
+    runtime.Bind<Car, Car, Engine>();
+    runtime.Resolve<Car>()->start();
+
+    const int iterations = 5'000'000;
+    long long checksum = 0;
+
+    // Every row escapes the graph it built through DoNotOptimize. Without that, the compile-time graph (known entirely
+    // at compile time) is folded to a constant and its row measures an empty loop.
+    double hand = NanosecondsPerGraph(iterations, [] {
+        Car c(std::make_unique<ElectricEngine>());
+        DoNotOptimize(c);
+        return c.Horsepower();
+    }, checksum);
+
+    double compile_time = NanosecondsPerGraph(iterations, [] {
+        auto c = ProductionBindings::Create<Vehicle>();
+        DoNotOptimize(c);
+        return c.Horsepower();
+    }, checksum);
+
+    double map_based = NanosecondsPerGraph(iterations, [&runtime] {
+        auto c = runtime.Resolve<Car>();
+        DoNotOptimize(c);
+        return c->Horsepower();
+    }, checksum);
+
+    std::cout << std::endl << "Object-graph construction (Car + Engine), " << iterations << " graphs each:" << std::endl;
+    std::cout << "  hand wiring (unique_ptr + virtual): " << hand << " ns/graph" << std::endl;
+    std::cout << "  compile-time injector:              " << compile_time << " ns/graph" << std::endl;
+    std::cout << "  runtime map-based injector:         " << map_based << " ns/graph" << std::endl;
+    std::cout << "  (checksum " << checksum << ")" << std::endl;
+    return 0;
+}
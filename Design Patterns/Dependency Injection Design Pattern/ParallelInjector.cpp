@@ -0,0 +1,505 @@
+// ParallelInjector.cpp
+
+// Conceptual Description:
+// main() in DependencyInjection.cpp builds its object graph one node at a time. That is fine for a Car and an Engine,
+// but a real service has hundreds of nodes and many of them are slow to construct (loading tables, warming caches, opening pools).
+// Built one by one, startup time is the sum of every constructor. Most of those nodes do not depend on each other, though,
+// so startup only has to take as long as the slowest chain of dependencies.
+//
+// This container supports three scopes:
+//  - singleton: built once, eagerly, when Start() runs.
+//  - transient: built again on every Resolve().
+//  - lazy:      a singleton that is built on first Resolve(), by whichever thread gets there first.
+//
+// Start() sorts the eager singletons topologically and hands every node whose prerequisites are ready to a thread pool,
+// so independent branches of the graph are constructed concurrently.
+// Resolving a singleton that is already built takes a lock-free fast path: one acquire load of an atomic pointer.
+// Only the very first resolution of a node takes its mutex.
+// The whole graph, lazy and transient nodes included, is checked for missing bindings and cycles by Start() or by the first
+// Resolve() after a registration, so a cycle is reported instead of deadlocking on a build mutex or recursing without end.
+
+// Example Description:
+// In this example, a small service graph is registered with artificial initialization delays that stand in for slow work.
+// The same graph is started on a single worker (the sequential baseline) and on a pool of workers,
+// and each run prints a startup timeline with the construction window and worker of every node.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    static inline thread_local int worker_index_ = -1;
+
+public:
+    explicit ThreadPool(unsigned threads)
+    {
+        for (unsigned i = 0; i < std::max(1u, threads); ++i)
+        {
+            workers_.emplace_back([this, i] {
+                worker_index_ = static_cast<int>(i);
+                for (;;)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+                        if (stopping_ && tasks_.empty())
+                        {
+                            return;
+                        }
+                        task = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& w : workers_)
+        {
+            w.join();
+        }
+    }
+
+    void Submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    unsigned Size() const { return static_cast<unsigned>(workers_.size()); }
+
+    // Index of the pool worker running the caller, or -1 for threads that do not belong to a pool.
+    static int CurrentWorker() { return worker_index_; }
+};
+
+enum class Scope { singleton, transient, lazy };
+
+class Container
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Node
+    {
+        std::string name;
+        Scope scope;
+        std::vector<std::type_index> deps;
+        std::function<std::shared_ptr<void>(Container&)> factory;
+
+        // Published once: instance is written, then ready is stored with release ordering.
+        std::shared_ptr<void> instance;
+        std::atomic<void*> ready{ nullptr };
+        std::mutex build_mutex;
+
+        Clock::time_point built_begin, built_end;
+        int worker = -1;
+    };
+
+    std::unordered_map<std::type_index, std::unique_ptr<Node>> nodes_;
+    std::vector<Node*> registration_order_;
+    Clock::time_point start_time_;
+
+    // Set once the registrations have been checked; cleared by Register().
+    std::atomic<bool> checked_{ false };
+    std::mutex check_mutex_;
+
+    Node& Find(std::type_index key)
+    {
+        auto it = nodes_.find(key);
+        if (it == nodes_.end())
+        {
+            throw std::runtime_error(std::string("Container: no binding for ") + key.name());
+        }
+        return *it->second;
+    }
+
+    std::shared_ptr<void> Get(Node& node)
+    {
+        if (node.scope == Scope::transient)
+        {
+            return node.factory(*this);
+        }
+        // Fast path: already built, no lock taken.
+        if (node.ready.load(std::memory_order_acquire) != nullptr)
+        {
+            return node.instance;
+        }
+        return Build(node);
+    }
+
+    std::shared_ptr<void> Build(Node& node)
+    {
+        std::lock_guard<std::mutex> lock(node.build_mutex);
+        if (node.ready.load(std::memory_order_relaxed) == nullptr)
+        {
+            node.built_begin = Clock::now();
+            node.instance = node.factory(*this);
+            node.built_end = Clock::now();
+            node.worker = ThreadPool::CurrentWorker();
+            node.ready.store(node.instance.get(), std::memory_order_release);
+        }
+        return node.instance;
+    }
+
+    enum class Mark { unvisited, on_path, done };
+
+    // Depth-first search from `node`; `path` holds the nodes on the current chain, to name the cycle.
+    void CheckFrom(Node& node, std::unordered_map<Node*, Mark>& marks, std::vector<Node*>& path)
+    {
+        Mark& mark = marks[&node];
+        if (mark == Mark::done)
+        {
+            return;
+        }
+        if (mark == Mark::on_path)
+        {
+            std::string cycle;
+            for (auto it = std::find(path.begin(), path.end(), &node); it != path.end(); ++it)
+            {
+                cycle += (*it)->name + " -> ";
+            }
+            throw std::logic_error("Container: dependency cycle " + cycle + node.name);
+        }
+        mark = Mark::on_path;
+        path.push_back(&node);
+        for (auto dep : node.deps)
+        {
+            CheckFrom(Find(dep), marks, path);
+        }
+        path.pop_back();
+        marks[&node] = Mark::done;
+    }
+
+    // Throws on a missing binding or a cycle anywhere in the graph. Done once per set of registrations.
+    void CheckGraph()
+    {
+        if (checked_.load(std::memory_order_acquire))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(check_mutex_);
+        if (!checked_.load(std::memory_order_relaxed))
+        {
+            std::unordered_map<Node*, Mark> marks;
+            std::vector<Node*> path;
+            for (Node* n : registration_order_)
+            {
+                CheckFrom(*n, marks, path);
+            }
+            checked_.store(true, std::memory_order_release);
+        }
+    }
+
+    // Eager singletons that must be built before `node`, looking through transient and lazy nodes,
+    // because those are built inline by whoever resolves them. The graph must already have passed CheckGraph().
+    void CollectEagerPrerequisites(Node& node, std::vector<Node*>& out)
+    {
+        for (auto dep : node.deps)
+        {
+            Node& d = Find(dep);
+            if (d.scope == Scope::singleton)
+            {
+                if (std::find(out.begin(), out.end(), &d) == out.end())
+                {
+                    out.push_back(&d);
+                }
+            }
+            else
+            {
+                CollectEagerPrerequisites(d, out);
+            }
+        }
+    }
+
+public:
+    template <typename Interface, typename Impl, typename... Deps>
+    void Register(Scope scope, std::string name)
+    {
+        if (nodes_.count(typeid(Interface)) != 0)
+        {
+            throw std::logic_error("Container: " + name + " is already registered");
+        }
+        auto node = std::make_unique<Node>();
+        node->name = std::move(name);
+        node->scope = scope;
+        node->deps = { std::type_index(typeid(Deps))... };
+        node->factory = [](Container& c) -> std::shared_ptr<void> {
+            std::shared_ptr<Interface> p = std::make_shared<Impl>(c.Resolve<Deps>()...);
+            return p;
+        };
+        registration_order_.push_back(node.get());
+        nodes_[typeid(Interface)] = std::move(node);
+        checked_.store(false, std::memory_order_relaxed);
+    }
+
+    template <typename Interface>
+    std::shared_ptr<Interface> Resolve()
+    {
+        CheckGraph();
+        return std::static_pointer_cast<Interface>(Get(Find(typeid(Interface))));
+    }
+
+    // Builds every eager singleton, running independent nodes concurrently on the pool.
+    // Throws on a missing binding or a cycle before anything is built, and rethrows the first constructor failure.
+    void Start(ThreadPool& pool)
+    {
+        CheckGraph();
+        start_time_ = Clock::now();
+
+        std::vector<Node*> eager;
+        for (Node* n : registration_order_)
+        {
+            if (n->scope == Scope::singleton)
+            {
+                eager.push_back(n);
+            }
+        }
+
+        std::unordered_map<Node*, std::vector<Node*>> dependents;
+        std::unordered_map<Node*, int> pending;
+        for (Node* n : eager)
+        {
+            std::vector<Node*> prerequisites;
+            CollectEagerPrerequisites(*n, prerequisites);
+            pending[n] = static_cast<int>(prerequisites.size());
+            for (Node* p : prerequisites)
+            {
+                dependents[p].push_back(n);
+            }
+        }
+
+        std::unordered_map<Node*, std::atomic<int>> remaining_prerequisites;
+        for (Node* n : eager)
+        {
+            remaining_prerequisites[n].store(pending[n]);
+        }
+
+        std::mutex done_mutex;
+        std::condition_variable done;
+        std::size_t finished = 0;
+        std::exception_ptr failure;
+        std::atomic<bool> failed{ false };
+
+        std::function<void(Node*)> schedule = [&](Node* n) {
+            pool.Submit([&, n] {
+                if (!failed.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        Get(*n);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(done_mutex);
+                        if (!failure)
+                        {
+                            failure = std::current_exception();
+                        }
+                        failed.store(true);
+                    }
+                }
+                auto it = dependents.find(n);
+                for (Node* d : it != dependents.end() ? it->second : std::vector<Node*>{})
+                {
+                    if (remaining_prerequisites.at(d).fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    {
+                        schedule(d);
+                    }
+                }
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if (++finished == eager.size())
+                {
+                    done.notify_one();
+                }
+            });
+        };
+
+        for (Node* n : eager)
+        {
+            if (pending[n] == 0)
+            {
+                schedule(n);
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.wait(lock, [&] { return finished == eager.size(); });
+        if (failure)
+        {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // One line per built singleton or lazy node, ordered by construction start, with offsets relative to Start().
+    void PrintTimeline(std::ostream& os) const
+    {
+        std::vector<const Node*> built;
+        for (const Node* n : registration_order_)
+        {
+            if (n->scope != Scope::transient && n->ready.load(std::memory_order_acquire) != nullptr)
+            {
+                built.push_back(n);
+            }
+        }
+        std::sort(built.begin(), built.end(), [](const Node* a, const Node* b) { return a->built_begin < b->built_begin; });
+
+        auto ms = [this](Clock::time_point t) { return std::chrono::duration<double, std::milli>(t - start_time_).count(); };
+        double total = 0;
+        for (const Node* n : built)
+        {
+            total = std::max(total, ms(n->built_end));
+        }
+
+        const int width = 40;
+        for (const Node* n : built)
+        {
+            double begin = ms(n->built_begin), end = ms(n->built_end);
+            int from = total > 0 ? static_cast<int>(begin / total * width) : 0;
+            int to = total > 0 ? std::max(from + 1, static_cast<int>(end / total * width)) : 1;
+            os << "  " << std::left << std::setw(12) << n->name
+               << (n->scope == Scope::lazy ? " lazy " : "      ")
+               << std::right << std::fixed << std::setprecision(1)
+               << std::setw(7) << begin << " -> " << std::setw(7) << end << " ms"
+               << "  worker " << std::setw(2) << n->worker << "  |"
+               << std::string(from, ' ') << std::string(to - from, '#') << std::string(std::max(0, width - to), ' ') << "|\n";
+        }
+        os << "  last node finished after " << total << " ms" << std::endl;
+    }
+};
+
+// A stand-in for slow initialization work.
+void Initialize(int milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+struct Config { Config() { Initialize(20); } };
+
+struct GeoTable
+{
+    GeoTable(std::shared_ptr<Config>) { Initialize(80); }
+};
+
+struct PriceTable
+{
+    PriceTable(std::shared_ptr<Config>) { Initialize(60); }
+};
+
+struct Database
+{
+    Database(std::shared_ptr<Config>) { Initialize(50); }
+};
+
+struct Cache
+{
+    Cache(std::shared_ptr<Database>) { Initialize(70); }
+};
+
+// Each Request is transient: cheap, and a new one for every Resolve().
+struct Request
+{
+    Request(std::shared_ptr<Cache>) {}
+};
+
+struct Router
+{
+    Router(std::shared_ptr<GeoTable>) { Initialize(30); }
+};
+
+struct Pricing
+{
+    Pricing(std::shared_ptr<PriceTable>, std::shared_ptr<Cache>) { Initialize(40); }
+};
+
+struct ReportGenerator
+{
+    ReportGenerator(std::shared_ptr<Database>) { Initialize(100); }
+};
+
+struct Application
+{
+    Application(std::shared_ptr<Router>, std::shared_ptr<Pricing>) { Initialize(10); }
+};
+
+void RegisterServices(Container& c)
+{
+    c.Register<Config, Config>(Scope::singleton, "Config");
+    c.Register<GeoTable, GeoTable, Config>(Scope::singleton, "GeoTable");
+    c.Register<PriceTable, PriceTable, Config>(Scope::singleton, "PriceTable");
+    c.Register<Database, Database, Config>(Scope::singleton, "Database");
+    c.Register<Cache, Cache, Database>(Scope::singleton, "Cache");
+    c.Register<Request, Request, Cache>(Scope::transient, "Request");
+    c.Register<Router, Router, GeoTable>(Scope::singleton, "Router");
+    c.Register<Pricing, Pricing, PriceTable, Cache>(Scope::singleton, "Pricing");
+    c.Register<ReportGenerator, ReportGenerator, Database>(Scope::lazy, "Reports");
+    c.Register<Application, Application, Router, Pricing>(Scope::singleton, "Application");
+}
+
+void RunStartup(unsigned threads)
+{
+    Container container;
+    RegisterServices(container);
+    ThreadPool pool(threads);
+
+    std::cout << "Startup with " << pool.Size() << " worker(s):" << std::endl;
+    container.Start(pool);
+
+    // Lazy nodes are built on first use; resolve the report generator from several threads at once.
+    std::vector<std::thread> users;
+    for (int i = 0; i < 4; ++i)
+    {
+        users.emplace_back([&container] { container.Resolve<ReportGenerator>(); });
+    }
+    for (auto& u : users)
+    {
+        u.join();
+    }
+
+    auto a = container.Resolve<Request>();
+    auto b = container.Resolve<Request>();
+    std::cout << "  transient Request instances are distinct: " << std::boolalpha << (a != b) << std::endl;
+
+    container.PrintTimeline(std::cout);
+    std::cout << std::endl;
+}
+
+int main()
+{
+    RunStartup(1);
+    RunStartup(4);
+    return 0;
+}
@@ -0,0 +1,885 @@
+// SharedMemoryObserver.cpp
+
+// Pattern Description:
+// The Observer pattern lets a subject notify any number of observers when its state changes, without knowing who they are.
+// pushVsPullArchitecture.txt describes the push model: the subject sends each update to its observers as soon as it happens.
+// When the subject and its observers live in different processes, pushing every update through a socket costs a system call
+// and a copy on each side, per message, which is exactly the overhead the push model is supposed to avoid.
+
+// Example Description:
+// This file implements a cross-process Subject/Observer transport on top of a POSIX shared-memory ring buffer.
+//  - SharedRing maps a named shared-memory segment (shm_open + mmap) that holds a header and a ring of fixed-size slots.
+//  - SharedMemorySubject is the single publisher. Notify() copies an event into the next slot; Claim()/Commit() let the
+//    caller build the event directly in shared memory instead. Publishing never makes a system call unless a
+//    subscriber is asleep, in which case one futex wake is issued.
+//  - SharedMemorySubscriber runs in the observer's process. It registers a cursor in the header, and Dispatch() hands
+//    each new event to the attached Observers as a view into shared memory: nothing is copied on the way out.
+//    Subscribers that have nothing to read spin briefly and then sleep on a futex in the shared header.
+//  - Every slot carries a sequence number written seqlock-style: odd while the publisher is writing it, even once committed.
+//    A subscriber that falls more than a ring behind, or whose slot is overwritten while an observer is reading it,
+//    detects it from the sequence number, skips to the oldest event still intact and reports the loss through
+//    Observer::Overrun(). Observers that keep something derived from an event can call Event::Intact() to confirm
+//    the event was not overwritten while they read it.
+//  - With PublishPolicy::wait_for_subscribers the publisher instead waits (on a second futex) for the slowest live
+//    subscriber, so nothing is lost; subscribers whose process has died are evicted so they cannot stall it forever.
+//
+// main() shows a small price-feed example, then forks a subscriber process and measures round-trip latency and
+// one-way throughput against a Unix-domain socket baseline.
+//
+// Linux only: it relies on futex(2) for cross-process wake-ups.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free && sizeof(std::atomic<std::uint32_t>) == 4,
+    "futex words must be plain lock-free 32-bit atomics");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared counters must be lock-free to work across processes");
+
+namespace ipc
+{
+    inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+
+    // Spinning before sleeping only helps when the other process can run at the same time.
+    inline int SpinLimit(int multiprocessor_spins)
+    {
+        static const bool multiprocessor = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+        return multiprocessor ? multiprocessor_spins : 0;
+    }
+
+    // Cross-process futex calls (no FUTEX_PRIVATE_FLAG): the word lives in a shared mapping.
+    inline void FutexWait(std::atomic<std::uint32_t>& word, std::uint32_t expected, std::chrono::nanoseconds timeout)
+    {
+        const auto ns = std::max<std::int64_t>(0, timeout.count());
+        timespec ts{ static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+    }
+
+    inline void FutexWakeAll(std::atomic<std::uint32_t>& word)
+    {
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    constexpr std::uint32_t kMagic = 0x4f425352;   // "OBSR"
+    constexpr std::uint32_t kVersion = 1;
+    constexpr std::uint32_t kMaxSubscribers = 16;
+
+    struct alignas(64) SubscriberSlot
+    {
+        std::atomic<std::uint32_t> state;    // 0 free, 1 claimed, 2 active
+        std::atomic<std::int32_t> pid;
+        std::atomic<std::uint64_t> cursor;   // next sequence this subscriber will read
+        std::atomic<std::uint64_t> overruns;
+    };
+
+    struct RingHeader
+    {
+        std::atomic<std::uint32_t> magic;    // written last by the creator
+        std::uint32_t version;
+        std::uint32_t slot_size;             // bytes per slot, including the SlotHeader
+        std::uint32_t slot_count;            // power of two
+
+        alignas(64) std::atomic<std::uint64_t> head;   // events published so far
+
+        alignas(64) std::atomic<std::uint32_t> data_futex;   // bumped on publish when a subscriber sleeps
+        std::atomic<std::uint32_t> data_waiters;
+
+        alignas(64) std::atomic<std::uint32_t> space_futex;  // bumped on consume when the publisher sleeps
+        std::atomic<std::uint32_t> space_waiters;
+        std::atomic<std::uint32_t> subscriber_count;
+
+        SubscriberSlot subscribers[kMaxSubscribers];
+    };
+
+    struct alignas(16) SlotHeader
+    {
+        std::atomic<std::uint64_t> sequence;   // (seq << 1) | 1 while writing, (seq + 1) << 1 once committed
+        std::uint32_t type;
+        std::uint32_t size;
+    };
+
+    constexpr std::size_t RoundUp(std::size_t value, std::size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    constexpr std::size_t kSlotsOffset = RoundUp(sizeof(RingHeader), 64);
+
+    // A named shared-memory segment holding one ring. The creator owns the name and unlinks it on destruction.
+    class SharedRing
+    {
+    public:
+        static SharedRing Create(const std::string& name, std::uint32_t slot_count, std::uint32_t max_payload)
+        {
+            if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+                throw std::invalid_argument("slot_count must be a power of two");
+            }
+            const auto slot_size = static_cast<std::uint32_t>(RoundUp(sizeof(SlotHeader) + max_payload, 64));
+            const std::size_t bytes = kSlotsOffset + static_cast<std::size_t>(slot_size) * slot_count;
+
+            const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+            if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+                const int error = errno;
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::runtime_error("ftruncate failed: " + std::string(std::strerror(error)));
+            }
+            SharedRing ring(name, fd, bytes, true);
+
+            // The segment is zero-filled; construct the atomics in place and publish the header by setting magic last.
+            auto* header = new (ring.base_) RingHeader();
+            header->version = kVersion;
+            header->slot_size = slot_size;
+            header->slot_count = slot_count;
+            for (std::uint32_t i = 0; i < slot_count; ++i) new (ring.SlotAt(i)) SlotHeader();
+            header->magic.store(kMagic, std::memory_order_release);
+            return ring;
+        }
+
+        static SharedRing Open(const std::string& name)
+        {
+            const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0) throw std::runtime_error("shm_open(" + name + ") failed: " + std::strerror(errno));
+            struct stat st {};
+            if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < kSlotsOffset) {
+                close(fd);
+                throw std::runtime_error(name + " is not an observer ring");
+            }
+            SharedRing ring(name, fd, static_cast<std::size_t>(st.st_size), false);
+            const RingHeader& header = ring.Header();
+            if (header.magic.load(std::memory_order_acquire) != kMagic || header.version != kVersion ||
+                kSlotsOffset + static_cast<std::size_t>(header.slot_size) * header.slot_count > ring.size_) {
+                throw std::runtime_error(name + " has an unexpected layout");
+            }
+            return ring;
+        }
+
+        SharedRing(SharedRing&& other) noexcept
+            : name_(std::move(other.name_)), base_(other.base_), size_(other.size_), owner_(other.owner_)
+        {
+            other.base_ = nullptr;
+            other.owner_ = false;
+        }
+
+        SharedRing(const SharedRing&) = delete;
+        SharedRing& operator=(const SharedRing&) = delete;
+        SharedRing& operator=(SharedRing&&) = delete;
+
+        ~SharedRing()
+        {
+            if (base_ != nullptr) munmap(base_, size_);
+            if (owner_) shm_unlink(name_.c_str());
+        }
+
+        RingHeader& Header() const { return *static_cast<RingHeader*>(base_); }
+        std::uint32_t SlotCount() const { return Header().slot_count; }
+        std::uint32_t MaxPayload() const { return Header().slot_size - static_cast<std::uint32_t>(sizeof(SlotHeader)); }
+
+        SlotHeader* SlotAt(std::uint64_t sequence) const
+        {
+            const RingHeader& header = Header();
+            const std::size_t index = static_cast<std::size_t>(sequence & (header.slot_count - 1));
+            return reinterpret_cast<SlotHeader*>(static_cast<std::byte*>(base_) + kSlotsOffset + index * header.slot_size);
+        }
+
+        static std::byte* Payload(SlotHeader* slot) { return reinterpret_cast<std::byte*>(slot + 1); }
+
+    private:
+        SharedRing(std::string name, int fd, std::size_t size, bool owner) : name_(std::move(name)), size_(size), owner_(owner)
+        {
+            base_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (base_ == MAP_FAILED) {
+                base_ = nullptr;
+                if (owner_) shm_unlink(name_.c_str());
+                throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+            }
+        }
+
+        std::string name_;
+        void* base_ = nullptr;
+        std::size_t size_ = 0;
+        bool owner_ = false;
+    };
+
+    // A published event as an observer sees it: a view into the shared ring, valid during Observer::Update only.
+    class Event
+    {
+    public:
+        Event(const SlotHeader* slot, std::uint64_t sequence, std::uint32_t type, std::span<const std::byte> payload)
+            : slot_(slot), sequence_(sequence), type_(type), payload_(payload) {}
+
+        std::uint64_t Sequence() const { return sequence_; }
+        std::uint32_t Type() const { return type_; }
+        std::span<const std::byte> Payload() const { return payload_; }
+
+        // Reads the payload as a trivially copyable T, in place.
+        template <typename T>
+        const T& As() const
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "events carry raw bytes");
+            if (payload_.size() < sizeof(T)) throw std::length_error("event payload too small");
+            return *reinterpret_cast<const T*>(payload_.data());
+        }
+
+        // True if the publisher has not started overwriting this event's slot.
+        bool Intact() const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot_->sequence.load(std::memory_order_relaxed) == ((sequence_ + 1) << 1);
+        }
+
+    private:
+        const SlotHeader* slot_;
+        std::uint64_t sequence_;
+        std::uint32_t type_;
+        std::span<const std::byte> payload_;
+    };
+
+    class Observer
+    {
+    public:
+        virtual ~Observer() = default;
+        virtual void Update(const Event& event) = 0;
+        // `lost` events were overwritten before this observer could read them (or while it was reading the last one).
+        virtual void Overrun(std::uint64_t /* lost */) {}
+    };
+
+    enum class PublishPolicy
+    {
+        overwrite,              // never wait; slow subscribers are overrun
+        wait_for_subscribers,   // wait for the slowest live subscriber before reusing its slot
+    };
+
+    class SharedMemorySubject
+    {
+    public:
+        explicit SharedMemorySubject(SharedRing& ring, PublishPolicy policy = PublishPolicy::overwrite)
+            : ring_(ring), header_(ring.Header()), policy_(policy), next_(header_.head.load(std::memory_order_acquire)) {}
+
+        // Reserves the next slot and returns its payload area, for building an event directly in shared memory.
+        std::span<std::byte> Claim(std::size_t size)
+        {
+            if (size > ring_.MaxPayload()) throw std::length_error("event larger than a ring slot");
+            if (policy_ == PublishPolicy::wait_for_subscribers) {
+                while (next_ - SlowestCursor() >= header_.slot_count) WaitForSpace();
+            }
+            SlotHeader* slot = ring_.SlotAt(next_);
+            slot->sequence.store((next_ << 1) | 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            return { SharedRing::Payload(slot), size };
+        }
+
+        // Publishes the slot returned by the last Claim().
+        void Commit(std::uint32_t type, std::size_t size)
+        {
+            SlotHeader* slot = ring_.SlotAt(next_);
+            slot->type = type;
+            slot->size = static_cast<std::uint32_t>(size);
+            slot->sequence.store((next_ + 1) << 1, std::memory_order_release);
+            ++next_;
+            header_.head.store(next_, std::memory_order_seq_cst);
+            if (header_.data_waiters.load(std::memory_order_seq_cst) != 0) {
+                header_.data_futex.fetch_add(1, std::memory_order_release);
+                FutexWakeAll(header_.data_futex);
+            }
+        }
+
+        void Notify(std::uint32_t type, const void* data, std::size_t size)
+        {
+            std::span<std::byte> payload = Claim(size);
+            if (size != 0) std::memcpy(payload.data(), data, size);
+            Commit(type, size);
+        }
+
+        template <typename T>
+        void Notify(std::uint32_t type, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "events carry raw bytes");
+            Notify(type, &value, sizeof(T));
+        }
+
+        void SetPolicy(PublishPolicy policy) { policy_ = policy; }
+
+        std::uint32_t SubscriberCount() const { return header_.subscriber_count.load(std::memory_order_acquire); }
+
+        bool WaitForSubscribers(std::uint32_t count, std::chrono::milliseconds timeout) const
+        {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (SubscriberCount() < count) {
+                if (std::chrono::steady_clock::now() > deadline) return false;
+                usleep(100);
+            }
+            return true;
+        }
+
+    private:
+        std::uint64_t SlowestCursor() const
+        {
+            std::uint64_t slowest = next_;
+            for (const SubscriberSlot& s : header_.subscribers) {
+                if (s.state.load(std::memory_order_acquire) == 2) slowest = std::min(slowest, s.cursor.load(std::memory_order_seq_cst));
+            }
+            return slowest;
+        }
+
+        void WaitForSpace()
+        {
+            for (int spin = 0, limit = SpinLimit(256); spin < limit; ++spin) {
+                if (next_ - SlowestCursor() < header_.slot_count) return;
+                CpuRelax();
+            }
+            header_.space_waiters.fetch_add(1, std::memory_order_seq_cst);
+            const std::uint32_t word = header_.space_futex.load(std::memory_order_acquire);
+            if (next_ - SlowestCursor() >= header_.slot_count) FutexWait(header_.space_futex, word, std::chrono::milliseconds(10));
+            header_.space_waiters.fetch_sub(1, std::memory_order_seq_cst);
+            EvictDeadSubscribers();
+        }
+
+        // A subscriber that died without detaching would block this publisher forever.
+        void EvictDeadSubscribers()
+        {
+            for (SubscriberSlot& s : header_.subscribers) {
+                if (s.state.load(std::memory_order_acquire) != 2) continue;
+                const pid_t pid = s.pid.load(std::memory_order_relaxed);
+                if (kill(pid, 0) != 0 && errno == ESRCH) {
+                    std::uint32_t active = 2;
+                    if (s.state.compare_exchange_strong(active, 0)) header_.subscriber_count.fetch_sub(1);
+                }
+            }
+        }
+
+        SharedRing& ring_;
+        RingHeader& header_;
+        PublishPolicy policy_;
+        std::uint64_t next_;
+    };
+
+    class SharedMemorySubscriber
+    {
+    public:
+        explicit SharedMemorySubscriber(SharedRing& ring) : ring_(ring), header_(ring.Header())
+        {
+            for (SubscriberSlot& s : header_.subscribers) {
+                std::uint32_t free_state = 0;
+                if (s.state.compare_exchange_strong(free_state, 1)) {
+                    slot_ = &s;
+                    break;
+                }
+            }
+            if (slot_ == nullptr) throw std::runtime_error("ring has no free subscriber slots");
+            // Start at the current head: a subscriber sees what is published after it attached.
+            cursor_ = header_.head.load(std::memory_order_acquire);
+            slot_->pid.store(getpid(), std::memory_order_relaxed);
+            slot_->cursor.store(cursor_, std::memory_order_relaxed);
+            slot_->overruns.store(0, std::memory_order_relaxed);
+            slot_->state.store(2, std::memory_order_release);
+            header_.subscriber_count.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        SharedMemorySubscriber(const SharedMemorySubscriber&) = delete;
+        SharedMemorySubscriber& operator=(const SharedMemorySubscriber&) = delete;
+
+        ~SharedMemorySubscriber()
+        {
+            std::uint32_t active = 2;
+            if (slot_->state.compare_exchange_strong(active, 0)) header_.subscriber_count.fetch_sub(1, std::memory_order_acq_rel);
+            WakePublisher();
+        }
+
+        void Attach(Observer& observer) { observers_.push_back(&observer); }
+        void Detach(Observer& observer) { observers_.erase(std::remove(observers_.begin(), observers_.end(), &observer), observers_.end()); }
+
+        std::uint64_t Overruns() const { return overruns_; }
+
+        // Delivers every event published so far to the attached observers, waiting up to `timeout` for the first one.
+        // Returns the number of events delivered.
+        std::size_t Dispatch(std::chrono::nanoseconds timeout)
+        {
+            std::uint64_t head = header_.head.load(std::memory_order_acquire);
+            if (head == cursor_) {
+                if (!WaitForData(timeout)) return 0;
+                head = header_.head.load(std::memory_order_acquire);
+            }
+
+            std::size_t delivered = 0;
+            while (cursor_ != head) {
+                if (head - cursor_ > header_.slot_count) {
+                    SkipTo(OldestIntact(head));
+                    continue;
+                }
+                SlotHeader* slot = ring_.SlotAt(cursor_);
+                const std::uint64_t expected = (cursor_ + 1) << 1;
+                const std::uint64_t before = slot->sequence.load(std::memory_order_acquire);
+                if (before != expected) {
+                    // Already being rewritten for a later lap.
+                    head = header_.head.load(std::memory_order_acquire);
+                    SkipTo(OldestIntact(head));
+                    continue;
+                }
+                const std::uint32_t size = std::min(slot->size, ring_.MaxPayload());
+                const Event event(slot, cursor_, slot->type, { SharedRing::Payload(slot), size });
+                for (Observer* observer : observers_) observer->Update(event);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot->sequence.load(std::memory_order_relaxed) != before) {
+                    // Overwritten while the observers were reading it: count it as lost too.
+                    head = header_.head.load(std::memory_order_acquire);
+                    SkipTo(OldestIntact(head));
+                    continue;
+                }
+                ++cursor_;
+                ++delivered;
+                slot_->cursor.store(cursor_, std::memory_order_seq_cst);
+                if (cursor_ == head) head = header_.head.load(std::memory_order_acquire);
+            }
+            WakePublisher();
+            return delivered;
+        }
+
+    private:
+        // The slot after `head` may already be half-written, so the oldest safe event is one newer than a full lap.
+        std::uint64_t OldestIntact(std::uint64_t head) const
+        {
+            return head > header_.slot_count ? head - header_.slot_count + 1 : 0;
+        }
+
+        void SkipTo(std::uint64_t cursor)
+        {
+            const std::uint64_t lost = cursor > cursor_ ? cursor - cursor_ : 1;
+            cursor_ = std::max(cursor, cursor_ + 1);
+            overruns_ += lost;
+            slot_->overruns.fetch_add(lost, std::memory_order_relaxed);
+            slot_->cursor.store(cursor_, std::memory_order_seq_cst);
+            for (Observer* observer : observers_) observer->Overrun(lost);
+        }
+
+        bool WaitForData(std::chrono::nanoseconds timeout)
+        {
+            for (int spin = 0, limit = SpinLimit(512); spin < limit; ++spin) {
+                if (header_.head.load(std::memory_order_acquire) != cursor_) return true;
+                CpuRelax();
+            }
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            while (true) {
+                header_.data_waiters.fetch_add(1, std::memory_order_seq_cst);
+                const std::uint32_t word = header_.data_futex.load(std::memory_order_acquire);
+                const bool ready = header_.head.load(std::memory_order_seq_cst) != cursor_;
+                const auto remaining = deadline - std::chrono::steady_clock::now();
+                if (!ready && remaining > std::chrono::nanoseconds::zero()) {
+                    FutexWait(header_.data_futex, word, std::chrono::duration_cast<std::chrono::nanoseconds>(remaining));
+                }
+                header_.data_waiters.fetch_sub(1, std::memory_order_seq_cst);
+                if (header_.head.load(std::memory_order_acquire) != cursor_) return true;
+                if (std::chrono::steady_clock::now() >= deadline) return false;
+            }
+        }
+
+        void WakePublisher()
+        {
+            if (header_.space_waiters.load(std::memory_order_seq_cst) != 0) {
+                header_.space_futex.fetch_add(1, std::memory_order_release);
+                FutexWakeAll(header_.space_futex);
+            }
+        }
+
+        SharedRing& ring_;
+        RingHeader& header_;
+        SubscriberSlot* slot_ = nullptr;
+        std::uint64_t cursor_ = 0;
+        std::uint64_t overruns_ = 0;
+        std::vector<Observer*> observers_;
+    };
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Example and benchmark
+
+enum MessageType : std::uint32_t { PriceChanged = 1, Ping, Pong, Data, DataEnd, Done, Quit };
+
+struct Price
+{
+    char symbol[8];
+    double value;
+};
+
+// 64-byte benchmark message.
+struct Message
+{
+    std::uint64_t sequence;
+    std::int64_t sent_ns;
+    std::uint64_t received;   // used by Done
+    std::uint64_t lost;       // used by Done
+    char padding[32];
+};
+
+static_assert(sizeof(Message) == 64, "benchmark messages are 64 bytes");
+
+std::int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class PricePrinter : public ipc::Observer
+{
+public:
+    void Update(const ipc::Event& event) override
+    {
+        if (event.Type() == PriceChanged) {
+            const Price& price = event.As<Price>();
+            std::printf("  [subscriber %d] %s is now %.2f\n", static_cast<int>(getpid()), price.symbol, price.value);
+        }
+        else if (event.Type() == Quit) {
+            done = true;
+        }
+    }
+    bool done = false;
+};
+
+// The subscriber side of the benchmark: echoes pings, counts data and reports when the data run ends.
+class BenchmarkResponder : public ipc::Observer
+{
+public:
+    explicit BenchmarkResponder(ipc::SharedMemorySubject& replies) : replies_(replies) {}
+
+    void Update(const ipc::Event& event) override
+    {
+        switch (event.Type()) {
+        case Ping:
+            // Echo straight from the request slot into the reply slot.
+            replies_.Notify(Pong, event.Payload().data(), event.Payload().size());
+            break;
+        case Data:
+            ++received_;
+            break;
+        case DataEnd: {
+            Message done{};
+            done.received = received_;
+            done.lost = lost_;
+            replies_.Notify(Done, done);
+            received_ = 0;
+            lost_ = 0;
+            break;
+        }
+        case Quit:
+            quit = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    void Overrun(std::uint64_t lost) override { lost_ += lost; }
+
+    bool quit = false;
+
+private:
+    ipc::SharedMemorySubject& replies_;
+    std::uint64_t received_ = 0;
+    std::uint64_t lost_ = 0;
+};
+
+// The publisher side: remembers the last reply it saw.
+class ReplyCollector : public ipc::Observer
+{
+public:
+    void Update(const ipc::Event& event) override
+    {
+        last_type = event.Type();
+        last = event.As<Message>();
+    }
+    std::uint32_t last_type = 0;
+    Message last{};
+};
+
+struct LatencyStats
+{
+    double p50_us;
+    double p99_us;
+    double mean_us;
+};
+
+LatencyStats Summarize(std::vector<std::int64_t>& rtts)
+{
+    std::sort(rtts.begin(), rtts.end());
+    double sum = 0;
+    for (auto r : rtts) sum += static_cast<double>(r);
+    return { rtts[rtts.size() / 2] / 1000.0, rtts[rtts.size() * 99 / 100] / 1000.0, sum / static_cast<double>(rtts.size()) / 1000.0 };
+}
+
+struct ThroughputStats
+{
+    double messages_per_second;
+    std::uint64_t received;
+    std::uint64_t lost;
+};
+
+// Latency is only measured once per transport; pass nullptr to leave those columns blank.
+void PrintResults(const char* transport, const LatencyStats* latency, const ThroughputStats& throughput)
+{
+    if (latency != nullptr) std::printf("%-32s %9.2f %9.2f %9.2f", transport, latency->p50_us, latency->p99_us, latency->mean_us);
+    else std::printf("%-32s %9s %9s %9s", transport, "", "", "");
+    std::printf(" %14.0f %9.1f %10llu %8llu\n",
+        throughput.messages_per_second, throughput.messages_per_second * sizeof(Message) / 1e6,
+        static_cast<unsigned long long>(throughput.received), static_cast<unsigned long long>(throughput.lost));
+}
+
+constexpr int kPings = 20000;
+constexpr std::uint64_t kMessages = 1000000;
+
+// Waits for the next reply on the reply ring; returns false on timeout.
+bool AwaitReply(ipc::SharedMemorySubscriber& replies, ReplyCollector& collector, std::uint32_t type)
+{
+    collector.last_type = 0;
+    while (collector.last_type != type) {
+        if (replies.Dispatch(std::chrono::seconds(5)) == 0) return false;
+    }
+    return true;
+}
+
+int RunSharedMemoryBenchmark()
+{
+    const std::string base = "/observer-bench-" + std::to_string(getpid());
+    ipc::SharedRing requests = ipc::SharedRing::Create(base + "-requests", 4096, sizeof(Message));
+    ipc::SharedRing replies = ipc::SharedRing::Create(base + "-replies", 1024, sizeof(Message));
+    ipc::SharedMemorySubscriber reply_subscriber(replies);
+    ReplyCollector collector;
+    reply_subscriber.Attach(collector);
+
+    std::fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) throw std::runtime_error("fork failed");
+    if (child == 0) {
+        int status = 0;
+        try {
+            // A separate process would do exactly this: open both rings by name.
+            ipc::SharedRing in = ipc::SharedRing::Open(base + "-requests");
+            ipc::SharedRing out = ipc::SharedRing::Open(base + "-replies");
+            ipc::SharedMemorySubject reply_subject(out, ipc::PublishPolicy::wait_for_subscribers);
+            ipc::SharedMemorySubscriber subscriber(in);
+            BenchmarkResponder responder(reply_subject);
+            subscriber.Attach(responder);
+            while (!responder.quit) {
+                if (subscriber.Dispatch(std::chrono::seconds(10)) == 0) {
+                    status = 3;
+                    break;
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::fprintf(stderr, "subscriber: %s\n", e.what());
+            status = 2;
+        }
+        _exit(status);
+    }
+
+    ipc::SharedMemorySubject publisher(requests, ipc::PublishPolicy::wait_for_subscribers);
+    if (!publisher.WaitForSubscribers(1, std::chrono::seconds(5))) throw std::runtime_error("subscriber did not attach");
+
+    std::vector<std::int64_t> rtts;
+    rtts.reserve(kPings);
+    for (int i = 0; i < kPings; ++i) {
+        Message ping{};
+        ping.sequence = static_cast<std::uint64_t>(i);
+        ping.sent_ns = NowNs();
+        publisher.Notify(Ping, ping);
+        if (!AwaitReply(reply_subscriber, collector, Pong)) throw std::runtime_error("no pong");
+        rtts.push_back(NowNs() - collector.last.sent_ns);
+    }
+    const LatencyStats latency = Summarize(rtts);
+
+    // One publisher per ring: it owns the write position.
+    auto run_throughput = [&](ipc::PublishPolicy policy) {
+        ipc::SharedMemorySubject& subject = publisher;
+        subject.SetPolicy(policy);
+        const auto start = std::chrono::steady_clock::now();
+        for (std::uint64_t i = 0; i < kMessages; ++i) {
+            // Build each message in place in the ring.
+            auto payload = subject.Claim(sizeof(Message));
+            auto* message = new (payload.data()) Message{};
+            message->sequence = i;
+            subject.Commit(Data, sizeof(Message));
+        }
+        subject.Notify(DataEnd, Message{});
+        if (!AwaitReply(reply_subscriber, collector, Done)) throw std::runtime_error("no done");
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return ThroughputStats{ static_cast<double>(kMessages) / seconds, collector.last.received, collector.last.lost };
+    };
+    const ThroughputStats lossless = run_throughput(ipc::PublishPolicy::wait_for_subscribers);
+    const ThroughputStats lossy = run_throughput(ipc::PublishPolicy::overwrite);
+
+    publisher.SetPolicy(ipc::PublishPolicy::wait_for_subscribers);
+    publisher.Notify(Quit, Message{});
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    PrintResults("shared memory (wait for subs)", &latency, lossless);
+    PrintResults("shared memory (overwrite)", nullptr, lossy);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+bool WriteMessage(int fd, std::uint32_t type, const Message& message)
+{
+    struct { std::uint32_t type; std::uint32_t pad; Message message; } frame{ type, 0, message };
+    return write(fd, &frame, sizeof(frame)) == static_cast<ssize_t>(sizeof(frame));
+}
+
+bool ReadMessage(int fd, std::uint32_t& type, Message& message)
+{
+    struct { std::uint32_t type; std::uint32_t pad; Message message; } frame{};
+    if (read(fd, &frame, sizeof(frame)) != static_cast<ssize_t>(sizeof(frame))) return false;
+    type = frame.type;
+    message = frame.message;
+    return true;
+}
+
+int RunSocketBenchmark()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) throw std::runtime_error("socketpair failed");
+
+    std::fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) throw std::runtime_error("fork failed");
+    if (child == 0) {
+        close(fds[0]);
+        std::uint64_t received = 0;
+        std::uint32_t type = 0;
+        Message message{};
+        while (ReadMessage(fds[1], type, message)) {
+            if (type == Ping) WriteMessage(fds[1], Pong, message);
+            else if (type == Data) ++received;
+            else if (type == DataEnd) {
+                Message done{};
+                done.received = received;
+                WriteMessage(fds[1], Done, done);
+                received = 0;
+            }
+            else if (type == Quit) break;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    const int fd = fds[0];
+
+    std::vector<std::int64_t> rtts;
+    rtts.reserve(kPings);
+    std::uint32_t type = 0;
+    Message reply{};
+    for (int i = 0; i < kPings; ++i) {
+        Message ping{};
+        ping.sequence = static_cast<std::uint64_t>(i);
+        ping.sent_ns = NowNs();
+        WriteMessage(fd, Ping, ping);
+        if (!ReadMessage(fd, type, reply) || type != Pong) throw std::runtime_error("no pong");
+        rtts.push_back(NowNs() - reply.sent_ns);
+    }
+    const LatencyStats latency = Summarize(rtts);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t i = 0; i < kMessages; ++i) {
+        Message message{};
+        message.sequence = i;
+        WriteMessage(fd, Data, message);
+    }
+    WriteMessage(fd, DataEnd, Message{});
+    if (!ReadMessage(fd, type, reply) || type != Done) throw std::runtime_error("no done");
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    WriteMessage(fd, Quit, Message{});
+    close(fd);
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    PrintResults("unix socket (SOCK_SEQPACKET)", &latency, { static_cast<double>(kMessages) / seconds, reply.received, 0 });
+    return 0;
+}
+
+void RunPriceFeedExample()
+{
+    const std::string name = "/observer-prices-" + std::to_string(getpid());
+    ipc::SharedRing ring = ipc::SharedRing::Create(name, 64, sizeof(Price));
+    ipc::SharedMemorySubject prices(ring, ipc::PublishPolicy::wait_for_subscribers);
+
+    std::fflush(stdout);
+    const pid_t child = fork();
+    if (child < 0) throw std::runtime_error("fork failed");
+    if (child == 0) {
+        ipc::SharedRing view = ipc::SharedRing::Open(name);
+        ipc::SharedMemorySubscriber subscriber(view);
+        PricePrinter printer;
+        subscriber.Attach(printer);
+        while (!printer.done && subscriber.Dispatch(std::chrono::seconds(5)) != 0) {}
+        std::fflush(stdout);
+        _exit(0);
+    }
+
+    prices.WaitForSubscribers(1, std::chrono::seconds(5));
+    prices.Notify(PriceChanged, Price{ "ACME", 101.25 });
+    prices.Notify(PriceChanged, Price{ "INITECH", 12.5 });
+    prices.Notify(PriceChanged, Price{ "ACME", 99.75 });
+    prices.Notify(Quit, Price{});
+    waitpid(child, nullptr, 0);
+}
+
+int main()
+{
+    try {
+        std::cout << "Price feed over shared memory:" << std::endl;
+        RunPriceFeedExample();
+
+        std::cout << std::endl << kPings << " round trips, then " << kMessages << " one-way messages of " << sizeof(Message) << " bytes" << std::endl;
+        std::printf("%-32s %9s %9s %9s %14s %9s %10s %8s\n", "transport", "p50 us", "p99 us", "mean us", "msgs/s", "MB/s", "received", "lost");
+        int status = RunSharedMemoryBenchmark();
+        status |= RunSocketBenchmark();
+        return status;
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
+
+#else
+
+int main()
+{
+    std::cout << "SharedMemoryObserver needs Linux: it uses POSIX shared memory and futex(2) for cross-process wake-ups." << std::endl;
+    return 0;
+}
+
+#endif
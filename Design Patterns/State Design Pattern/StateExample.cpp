@@ -4,7 +4,8 @@
 // The State design pattern is a behavioral design pattern that allows an object to change its behavior based on its internal state.
 // The pattern defines a set of state classes, each of which represents a specific behavior, and a context class that holds a reference to the current state.
 // The context class delegates requests to the current state, which can change the context's behavior by changing the reference to a different state class.
-#include <winsock2.h>
+
+#include "../../Common/Tracing.h"
 
 class TCPConnection;
 
@@ -19,27 +20,32 @@ public:
 class TCPConnection
 {
 public:
-    TCPConnection() : state_(new TCPListen()) {}
-    void ActiveOpen() { state_->Open(this); }
-    void PassiveOpen() { state_->Open(this); }
-    void Close() { state_->Close(this); }
-    void Send() { state_->Acknowledge(this); }
-    void ChangeState(TCPState* s) { state_ = s; }
+    TCPConnection();
+    void ActiveOpen() { TRACE_SCOPE("TCPConnection::ActiveOpen"); state_->Open(this); }
+    void PassiveOpen() { TRACE_SCOPE("TCPConnection::PassiveOpen"); state_->Open(this); }
+    void Close() { TRACE_SCOPE("TCPConnection::Close"); state_->Close(this); }
+    void Send() { TRACE_SCOPE("TCPConnection::Send"); state_->Acknowledge(this); }
+    void ChangeState(TCPState* s) { TRACE_INSTANT("TCPConnection::ChangeState"); state_ = s; }
 private:
     TCPState* state_;
 };
 
-class TCPListen : public TCPState
+// Each state is defined after the states it can move to, so the transitions below can construct them.
+
+class TCPClosed : public TCPState
 {
 public:
-    virtual void Open(TCPConnection* t)
-    {
-        // Send SYN, receive SYN, ACK, etc.
-        t->ChangeState(new TCPEstablished());
-    }
-    virtual void Close(TCPConnection* t)
-    {
-        // Send FIN, receive FIN, ACK, etc.
+    virtual void Open(TCPConnection* /* t */) { /* Do nothing */ }
+    virtual void Close(TCPConnection* /* t */) { /* Do nothing */ }
+    virtual void Acknowledge(TCPConnection* /* t */) { /* Do nothing */ }
+};
+
+class TCPCloseWait : public TCPState
+{
+public:
+    virtual void Open(TCPConnection* /* t */) { /* Do nothing */ }
+    virtual void Close(TCPConnection* t) {
+        // Send last ACK, receive FIN, etc.
         t->ChangeState(new TCPClosed());
     }
     virtual void Acknowledge(TCPConnection* /* t */) { /* Do nothing */ }
@@ -59,27 +65,28 @@ public:
     }
 };
 
-class TCPCloseWait : public TCPState
+class TCPListen : public TCPState
 {
 public:
-    virtual void Open(TCPConnection* /* t */) { /* Do nothing */ }
-    virtual void Close(TCPConnection* t) {
-        // Send last ACK, receive FIN, etc.
+    virtual void Open(TCPConnection* t)
+    {
+        // Send SYN, receive SYN, ACK, etc.
+        t->ChangeState(new TCPEstablished());
+    }
+    virtual void Close(TCPConnection* t)
+    {
+        // Send FIN, receive FIN, ACK, etc.
         t->ChangeState(new TCPClosed());
     }
     virtual void Acknowledge(TCPConnection* /* t */) { /* Do nothing */ }
 };
 
-class TCPClosed : public TCPState
-{
-public:
-    virtual void Open(TCPConnection* /* t */) { /* Do nothing */ }
-    virtual void Close(TCPConnection* /* t */) { /* Do nothing */ }
-    virtual void Acknowledge(TCPConnection* /* t */) { /* Do nothing */ }
-};
+TCPConnection::TCPConnection() : state_(new TCPListen()) {}
 
 int main()
 {
+    tracing::Session trace_session;
+
     TCPConnection conn;
     conn.ActiveOpen();  // Sends SYN, enters ESTABLISHED state
     conn.Send();        // Sends data, enters ESTABLISHED state
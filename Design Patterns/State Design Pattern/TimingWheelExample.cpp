@@ -0,0 +1,689 @@
+// TimingWheelExample.cpp
+
+// Builds on the State example (StateExample.cpp).
+// The TCP states there react only to Open, Close and Acknowledge. A real connection is also driven by time: data that is
+// not acknowledged is retransmitted after a timeout, a half-closed connection is abandoned if the peer never finishes,
+// and TIME_WAIT lasts for twice the maximum segment lifetime. A server holding a million connections has a million such
+// timers, nearly all of which are cancelled or reset before they fire.
+// A priority queue makes every arm O(log n), and cancelling either costs O(log n) too or leaves stale entries in the
+// heap until they reach the top. One OS timer per connection costs a system call per arm and per cancel.
+
+// Example Description:
+// TimingWheel is a hierarchical timing wheel (Varghese & Lauck) with 4 levels. One tick is 1 ms here.
+//  - Level 0 has one slot per tick, level 1 one slot per 64 ticks, level 2 one per 64 * 64 ticks, and so on, for a range
+//    of 2^24 ticks (~4.6 hours). Longer timers are parked at the top level.
+//  - Each level has 128 slots: enough for the rest of the current period of the level above and all of the next one.
+//    A timer is kept at the lowest level that reaches its expiry, so level 0 holds timers due in the current or the
+//    next 64-tick period, and so on.
+//  - Timers are intrusive: TCPConnection derives from TimerHook, a node of a doubly linked list. Arming computes the
+//    level and slot from the distance to the expiry and links the node; cancelling unlinks it. Both are O(1) and neither
+//    allocates.
+//  - Advance() moves the wheel forward one tick at a time. A classic wheel cascades a whole level-1 slot into level 0
+//    every 64 ticks, and a level-2 slot into level 1 every 4096, so those ticks stall. Here, the slot that comes next
+//    on each level is drained a share per tick into the exact slot one level down, so it is empty when its period
+//    starts and every tick does about the same amount of work.
+//  - Each tick's level-0 slot is detached as one batch, and the batch is then delivered: the callback may re-arm or
+//    cancel any timer, including ones later in the same batch.
+//
+// TCPConnection::Timeout() hands an expiry to the current state, as Open/Close/Acknowledge are handed over in
+// StateExample.cpp, and the state decides the transition:
+//  - Established retransmits with exponential backoff, and drops to Closed after too many attempts.
+//  - CloseWait gives up and moves to Closed.
+//  - TimeWait moves to Closed when 2*MSL has passed.
+// States are stateless, so each is a single shared instance rather than a new object per transition.
+//
+// main() walks one connection through its timers, then measures arm/cancel cost and per-tick latency against a
+// binary-heap timer queue, and runs the state machine for one million connections.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+// The intrusive list node a TimingWheel links. The wheel points at the hook while it is armed, so a hook can be neither
+// copied nor moved, and must be cancelled before it is destroyed.
+class TimerHook
+{
+public:
+    TimerHook() = default;
+    TimerHook(const TimerHook&) = delete;
+    TimerHook& operator=(const TimerHook&) = delete;
+
+    bool Armed() const { return state_ == State::armed; }
+    std::uint64_t Expires() const { return expires_; }
+
+private:
+    friend class TimingWheel;
+    enum class State : std::uint8_t { idle, armed, firing };
+
+    TimerHook* next_ = nullptr;
+    TimerHook* prev_ = nullptr;
+    std::uint64_t expires_ = 0;
+    std::uint16_t slot_ = 0;   // level * kLevelSlots + index while armed
+    State state_ = State::idle;
+};
+
+class TimingWheel
+{
+public:
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr unsigned kSlots = 1u << kSlotBits;
+    static constexpr unsigned kLevelSlots = 2 * kSlots;
+    static constexpr unsigned kLevels = 4;
+    static constexpr std::uint64_t kMaxDelay = (std::uint64_t{ 1 } << (kSlotBits * kLevels)) - 1;
+
+    explicit TimingWheel(std::uint64_t now = 0) : now_(now)
+    {
+        for (auto& level : levels_)
+        {
+            for (TimerHook& slot : level)
+            {
+                slot.next_ = slot.prev_ = &slot;
+            }
+        }
+    }
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    std::uint64_t Now() const { return now_; }
+    std::size_t Size() const { return armed_; }
+
+    // Arms (or re-arms) `timer` to fire at tick `expires`; a time that has already passed fires on the next tick.
+    void Arm(TimerHook& timer, std::uint64_t expires)
+    {
+        if (timer.state_ == TimerHook::State::armed)
+        {
+            Unlink(timer);
+            --armed_;
+        }
+        timer.expires_ = std::max(expires, now_ + 1);
+        timer.state_ = TimerHook::State::armed;
+        Insert(timer);
+        ++armed_;
+    }
+
+    void ArmAfter(TimerHook& timer, std::uint64_t delay) { Arm(timer, now_ + delay); }
+
+    // Returns false if the timer was not pending.
+    bool Cancel(TimerHook& timer)
+    {
+        switch (timer.state_)
+        {
+        case TimerHook::State::armed:
+            Unlink(timer);
+            --armed_;
+            timer.state_ = TimerHook::State::idle;
+            return true;
+        case TimerHook::State::firing:
+            // Detached with this tick's batch but not delivered yet.
+            timer.state_ = TimerHook::State::idle;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Advances the wheel to tick `now`, calling on_expire(TimerHook&) for every timer that fires on the way.
+    // Returns the number of timers fired.
+    template <typename OnExpire>
+    std::size_t Advance(std::uint64_t now, OnExpire&& on_expire)
+    {
+        std::size_t fired = 0;
+        while (now_ < now)
+        {
+            if (armed_ == 0)
+            {
+                now_ = now;  // every slot is empty
+                break;
+            }
+            ++now_;
+            Precascade();
+            fired += Expire(levels_[0][now_ & (kLevelSlots - 1)], on_expire);
+        }
+        return fired;
+    }
+
+private:
+    void Unlink(TimerHook& timer)
+    {
+        --counts_[timer.slot_];
+        timer.prev_->next_ = timer.next_;
+        timer.next_->prev_ = timer.prev_;
+        timer.next_ = timer.prev_ = nullptr;
+    }
+
+    // A level reaches an expiry that falls in the current or the next period of the level above it.
+    bool Reaches(unsigned level, std::uint64_t expires) const
+    {
+        const unsigned shift = kSlotBits * (level + 1);
+        return (expires >> shift) <= (now_ >> shift) + 1;
+    }
+
+    static unsigned IndexAt(unsigned level, std::uint64_t expires)
+    {
+        return static_cast<unsigned>((expires >> (kSlotBits * level)) & (kLevelSlots - 1));
+    }
+
+    void Insert(TimerHook& timer)
+    {
+        const std::uint64_t expires = std::min(timer.expires_, now_ + kMaxDelay);
+        unsigned level = 0;
+        while (!Reaches(level, expires))
+        {
+            ++level;
+        }
+        Link(timer, level, IndexAt(level, expires));
+    }
+
+    void Link(TimerHook& timer, unsigned level, unsigned index)
+    {
+        TimerHook& slot = levels_[level][index];
+        timer.slot_ = static_cast<std::uint16_t>(level * kLevelSlots + index);
+        ++counts_[timer.slot_];
+        timer.prev_ = slot.prev_;
+        timer.next_ = &slot;
+        slot.prev_->next_ = &timer;
+        slot.prev_ = &timer;
+    }
+
+    // Drains, a share per tick, the slot each level reaches next, sized so it is empty by the time its period starts.
+    // Those timers expire in the next period of their level, which the level below reaches, so each one is linked
+    // straight into its final slot there; level-0 slots then fire exactly on time. Nothing else is ever linked into a
+    // level's next slot (Insert puts such timers one level lower) except by this drain from the level above, whose
+    // deadline is the same tick. So slots never need cascading when their period starts. Higher levels go first, so
+    // timers they move down are drained further on the same tick if they are due.
+    void Precascade()
+    {
+        for (unsigned level = kLevels - 1; level > 0; --level)
+        {
+            const unsigned shift = kSlotBits * level;
+            const std::uint64_t next_period = (now_ >> shift) + 1;
+            const unsigned index = static_cast<unsigned>(next_period & (kLevelSlots - 1));
+            const std::uint32_t pending = counts_[level * kLevelSlots + index];
+            if (pending == 0)
+            {
+                continue;
+            }
+            const std::uint64_t ticks_left = (next_period << shift) - now_;
+            std::uint64_t budget = (pending + ticks_left - 1) / ticks_left;
+            TimerHook& slot = levels_[level][index];
+            for (; budget != 0 && slot.next_ != &slot; --budget)
+            {
+                TimerHook& timer = *slot.next_;
+                Unlink(timer);
+                if ((timer.expires_ >> shift) == next_period)
+                {
+                    Link(timer, level - 1, IndexAt(level - 1, timer.expires_));
+                }
+                else
+                {
+                    Insert(timer);   // parked beyond the wheel's range
+                }
+            }
+        }
+    }
+
+    template <typename OnExpire>
+    std::size_t Expire(TimerHook& slot, OnExpire& on_expire)
+    {
+        if (slot.next_ == &slot)
+        {
+            return 0;
+        }
+        // Detach the whole slot first, so callbacks can arm and cancel freely while the batch is delivered.
+        batch_.clear();
+        for (TimerHook* timer = slot.next_; timer != &slot;)
+        {
+            TimerHook* next = timer->next_;
+            timer->next_ = timer->prev_ = nullptr;
+            timer->state_ = TimerHook::State::firing;
+            batch_.push_back(timer);
+            timer = next;
+        }
+        slot.next_ = slot.prev_ = &slot;
+        counts_[&slot - &levels_[0][0]] = 0;
+        armed_ -= batch_.size();
+
+        std::size_t fired = 0;
+        for (TimerHook* timer : batch_)
+        {
+            if (timer->state_ == TimerHook::State::firing)
+            {
+                timer->state_ = TimerHook::State::idle;
+                on_expire(*timer);
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+    std::uint64_t now_;
+    std::size_t armed_ = 0;
+    std::array<std::array<TimerHook, kLevelSlots>, kLevels> levels_;
+    std::array<std::uint32_t, kLevelSlots * kLevels> counts_{};
+    std::vector<TimerHook*> batch_;
+};
+
+// Baseline: a binary heap with lazy cancellation. Cancelling bumps a generation number; the stale heap entry stays
+// until it reaches the top and is discarded.
+class HeapTimerQueue
+{
+public:
+    explicit HeapTimerQueue(std::size_t timers) : generation_(timers, 0), armed_(timers, false) {}
+
+    std::uint64_t Now() const { return now_; }
+
+    void Arm(std::uint32_t id, std::uint64_t expires)
+    {
+        armed_[id] = true;
+        heap_.push({ std::max(expires, now_ + 1), id, ++generation_[id] });
+    }
+
+    bool Cancel(std::uint32_t id)
+    {
+        if (!armed_[id]) return false;
+        armed_[id] = false;
+        ++generation_[id];
+        return true;
+    }
+
+    std::size_t HeapSize() const { return heap_.size(); }
+
+    template <typename OnExpire>
+    std::size_t Advance(std::uint64_t now, OnExpire&& on_expire)
+    {
+        now_ = now;
+        std::size_t fired = 0;
+        while (!heap_.empty() && heap_.top().expires <= now)
+        {
+            Entry entry = heap_.top();
+            heap_.pop();
+            if (armed_[entry.id] && generation_[entry.id] == entry.generation)
+            {
+                armed_[entry.id] = false;
+                on_expire(entry.id);
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t expires;
+        std::uint32_t id;
+        std::uint32_t generation;
+        bool operator>(const Entry& other) const { return expires > other.expires; }
+    };
+
+    std::uint64_t now_ = 0;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap_;
+    std::vector<std::uint32_t> generation_;
+    std::vector<bool> armed_;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// TCP states driven by the timing wheel
+
+// Timeouts in ticks (ms). TIME_WAIT is 2*MSL; it is kept short here so the simulation finishes quickly.
+constexpr std::uint64_t kCloseWaitTimeout = 5000;
+constexpr std::uint64_t kTimeWaitTimeout = 4000;
+constexpr unsigned kMaxRetransmits = 5;
+
+struct TimeoutStats
+{
+    std::uint64_t retransmits = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t close_wait_expired = 0;
+    std::uint64_t time_wait_expired = 0;
+};
+
+inline TimeoutStats timeout_stats;
+
+class TCPConnection;
+
+class TCPState
+{
+public:
+    virtual ~TCPState() = default;
+    virtual const char* Name() const = 0;
+    // Events a state does not handle are ignored.
+    virtual void Open(TCPConnection* /* t */) {}
+    virtual void Close(TCPConnection* /* t */) {}
+    virtual void Send(TCPConnection* /* t */) {}
+    virtual void Acknowledge(TCPConnection* /* t */) {}
+    virtual void Timeout(TCPConnection* /* t */) {}
+};
+
+class TCPConnection : public TimerHook
+{
+public:
+    // `rto` is the initial retransmission timeout; a real stack derives it from measured round-trip times.
+    TCPConnection(TimingWheel& wheel, std::uint32_t rto);
+
+    void PassiveOpen() { state_->Open(this); }
+    void Send() { state_->Send(this); }
+    void Acknowledge() { state_->Acknowledge(this); }
+    void Close() { state_->Close(this); }
+    // Called by the timing wheel when this connection's timer fires.
+    void Timeout() { state_->Timeout(this); }
+
+    void ChangeState(TCPState* s) { state_ = s; }
+    const TCPState* State() const { return state_; }
+
+    void ArmTimer(std::uint64_t delay) { wheel_->ArmAfter(*this, delay); }
+    void CancelTimer() { wheel_->Cancel(*this); }
+
+    std::uint32_t Rto() const { return rto_; }
+    unsigned Retransmits() const { return retransmits_; }
+    void SetRetransmits(unsigned retransmits) { retransmits_ = static_cast<std::uint8_t>(retransmits); }
+
+private:
+    TCPState* state_;
+    TimingWheel* wheel_;
+    std::uint32_t rto_;
+    std::uint8_t retransmits_ = 0;
+};
+
+class TCPClosed : public TCPState
+{
+public:
+    const char* Name() const override { return "CLOSED"; }
+};
+
+class TCPTimeWait : public TCPState
+{
+public:
+    const char* Name() const override { return "TIME_WAIT"; }
+    void Timeout(TCPConnection* t) override;
+};
+
+class TCPCloseWait : public TCPState
+{
+public:
+    const char* Name() const override { return "CLOSE_WAIT"; }
+    void Close(TCPConnection* t) override;
+    void Timeout(TCPConnection* t) override;
+};
+
+class TCPEstablished : public TCPState
+{
+public:
+    const char* Name() const override { return "ESTABLISHED"; }
+    void Close(TCPConnection* t) override;
+    void Send(TCPConnection* t) override;
+    void Acknowledge(TCPConnection* t) override;
+    void Timeout(TCPConnection* t) override;
+};
+
+class TCPListen : public TCPState
+{
+public:
+    const char* Name() const override { return "LISTEN"; }
+    void Open(TCPConnection* t) override;
+    void Close(TCPConnection* t) override;
+};
+
+// One shared instance per state: the states carry no per-connection data.
+inline TCPClosed closed_state;
+inline TCPTimeWait time_wait_state;
+inline TCPCloseWait close_wait_state;
+inline TCPEstablished established_state;
+inline TCPListen listen_state;
+
+TCPConnection::TCPConnection(TimingWheel& wheel, std::uint32_t rto) : state_(&listen_state), wheel_(&wheel), rto_(rto) {}
+
+void TCPTimeWait::Timeout(TCPConnection* t)
+{
+    ++timeout_stats.time_wait_expired;
+    t->ChangeState(&closed_state);
+}
+
+void TCPCloseWait::Close(TCPConnection* t)
+{
+    // Send last ACK, then linger in TIME_WAIT so stray segments from this connection die out.
+    t->ChangeState(&time_wait_state);
+    t->ArmTimer(kTimeWaitTimeout);
+}
+
+void TCPCloseWait::Timeout(TCPConnection* t)
+{
+    // The peer never finished closing.
+    ++timeout_stats.close_wait_expired;
+    t->ChangeState(&closed_state);
+}
+
+void TCPEstablished::Close(TCPConnection* t)
+{
+    // Send FIN, receive FIN, ACK, etc.
+    t->ChangeState(&close_wait_state);
+    t->ArmTimer(kCloseWaitTimeout);
+}
+
+void TCPEstablished::Send(TCPConnection* t)
+{
+    // Start the retransmission timer unless unacknowledged data is already being timed.
+    if (!t->Armed())
+    {
+        t->ArmTimer(t->Rto());
+    }
+}
+
+void TCPEstablished::Acknowledge(TCPConnection* t)
+{
+    // Everything outstanding is acknowledged.
+    t->CancelTimer();
+    t->SetRetransmits(0);
+}
+
+void TCPEstablished::Timeout(TCPConnection* t)
+{
+    if (t->Retransmits() >= kMaxRetransmits)
+    {
+        ++timeout_stats.dropped;
+        t->ChangeState(&closed_state);
+        return;
+    }
+    // Retransmit and back off exponentially.
+    ++timeout_stats.retransmits;
+    t->SetRetransmits(t->Retransmits() + 1);
+    t->ArmTimer(static_cast<std::uint64_t>(t->Rto()) << t->Retransmits());
+}
+
+void TCPListen::Open(TCPConnection* t)
+{
+    // Receive SYN, send SYN ACK, receive ACK.
+    t->ChangeState(&established_state);
+}
+
+void TCPListen::Close(TCPConnection* t)
+{
+    t->ChangeState(&closed_state);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Benchmarks
+
+using Clock = std::chrono::steady_clock;
+
+double NsPer(Clock::time_point start, Clock::time_point end, std::size_t operations)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(operations);
+}
+
+struct TickLatency
+{
+    std::vector<double> ns;
+    std::size_t max_batch = 0;
+    std::size_t fired = 0;
+
+    void Print(const char* label)
+    {
+        std::sort(ns.begin(), ns.end());
+        auto at = [&](double q) { return ns[std::min(ns.size() - 1, static_cast<std::size_t>(q * static_cast<double>(ns.size())))] / 1000.0; };
+        std::printf("  %-26s ticks %6zu  p50 %8.2f us  p99 %8.2f us  max %9.2f us  largest batch %7zu  fired %zu\n",
+            label, ns.size(), at(0.50), at(0.99), ns.back() / 1000.0, max_batch, fired);
+    }
+};
+
+// Advances tick by tick from the current time to `end`, timing each tick; `between` runs outside the timed region.
+template <typename Queue, typename OnExpire, typename Between>
+TickLatency DriveTicks(Queue& queue, std::uint64_t end, OnExpire on_expire, Between between)
+{
+    TickLatency latency;
+    latency.ns.reserve(static_cast<std::size_t>(end - queue.Now()));
+    for (std::uint64_t tick = queue.Now() + 1; tick <= end; ++tick)
+    {
+        between(tick);
+        const auto start = Clock::now();
+        const std::size_t fired = queue.Advance(tick, on_expire);
+        latency.ns.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        latency.max_batch = std::max(latency.max_batch, fired);
+        latency.fired += fired;
+    }
+    return latency;
+}
+
+// Arm every timer, cancel them all, arm them again, reset half of them (cancel + re-arm, as activity on a connection
+// does), then drain. Expiries are spread over 30 s.
+void CompareTimerQueues(std::size_t n)
+{
+    constexpr std::uint64_t kSpread = 30000;
+    std::mt19937_64 rng(7);
+    std::vector<std::uint64_t> expiry(n), reset(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        expiry[i] = 1 + rng() % kSpread;
+        reset[i] = 1 + rng() % kSpread;
+    }
+
+    std::printf("\n%zu timers, expiries spread over %llu ticks\n", n, static_cast<unsigned long long>(kSpread));
+    std::printf("  %-26s %10s %10s %10s %10s\n", "", "arm ns", "cancel ns", "re-arm ns", "reset ns");
+
+    {
+        TimingWheel wheel;
+        std::vector<TimerHook> timers(n);
+        const auto t0 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) wheel.Arm(timers[i], expiry[i]);
+        const auto t1 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) wheel.Cancel(timers[i]);
+        const auto t2 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) wheel.Arm(timers[i], expiry[i]);
+        const auto t3 = Clock::now();
+        for (std::size_t i = 0; i < n; i += 2) wheel.Arm(timers[i], reset[i]);
+        const auto t4 = Clock::now();
+        std::printf("  %-26s %10.1f %10.1f %10.1f %10.1f\n", "timing wheel", NsPer(t0, t1, n), NsPer(t1, t2, n), NsPer(t2, t3, n), NsPer(t3, t4, (n + 1) / 2));
+
+        auto latency = DriveTicks(wheel, kSpread, [](TimerHook&) {}, [](std::uint64_t) {});
+        latency.Print("timing wheel drain");
+    }
+    {
+        HeapTimerQueue heap(n);
+        const auto t0 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) heap.Arm(static_cast<std::uint32_t>(i), expiry[i]);
+        const auto t1 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) heap.Cancel(static_cast<std::uint32_t>(i));
+        const auto t2 = Clock::now();
+        for (std::size_t i = 0; i < n; ++i) heap.Arm(static_cast<std::uint32_t>(i), expiry[i]);
+        const auto t3 = Clock::now();
+        for (std::size_t i = 0; i < n; i += 2)
+        {
+            heap.Cancel(static_cast<std::uint32_t>(i));
+            heap.Arm(static_cast<std::uint32_t>(i), reset[i]);
+        }
+        const auto t4 = Clock::now();
+        std::printf("  %-26s %10.1f %10.1f %10.1f %10.1f   (heap holds %zu entries for %zu timers)\n", "binary heap",
+            NsPer(t0, t1, n), NsPer(t1, t2, n), NsPer(t2, t3, n), NsPer(t3, t4, (n + 1) / 2), heap.HeapSize(), n);
+
+        auto latency = DriveTicks(heap, kSpread, [](std::uint32_t) {}, [](std::uint64_t) {});
+        latency.Print("binary heap drain");
+    }
+}
+
+// One million connections: half send data, most of which is acknowledged, the rest close in various ways.
+// A trickle of acknowledgements arrives every tick, cancelling retransmission timers while the wheel runs.
+void SimulateConnections(std::size_t n)
+{
+    TimingWheel wheel;
+    std::deque<TCPConnection> connections;   // grows without moving the connections, which the wheel links
+    std::mt19937_64 rng(11);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        connections.emplace_back(wheel, static_cast<std::uint32_t>(200 + rng() % 100));
+    }
+    for (TCPConnection& c : connections) c.PassiveOpen();
+
+    std::printf("\n%zu connections\n", n);
+    const auto t0 = Clock::now();
+    for (TCPConnection& c : connections) c.Send();
+    const auto t1 = Clock::now();
+    for (TCPConnection& c : connections) c.Acknowledge();
+    const auto t2 = Clock::now();
+    std::printf("  Send (arms RTO timer) %.1f ns, Acknowledge (cancels it) %.1f ns per connection\n", NsPer(t0, t1, n), NsPer(t1, t2, n));
+
+    for (TCPConnection& c : connections)
+    {
+        const auto r = rng() % 100;
+        if (r < 40) { c.Send(); }                    // awaiting an acknowledgement
+        else if (r < 60) { c.Close(); }              // peer closed, application has not: CLOSE_WAIT
+        else if (r < 75) { c.Close(); c.Close(); }   // fully closed: TIME_WAIT
+    }
+
+    // Acknowledgements arriving during the run: 200 random connections per tick.
+    auto acks = [&](std::uint64_t) {
+        for (int i = 0; i < 200; ++i) connections[rng() % n].Acknowledge();
+    };
+    auto latency = DriveTicks(wheel, 20000, [](TimerHook& timer) { static_cast<TCPConnection&>(timer).Timeout(); }, acks);
+    latency.Print("state machine ticks");
+
+    std::printf("  retransmits %llu, dropped after %u retransmits %llu, CLOSE_WAIT expired %llu, TIME_WAIT expired %llu, timers still armed %zu\n",
+        static_cast<unsigned long long>(timeout_stats.retransmits), kMaxRetransmits,
+        static_cast<unsigned long long>(timeout_stats.dropped),
+        static_cast<unsigned long long>(timeout_stats.close_wait_expired),
+        static_cast<unsigned long long>(timeout_stats.time_wait_expired), wheel.Size());
+
+    std::size_t established = 0, closed = 0, other = 0;
+    for (const TCPConnection& c : connections)
+    {
+        if (c.State() == &established_state) ++established;
+        else if (c.State() == &closed_state) ++closed;
+        else ++other;
+    }
+    std::printf("  final states: ESTABLISHED %zu, CLOSED %zu, other %zu\n", established, closed, other);
+}
+
+int main(int argc, char* argv[])
+{
+    // One connection, stepped by hand.
+    TimingWheel wheel;
+    TCPConnection conn(wheel, 200);
+    auto advance = [&](std::uint64_t ticks) {
+        wheel.Advance(wheel.Now() + ticks, [](TimerHook& timer) { static_cast<TCPConnection&>(timer).Timeout(); });
+        std::cout << "  t=" << wheel.Now() << "ms " << conn.State()->Name() << ", retransmits " << conn.Retransmits() << std::endl;
+    };
+    conn.PassiveOpen();   // LISTEN -> ESTABLISHED
+    conn.Send();          // arms the retransmission timer (200 ms)
+    advance(250);         // timer fired: retransmitted, re-armed for 400 ms
+    conn.Acknowledge();   // cancels it
+    advance(1000);        // nothing fires
+    conn.Close();         // ESTABLISHED -> CLOSE_WAIT, 5 s timer
+    conn.Close();         // CLOSE_WAIT -> TIME_WAIT, 4 s timer replaces it
+    advance(3999);
+    advance(1);           // TIME_WAIT -> CLOSED
+
+    const std::size_t n = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    CompareTimerQueues(n);
+    SimulateConnections(n);
+    return 0;
+}
@@ -14,6 +14,8 @@
 #include <iostream>
 #include<vector>
 
+#include "../../Common/Tracing.h"
+
 class SortStrategy {
 public:
     virtual ~SortStrategy() = default;
@@ -70,13 +72,18 @@ private:
 class Sorter {
 public:
     Sorter(std::unique_ptr<SortStrategy> strategy) : strategy_(std::move(strategy)) {}
-    void Sort(std::vector<int>& data) { strategy_->Sort(data); }
+    void Sort(std::vector<int>& data) {
+        TRACE_SCOPE("Sorter::Sort");
+        TRACE_COUNTER("Sorter::Sort elements", data.size());
+        strategy_->Sort(data);
+    }
     void SetStrategy(std::unique_ptr<SortStrategy> strategy) { strategy_ = std::move(strategy); }
 private:
     std::unique_ptr<SortStrategy> strategy_;
 };
 
 int main() {
+    tracing::Session trace_session;
     std::vector<int> bubbleData = { 3, 4, 2, 1, 6, 5 };
     auto quickData = bubbleData;
     auto sorter = std::make_unique<Sorter>(std::make_unique<BubbleSort>());
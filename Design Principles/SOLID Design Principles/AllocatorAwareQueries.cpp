@@ -0,0 +1,630 @@
+// Allocator-Aware Queries
+
+// Builds on the Dependency Inversion (DependencyInversion.cpp), Open/Closed (openClosedPrinciple.cpp)
+// and Single Responsibility (SingleResponsibility.cpp) examples.
+// Every query there allocates on the global heap: Relationships::FinalAllChildrenOf returns a vector<Person> whose
+// names are fresh string copies, BetterFilter::Filter copies its whole input vector before it starts, and Journal
+// grows a vector<string> one entry at a time. Under load the allocator, not the query, becomes the hot spot.
+
+// Explanation of File:
+// The same three classes, with their containers and result types made allocator-aware through std::pmr:
+//  - Person is allocator-aware (it has an allocator_type), so a pmr::vector<Person> hands its allocator on to every name
+//    it stores. Relationships keeps its relations in whatever resource it was constructed with, and
+//    FinalAllChildrenOf builds its result in the resource the caller passes in.
+//  - BetterFilter reads its input through a span instead of copying it, and builds its result in the caller's resource.
+//  - Journal keeps its title and entries in the resource it was constructed with.
+//
+// Two resources are used:
+//  - RequestArena: per-request scratch memory. A monotonic_buffer_resource over a buffer the arena owns; allocation is a
+//    pointer bump, nothing is freed individually, and Reset() drops everything at once when the request is done.
+//    If a request outgrew the buffer, Reset() grows the buffer to that request's high-water mark, so in the steady state
+//    a request never reaches the global heap at all.
+//  - A synchronized_pool_resource for long-lived data (relations, journal entries) shared between threads.
+//    It serves small blocks from per-size pools and only asks its upstream for large chunks.
+//
+// Allocation counting: global operator new/delete are replaced to count heap allocations, and CountingResource
+// counts what reaches a resource's upstream. main() compares allocations, upstream allocations and time per query
+// for the original heap-allocating code and the pmr versions.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include <tuple>
+#include <memory_resource>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Allocation counting
+
+atomic<uint64_t> heap_allocations{ 0 };
+atomic<uint64_t> heap_bytes{ 0 };
+
+// GCC sees the malloc/free pair through the replaced operators once they are inlined and reports a mismatch that is not one.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size)
+{
+    heap_allocations.fetch_add(1, memory_order_relaxed);
+    heap_bytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// Counts the allocations a resource passes on to its upstream. Thread-safe if the upstream is.
+class CountingResource : public pmr::memory_resource
+{
+public:
+    explicit CountingResource(pmr::memory_resource* upstream = pmr::new_delete_resource()) : upstream(upstream) {}
+
+    uint64_t Allocations() const { return allocations.load(memory_order_relaxed); }
+    uint64_t Deallocations() const { return deallocations.load(memory_order_relaxed); }
+    uint64_t BytesAllocated() const { return bytes.load(memory_order_relaxed); }
+
+private:
+    void* do_allocate(size_t size, size_t alignment) override
+    {
+        allocations.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(size, memory_order_relaxed);
+        return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* p, size_t size, size_t alignment) override
+    {
+        deallocations.fetch_add(1, memory_order_relaxed);
+        upstream->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    pmr::memory_resource* upstream;
+    atomic<uint64_t> allocations{ 0 };
+    atomic<uint64_t> deallocations{ 0 };
+    atomic<uint64_t> bytes{ 0 };
+};
+
+// Scratch memory for one request; see the file comment. Not thread-safe: give each thread its own.
+class RequestArena
+{
+public:
+    explicit RequestArena(size_t initial_bytes = 16 * 1024, pmr::memory_resource* upstream = pmr::new_delete_resource())
+        : overflow(upstream), capacity(initial_bytes), buffer(new byte[initial_bytes]),
+          arena(in_place, buffer.get(), capacity, &overflow)
+    {
+    }
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    pmr::memory_resource* Resource() { return &*arena; }
+
+    // Frees everything allocated since the last Reset().
+    void Reset()
+    {
+        const uint64_t overflowed = overflow.BytesAllocated() - overflow_mark;
+        arena->release();
+        if (overflowed > 0)
+        {
+            // The request did not fit; size the buffer for the whole of it next time.
+            capacity += static_cast<size_t>(overflowed);
+            arena.reset();
+            buffer.reset(new byte[capacity]);
+            arena.emplace(buffer.get(), capacity, &overflow);
+        }
+        overflow_mark = overflow.BytesAllocated();
+    }
+
+    size_t Capacity() const { return capacity; }
+    uint64_t OverflowAllocations() const { return overflow.Allocations(); }
+
+private:
+    CountingResource overflow;
+    uint64_t overflow_mark = 0;
+    size_t capacity;
+    unique_ptr<byte[]> buffer;
+    optional<pmr::monotonic_buffer_resource> arena;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The original code, unchanged apart from living in its own namespace: every container uses the global heap.
+
+namespace heap
+{
+    enum class Relationship
+    {
+        parent,
+        child,
+        sibling
+    };
+
+    struct Person
+    {
+        string name;
+    };
+
+    struct Relationships
+    {
+        vector<tuple<Person, Relationship, Person>> relations;
+
+        void AddParentAndChild(const Person& parent, const Person& child)
+        {
+            relations.push_back({ parent, Relationship::parent, child });
+            relations.push_back({ child, Relationship::child, parent });
+        }
+
+        vector<Person> FinalAllChildrenOf(const string& name)
+        {
+            vector<Person> result;
+            for (auto&& [first, rel, second] : relations)
+            {
+                if (first.name == name && rel == Relationship::parent)
+                {
+                    result.push_back(second);
+                }
+            }
+            return result;
+        }
+    };
+
+    enum class Color { red, green, blue };
+    enum class Size { small, medium, large };
+
+    struct Product
+    {
+        string name;
+        Color color;
+        Size size;
+    };
+
+    template <typename T>
+    struct ISpecification
+    {
+        virtual bool IsSatisfied(T* item) = 0;
+    };
+
+    struct BetterFilter
+    {
+        vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec)
+        {
+            vector<Product*> result;
+            for (auto& item : items)
+            {
+                if (spec.IsSatisfied(item))
+                {
+                    result.push_back(item);
+                }
+            }
+            return result;
+        }
+    };
+
+    struct ColorSpecification : ISpecification<Product>
+    {
+        Color color;
+        ColorSpecification(Color color) : color(color) {}
+
+        bool IsSatisfied(Product* item) override
+        {
+            return item->color == color;
+        }
+    };
+
+    struct Journal
+    {
+        string title;
+        vector<string> entries;
+
+        Journal(const string& title) : title(title) {}
+
+        void AddEntry(const string& entry)
+        {
+            entries.push_back(entry);
+        }
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Dependency Inversion: allocator-aware Person and Relationships
+
+enum class Relationship
+{
+    parent,
+    child,
+    sibling
+};
+
+// A Person that takes an allocator, so containers of people can place every name in their own resource.
+// Copies use the default resource unless an allocator is given, as for pmr::string itself.
+struct Person
+{
+    using allocator_type = pmr::polymorphic_allocator<char>;
+
+    pmr::string name;
+
+    Person(const allocator_type& alloc = {}) : name(alloc) {}
+    Person(string_view name, const allocator_type& alloc = {}) : name(name, alloc) {}
+    Person(const Person& other, const allocator_type& alloc = {}) : name(other.name, alloc) {}
+    Person(Person&& other) noexcept = default;
+    Person(Person&& other, const allocator_type& alloc) : name(std::move(other.name), alloc) {}
+    Person& operator=(const Person&) = default;
+    Person& operator=(Person&&) = default;
+
+    allocator_type get_allocator() const { return name.get_allocator(); }
+};
+
+struct RelationshipBrowser
+{
+    virtual pmr::vector<Person> FinalAllChildrenOf(string_view name, pmr::memory_resource* resource = pmr::get_default_resource()) = 0;
+};
+
+struct Relationships : RelationshipBrowser
+{
+    pmr::vector<tuple<Person, Relationship, Person>> relations;
+
+    explicit Relationships(pmr::memory_resource* resource = pmr::get_default_resource()) : relations(resource) {}
+
+    void AddParentAndChild(const Person& parent, const Person& child)
+    {
+        // emplace_back constructs both people directly in the relations' resource.
+        relations.emplace_back(parent, Relationship::parent, child);
+        relations.emplace_back(child, Relationship::child, parent);
+    }
+
+    pmr::vector<Person> FinalAllChildrenOf(string_view name, pmr::memory_resource* resource = pmr::get_default_resource()) override
+    {
+        pmr::vector<Person> result(resource);
+        for (auto&& [first, rel, second] : relations)
+        {
+            if (first.name == name && rel == Relationship::parent)
+            {
+                result.push_back(second);
+            }
+        }
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Open/Closed: a filter that reads its input in place and builds its result in the caller's resource
+
+enum class Color { red, green, blue };
+enum class Size { small, medium, large };
+
+struct Product
+{
+    string name;
+    Color color;
+    Size size;
+};
+
+template <typename T>
+struct ISpecification
+{
+    virtual bool IsSatisfied(T* item) = 0;
+};
+
+template <typename T>
+struct IFilter
+{
+    virtual pmr::vector<T*> Filter(span<T* const> items, ISpecification<T>& spec, pmr::memory_resource* resource = pmr::get_default_resource()) = 0;
+};
+
+struct BetterFilter : IFilter<Product>
+{
+    pmr::vector<Product*> Filter(span<Product* const> items, ISpecification<Product>& spec, pmr::memory_resource* resource = pmr::get_default_resource()) override
+    {
+        pmr::vector<Product*> result(resource);
+        for (auto& item : items)
+        {
+            if (spec.IsSatisfied(item))
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+struct ColorSpecification : ISpecification<Product>
+{
+    Color color;
+    ColorSpecification(Color color) : color(color) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->color == color;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Single Responsibility: a Journal whose entries live in a caller-chosen resource
+
+struct Journal
+{
+    pmr::string title;
+    pmr::vector<pmr::string> entries;
+
+    Journal(string_view title, pmr::memory_resource* resource = pmr::get_default_resource()) : title(title, resource), entries(resource) {}
+
+    void AddEntry(string_view entry)
+    {
+        // The vector passes its allocator on, so each entry's characters land in the same resource.
+        entries.emplace_back(entry);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Benchmark
+
+struct QueryStats
+{
+    double heap_allocations_per_query;
+    double upstream_allocations_per_query;
+    double ns_per_query;
+};
+
+// Runs `queries` calls of query(thread, i) on each of `threads` threads and reports per-query averages.
+// upstream_allocations reads the upstream allocation count of the variant's resources; it is empty for the
+// original code, which has no resource of its own, and the column is then reported as "-".
+QueryStats Measure(int threads, int queries, const function<uint64_t()>& upstream_allocations, const function<void(int thread, int i)>& query)
+{
+    const uint64_t heap_before = heap_allocations.load();
+    const uint64_t upstream_before = upstream_allocations ? upstream_allocations() : 0;
+    const auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]
+        {
+            for (int i = 0; i < queries; ++i)
+            {
+                query(t, i);
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    const double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    const double total = static_cast<double>(threads) * queries;
+    // Starting and joining the workers allocates a few times; that is noise at these query counts.
+    return {
+        static_cast<double>(heap_allocations.load() - heap_before) / total,
+        upstream_allocations ? static_cast<double>(upstream_allocations() - upstream_before) / total : -1.0,
+        elapsed / total
+    };
+}
+
+void PrintRow(const char* query, const char* variant, const QueryStats& s)
+{
+    char upstream[32] = "-";
+    if (s.upstream_allocations_per_query >= 0)
+    {
+        snprintf(upstream, sizeof(upstream), "%.4f", s.upstream_allocations_per_query);
+    }
+    printf("%-22s %-24s %14.4f %18s %12.1f\n", query, variant, s.heap_allocations_per_query, upstream, s.ns_per_query);
+}
+
+string NameOf(int id)
+{
+    // Long enough to defeat the small-string optimization, like most real names with a family name attached.
+    return "Person number " + to_string(id) + " of the family tree";
+}
+
+int main()
+{
+    // Long-lived data shared by every thread lives in one synchronized pool.
+    CountingResource pool_upstream;
+    pmr::synchronized_pool_resource long_lived(&pool_upstream);
+
+    // The Dependency Inversion example, now allocator-aware.
+    {
+        Relationships relationships(&long_lived);
+        relationships.AddParentAndChild(Person{ "John" }, Person{ "Chris" });
+        relationships.AddParentAndChild(Person{ "John" }, Person{ "Matt" });
+
+        RequestArena arena;
+        for (auto& child : relationships.FinalAllChildrenOf("John", arena.Resource()))
+        {
+            cout << "John has a child called " << child.name << endl;
+        }
+        arena.Reset();
+    }
+
+    const int threads = static_cast<int>(max(2u, thread::hardware_concurrency()));
+    const int queries = 2000;
+    cout << endl << "Allocations and time per query, " << threads << " threads" << endl;
+    printf("%-22s %-24s %14s %18s %12s\n", "query", "variant", "heap allocs/q", "upstream allocs/q", "ns/q");
+
+    // Relationships: 2,000 parents with 2-6 children each, every query asks for one parent's children.
+    {
+        const int parents = 2000;
+        mt19937 rng(7);
+        uniform_int_distribution<int> children_per_parent(2, 6);
+
+        heap::Relationships before;
+        Relationships after(&long_lived);
+        int next_id = parents;
+        for (int p = 0; p < parents; ++p)
+        {
+            const int children = children_per_parent(rng);
+            for (int c = 0; c < children; ++c)
+            {
+                const string parent_name = NameOf(p);
+                const string child_name = NameOf(next_id++);
+                before.AddParentAndChild({ parent_name }, { child_name });
+                after.AddParentAndChild(Person{ parent_name }, Person{ child_name });
+            }
+        }
+
+        vector<string> asked(queries);
+        for (int i = 0; i < queries; ++i)
+        {
+            asked[i] = NameOf(static_cast<int>(rng() % parents));
+        }
+
+        atomic<size_t> found_before{ 0 };
+        PrintRow("FinalAllChildrenOf", "heap (original)", Measure(threads, queries, nullptr, [&](int, int i)
+        {
+            found_before += before.FinalAllChildrenOf(asked[i]).size();
+        }));
+
+        atomic<size_t> found_after{ 0 };
+        vector<unique_ptr<RequestArena>> arenas;
+        for (int t = 0; t < threads; ++t)
+        {
+            arenas.push_back(make_unique<RequestArena>(1024));
+        }
+        auto overflow = [&]
+        {
+            uint64_t total = 0;
+            for (auto& arena : arenas)
+            {
+                total += arena->OverflowAllocations();
+            }
+            return total;
+        };
+        PrintRow("FinalAllChildrenOf", "pmr, per-request arena", Measure(threads, queries, overflow, [&](int t, int i)
+        {
+            RequestArena& arena = *arenas[t];
+            found_after += after.FinalAllChildrenOf(asked[i], arena.Resource()).size();
+            arena.Reset();
+        }));
+        if (found_before != found_after)
+        {
+            cout << "  mismatch: " << found_before << " vs " << found_after << " children" << endl;
+        }
+    }
+
+    // BetterFilter: 100,000 products, every query asks for the green ones.
+    {
+        const int count = 100000;
+        mt19937 rng(11);
+        vector<heap::Product> heap_products(count);
+        vector<Product> products(count);
+        for (int i = 0; i < count; ++i)
+        {
+            const int color = static_cast<int>(rng() % 3);
+            const int size = static_cast<int>(rng() % 3);
+            heap_products[i] = { "Product " + to_string(i), static_cast<heap::Color>(color), static_cast<heap::Size>(size) };
+            products[i] = { "Product " + to_string(i), static_cast<Color>(color), static_cast<Size>(size) };
+        }
+        vector<heap::Product*> heap_items;
+        vector<Product*> items;
+        for (int i = 0; i < count; ++i)
+        {
+            heap_items.push_back(&heap_products[i]);
+            items.push_back(&products[i]);
+        }
+
+        const int filter_queries = 200;
+        heap::ColorSpecification heap_green(heap::Color::green);
+        heap::BetterFilter heap_filter;
+        atomic<size_t> matched_before{ 0 };
+        PrintRow("BetterFilter::Filter", "heap (original)", Measure(threads, filter_queries, nullptr, [&](int, int)
+        {
+            matched_before += heap_filter.Filter(heap_items, heap_green).size();
+        }));
+
+        ColorSpecification green(Color::green);
+        BetterFilter filter;
+        vector<unique_ptr<RequestArena>> arenas;
+        for (int t = 0; t < threads; ++t)
+        {
+            arenas.push_back(make_unique<RequestArena>());
+        }
+        auto overflow = [&]
+        {
+            uint64_t total = 0;
+            for (auto& arena : arenas)
+            {
+                total += arena->OverflowAllocations();
+            }
+            return total;
+        };
+        atomic<size_t> matched_after{ 0 };
+        PrintRow("BetterFilter::Filter", "pmr, per-request arena", Measure(threads, filter_queries, overflow, [&](int t, int)
+        {
+            RequestArena& arena = *arenas[t];
+            matched_after += filter.Filter(items, green, arena.Resource()).size();
+            arena.Reset();
+        }));
+        if (matched_before != matched_after)
+        {
+            cout << "  mismatch: " << matched_before << " vs " << matched_after << " products" << endl;
+        }
+        cout << "  arena grew to " << arenas[0]->Capacity() / 1024 << " KB after "
+             << arenas[0]->OverflowAllocations() << " overflow allocations" << endl;
+    }
+
+    // Journal: every thread keeps its own journal and appends to it; a "query" here is one AddEntry.
+    {
+        const int entries = 20000;
+        const string entry = "Today I learned that allocators can be swapped without touching the journal";
+        auto per_entry = [&](QueryStats s)
+        {
+            s.heap_allocations_per_query /= entries;
+            if (s.upstream_allocations_per_query > 0)
+            {
+                s.upstream_allocations_per_query /= entries;
+            }
+            s.ns_per_query /= entries;
+            return s;
+        };
+
+        PrintRow("Journal::AddEntry", "heap (original)", per_entry(Measure(threads, 1, nullptr, [&](int, int)
+        {
+            heap::Journal journal("My Journal");
+            for (int i = 0; i < entries; ++i)
+            {
+                journal.AddEntry(entry);
+            }
+        })));
+
+        PrintRow("Journal::AddEntry", "pmr, synchronized pool", per_entry(Measure(threads, 1, [&] { return pool_upstream.Allocations(); }, [&](int, int)
+        {
+            Journal journal("My Journal", &long_lived);
+            for (int i = 0; i < entries; ++i)
+            {
+                journal.AddEntry(entry);
+            }
+        })));
+    }
+
+    return 0;
+}
@@ -0,0 +1,443 @@
+// Batch Geometry
+
+// Builds on the Liskov Substitution example (LiskovSubstitutionPrinciple.cpp).
+// Every Rectangle there is its own heap object with virtual SetWidth/SetHeight, so resizing millions of shapes is
+// one pointer chase and one indirect call per shape, and int area() silently overflows once width * height > 2^31.
+
+// Explanation of File:
+// ShapeBatch keeps many shapes as columns: a width column, a height column and a kind tag per shape.
+//  - Squares stay valid: every operation that changes a square's width or height sets both, exactly like
+//    Square::SetWidth/SetHeight. The single-shape SetWidth/SetHeight have the same meaning as the virtual ones,
+//    and the bulk versions are the same operation applied to a range, so Process() gives the same answer either way.
+//  - Dimensions are never negative, so areas are computed as unsigned 32 x 32 -> 64-bit products and cannot overflow.
+//  - Totals are accumulated as separate sums of the low and high 32 bits of each area, which cannot overflow
+//    for fewer than 2^32 shapes per lane, and combined into an exact 128-bit total at the end.
+// The kernels use AVX2 when the compiler targets it (8 shapes per step) and plain loops otherwise.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include<fstream>
+#include <cstdint>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Per-object shapes from LiskovSubstitutionPrinciple.cpp, kept as the baseline
+class Rectangle
+{
+protected:
+    int width, height;
+public:
+    Rectangle(int width, int height) : width(width), height(height) {}
+    virtual ~Rectangle() = default;
+
+    virtual void SetWidth(int width)
+    {
+        Rectangle::width = width;
+    }
+
+    virtual void SetHeight(int height)
+    {
+        Rectangle::height = height;
+    }
+
+    int GetHeight() const noexcept
+    {
+        return height;
+    }
+
+    int GetWidth() const noexcept
+    {
+        return width;
+    }
+
+    int area() const noexcept { return width * height; }   // overflows for large shapes
+};
+
+class Square : public Rectangle
+{
+public:
+    Square(int size) : Rectangle(size, size) {}
+
+    void SetHeight(int height) override
+    {
+        this->width = this->height = height;
+    }
+
+    void SetWidth(int width) override
+    {
+        this->width = this->height = width;
+    }
+};
+
+// Process() from LiskovSubstitutionPrinciple.cpp without the printing: whether the area is what a caller
+// who only knows Rectangle would expect.
+bool Process(Rectangle& r)
+{
+    int64_t w = r.GetWidth();
+    r.SetHeight(10);
+    return int64_t{ r.GetWidth() } * r.GetHeight() == w * 10;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// Exact unsigned 128-bit total.
+struct AreaTotal
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    void Add(uint64_t value) noexcept
+    {
+        low += value;
+        high += low < value;
+    }
+
+    // Adds sum_low + sum_high * 2^32.
+    void AddSplit(uint64_t sum_low, uint64_t sum_high) noexcept
+    {
+        Add(sum_low);
+        Add(sum_high << 32);
+        high += sum_high >> 32;
+    }
+
+    bool FitsInt64() const noexcept { return high == 0 && low <= uint64_t(INT64_MAX); }
+    bool operator==(const AreaTotal&) const = default;
+
+    string ToString() const
+    {
+        // Repeated division by 10^9 over 32-bit limbs, most significant first.
+        uint32_t limbs[4] = { uint32_t(high >> 32), uint32_t(high), uint32_t(low >> 32), uint32_t(low) };
+        string digits;
+        for (;;)
+        {
+            uint64_t remainder = 0;
+            bool zero = true;
+            for (auto& limb : limbs)
+            {
+                uint64_t current = (remainder << 32) | limb;
+                limb = uint32_t(current / 1'000'000'000);
+                remainder = current % 1'000'000'000;
+                zero = zero && limb == 0;
+            }
+            char chunk[16];
+            snprintf(chunk, sizeof chunk, zero ? "%llu" : "%09llu", static_cast<unsigned long long>(remainder));
+            digits.insert(0, chunk);
+            if (zero) return digits;
+        }
+    }
+};
+
+enum class ShapeKind : uint8_t
+{
+    rectangle = 0,
+    square = 1
+};
+
+struct ShapeAggregates
+{
+    AreaTotal total_area;
+    uint64_t max_area = 0;
+    uint64_t squares = 0;
+};
+
+class ShapeBatch
+{
+private:
+    vector<int32_t> widths;
+    vector<int32_t> heights;
+    vector<ShapeKind> kinds;
+
+    static void CheckDimension(int32_t d)
+    {
+        if (d < 0) throw invalid_argument("ShapeBatch: dimensions must not be negative");
+    }
+
+    // Sets one dimension of [first, last) to `value`; squares get both dimensions set.
+    static void Assign(int32_t* target, int32_t* other, const ShapeKind* kind, size_t first, size_t last, int32_t value)
+    {
+        size_t i = first;
+#if defined(__AVX2__)
+        const __m256i v = _mm256_set1_epi32(value);
+        const __m256i square = _mm256_set1_epi32(static_cast<int>(ShapeKind::square));
+        for (; i + 8 <= last; i += 8)
+        {
+            __m128i k8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kind + i));
+            __m256i is_square = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(k8), square);
+            __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(other + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), v);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(other + i), _mm256_blendv_epi8(o, v, is_square));
+        }
+#endif
+        for (; i < last; ++i)
+        {
+            target[i] = value;
+            if (kind[i] == ShapeKind::square) other[i] = value;
+        }
+    }
+
+public:
+    size_t AddRectangle(int32_t width, int32_t height)
+    {
+        CheckDimension(width);
+        CheckDimension(height);
+        widths.push_back(width);
+        heights.push_back(height);
+        kinds.push_back(ShapeKind::rectangle);
+        return kinds.size() - 1;
+    }
+
+    size_t AddSquare(int32_t size)
+    {
+        CheckDimension(size);
+        widths.push_back(size);
+        heights.push_back(size);
+        kinds.push_back(ShapeKind::square);
+        return kinds.size() - 1;
+    }
+
+    void Reserve(size_t n)
+    {
+        widths.reserve(n);
+        heights.reserve(n);
+        kinds.reserve(n);
+    }
+
+    size_t Size() const noexcept { return kinds.size(); }
+    int32_t Width(size_t i) const noexcept { return widths[i]; }
+    int32_t Height(size_t i) const noexcept { return heights[i]; }
+    ShapeKind Kind(size_t i) const noexcept { return kinds[i]; }
+    uint64_t Area(size_t i) const noexcept { return uint64_t(uint32_t(widths[i])) * uint32_t(heights[i]); }
+
+    // Same meaning as Rectangle::SetWidth / Square::SetWidth
+    void SetWidth(size_t i, int32_t width) { SetWidth(i, i + 1, width); }
+    void SetHeight(size_t i, int32_t height) { SetHeight(i, i + 1, height); }
+
+    // Bulk resizes of [first, last)
+    void SetWidth(size_t first, size_t last, int32_t width)
+    {
+        CheckDimension(width);
+        Assign(widths.data(), heights.data(), kinds.data(), first, last, width);
+    }
+
+    void SetHeight(size_t first, size_t last, int32_t height)
+    {
+        CheckDimension(height);
+        Assign(heights.data(), widths.data(), kinds.data(), first, last, height);
+    }
+
+    // Writes the area of every shape in [first, last) to out[0 .. last - first).
+    void Areas(size_t first, size_t last, uint64_t* out) const
+    {
+        const int32_t* w = widths.data();
+        const int32_t* h = heights.data();
+        size_t i = first;
+#if defined(__AVX2__)
+        for (; i + 8 <= last; i += 8)
+        {
+            __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            __m256i hv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i));
+            __m256i even = _mm256_mul_epu32(wv, hv);                                              // shapes 0 2 | 4 6
+            __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(wv, 32), _mm256_srli_epi64(hv, 32));  // shapes 1 3 | 5 7
+            __m256i a = _mm256_unpacklo_epi64(even, odd);                                         // 0 1 | 4 5
+            __m256i b = _mm256_unpackhi_epi64(even, odd);                                         // 2 3 | 6 7
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (i - first)), _mm256_permute2x128_si256(a, b, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + (i - first) + 4), _mm256_permute2x128_si256(a, b, 0x31));
+        }
+#endif
+        for (; i < last; ++i) out[i - first] = uint64_t(uint32_t(w[i])) * uint32_t(h[i]);
+    }
+
+    ShapeAggregates Aggregate() const
+    {
+        ShapeAggregates result;
+        const int32_t* w = widths.data();
+        const int32_t* h = heights.data();
+        const size_t n = Size();
+        size_t i = 0;
+        uint64_t sum_low = 0, sum_high = 0;
+
+#if defined(__AVX2__)
+        // Lane sums of 32-bit halves: each lane adds at most n / 4 values below 2^32, so n < 2^34 is safe.
+        const __m256i low_mask = _mm256_set1_epi64x(0xFFFFFFFF);
+        __m256i low = _mm256_setzero_si256(), high = _mm256_setzero_si256(), best = _mm256_setzero_si256();
+        __m256i square_count = _mm256_setzero_si256();
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i wv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            __m256i hv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h + i));
+            __m256i even = _mm256_mul_epu32(wv, hv);
+            __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(wv, 32), _mm256_srli_epi64(hv, 32));
+            low = _mm256_add_epi64(low, _mm256_add_epi64(_mm256_and_si256(even, low_mask), _mm256_and_si256(odd, low_mask)));
+            high = _mm256_add_epi64(high, _mm256_add_epi64(_mm256_srli_epi64(even, 32), _mm256_srli_epi64(odd, 32)));
+            // Areas are below 2^62, so a signed compare orders them correctly.
+            best = _mm256_blendv_epi8(best, even, _mm256_cmpgt_epi64(even, best));
+            best = _mm256_blendv_epi8(best, odd, _mm256_cmpgt_epi64(odd, best));
+            __m128i k8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(kinds.data() + i));
+            square_count = _mm256_add_epi32(square_count, _mm256_cvtepu8_epi32(k8));
+        }
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), low);
+        for (uint64_t v : lanes) result.total_area.AddSplit(v, 0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), high);
+        for (uint64_t v : lanes) result.total_area.AddSplit(0, v);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), best);
+        for (uint64_t v : lanes) result.max_area = max(result.max_area, v);
+        alignas(32) uint32_t counts[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(counts), square_count);
+        for (uint32_t c : counts) result.squares += c;
+#endif
+        for (; i < n; ++i)
+        {
+            uint64_t area = uint64_t(uint32_t(w[i])) * uint32_t(h[i]);
+            sum_low += area & 0xFFFFFFFF;
+            sum_high += area >> 32;
+            result.max_area = max(result.max_area, area);
+            result.squares += kinds[i] == ShapeKind::square;
+        }
+        result.total_area.AddSplit(sum_low, sum_high);
+        return result;
+    }
+
+    // Process() over every shape: sets all heights to 10 and returns how many shapes
+    // no longer have the area a Rectangle-only caller expects (the squares whose width was not 10).
+    size_t ProcessAll()
+    {
+        size_t surprised = 0;
+        for (size_t i = 0; i < Size(); ++i) surprised += (kinds[i] == ShapeKind::square) & (widths[i] != 10);   // branch-free, so it vectorizes
+        SetHeight(0, Size(), 10);
+        return surprised;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+using Clock = chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point begin)
+{
+    return chrono::duration<double, milli>(Clock::now() - begin).count();
+}
+
+int main(int argc, char* argv[])
+{
+    // The Process() example, once per object and once through the batch
+    {
+        Rectangle r{ 10, 20 };
+        Square sq{ 5 };
+        ShapeBatch batch;
+        batch.AddRectangle(10, 20);
+        batch.AddSquare(5);
+        cout << "Rectangle: " << (Process(r) ? "expected area" : "unexpected area") << ", Square: " << (Process(sq) ? "expected area" : "unexpected area") << endl;
+        cout << "Batch: " << batch.ProcessAll() << " of " << batch.Size() << " shapes with an unexpected area; square is now "
+             << batch.Width(1) << " x " << batch.Height(1) << endl;
+
+        ShapeBatch big;
+        big.AddRectangle(100'000, 100'000);
+        cout << "100000 x 100000: int area() cannot represent " << big.Area(0) << endl << endl;
+    }
+
+    const size_t n = argc > 1 ? stoul(argv[1]) : 10'000'000;
+    mt19937 rng(3);
+    uniform_int_distribution<int32_t> dimension(1, INT32_MAX);
+    bernoulli_distribution is_square(0.3);
+
+    vector<unique_ptr<Rectangle>> objects;
+    ShapeBatch batch;
+    objects.reserve(n);
+    batch.Reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        int32_t w = dimension(rng);
+        if (is_square(rng))
+        {
+            objects.push_back(make_unique<Square>(w));
+            batch.AddSquare(w);
+        }
+        else
+        {
+            int32_t h = dimension(rng);
+            objects.push_back(make_unique<Rectangle>(w, h));
+            batch.AddRectangle(w, h);
+        }
+    }
+    // Shuffle the objects in memory the way a long-running program's heap would be
+    shuffle(objects.begin(), objects.end(), rng);
+    ShapeBatch shuffled;
+    shuffled.Reserve(n);
+    for (auto& o : objects)
+    {
+        if (dynamic_cast<Square*>(o.get())) shuffled.AddSquare(o->GetWidth());
+        else shuffled.AddRectangle(o->GetWidth(), o->GetHeight());
+    }
+    batch = move(shuffled);
+
+    cout << n << " shapes, dimensions up to 2^31 - 1"
+#if defined(__AVX2__)
+         << ", AVX2 kernels:" << endl;
+#else
+         << ", scalar kernels:" << endl;
+#endif
+
+    // Areas
+    vector<uint64_t> object_areas(n), batch_areas(n);
+    auto t = Clock::now();
+    for (size_t i = 0; i < n; ++i) object_areas[i] = uint64_t(uint32_t(objects[i]->GetWidth())) * uint32_t(objects[i]->GetHeight());
+    double object_area_ms = MillisecondsSince(t);
+    t = Clock::now();
+    batch.Areas(0, n, batch_areas.data());
+    double batch_area_ms = MillisecondsSince(t);
+    cout << "  areas:      per object " << object_area_ms << " ms, batch " << batch_area_ms << " ms"
+         << (object_areas == batch_areas ? "" : " (MISMATCH)") << endl;
+
+    // Aggregates
+    AreaTotal object_total;
+    uint64_t wrapped = 0, object_max = 0;
+    t = Clock::now();
+    for (auto& o : objects)
+    {
+        uint64_t area = uint64_t(uint32_t(o->GetWidth())) * uint32_t(o->GetHeight());
+        object_total.Add(area);
+        object_max = max(object_max, area);
+        wrapped += area;
+    }
+    double object_total_ms = MillisecondsSince(t);
+    t = Clock::now();
+    ShapeAggregates aggregates = batch.Aggregate();
+    double batch_total_ms = MillisecondsSince(t);
+    cout << "  total area: per object " << object_total_ms << " ms, batch " << batch_total_ms << " ms"
+         << (aggregates.total_area == object_total && aggregates.max_area == object_max ? "" : " (MISMATCH)") << endl;
+    cout << "              = " << aggregates.total_area.ToString() << " (a 64-bit sum wraps to " << wrapped << "), "
+         << aggregates.squares << " squares, largest area " << aggregates.max_area << endl;
+
+    // Process(): every shape gets height 10 through the virtual SetHeight, or through one bulk resize
+    size_t object_surprised = 0;
+    t = Clock::now();
+    for (auto& o : objects) object_surprised += !Process(*o);
+    double object_process_ms = MillisecondsSince(t);
+    t = Clock::now();
+    size_t batch_surprised = batch.ProcessAll();
+    double batch_process_ms = MillisecondsSince(t);
+
+    bool same = object_surprised == batch_surprised;
+    for (size_t i = 0; i < n && same; ++i)
+    {
+        same = objects[i]->GetWidth() == batch.Width(i) && objects[i]->GetHeight() == batch.Height(i);
+    }
+    cout << "  Process():  per object (virtual SetHeight) " << object_process_ms << " ms, batch " << batch_process_ms << " ms; "
+         << batch_surprised << " squares changed width" << (same ? ", same shapes afterwards" : ", MISMATCH") << endl;
+
+    return 0;
+}
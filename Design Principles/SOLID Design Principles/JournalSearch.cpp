@@ -0,0 +1,1178 @@
+// Journal Search
+
+// Builds on the Single Responsibility example (SingleResponsibility.cpp).
+// Journal is a vector<string>, so the only way to find the entries that mention a word is to read every entry.
+// With millions of entries that is a full scan per query.
+
+// Explanation of File:
+// JournalIndex is an inverted index kept next to the journal, again as its own class: Journal keeps entries,
+// JournalIndex finds them, PersistenceManager stores both.
+//  - Entries are numbered in the order they are added. Each added entry is tokenized into a small in-memory buffer.
+//  - The buffer is sealed into an immutable Segment once it holds enough entries. Queries see the entries still in the
+//    buffer through a temporary segment built from it, which is kept and reused until more entries are added, so a
+//    query-heavy workload neither rebuilds it per query nor fills the index with tiny segments.
+//    A segment has a sorted term dictionary and, per term, a postings list of (entry, positions) pairs.
+//    Postings are compressed: entry numbers and positions are delta-coded and written as variable-byte integers.
+//  - Every 128 entries of a postings list start a block, and the segment keeps the last entry number and byte offset
+//    of every block. These are the skip pointers: an AND query jumps over whole blocks instead of decoding them.
+//  - Small segments are merged into larger ones by a background thread, so the number of segments a query visits
+//    stays logarithmic in the number of entries. Readers take a snapshot of the segment list and never wait on a merge.
+// Queries: And (every term), Or (any term) and Phrase (the terms next to each other, in order).
+// PersistenceManager writes the index segments next to the entries, so loading a journal does not re-index it.
+// Each segment file carries a CRC-32 of its contents and is checked before it is used.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include<fstream>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <queue>
+#include <functional>
+#include <array>
+
+using namespace std;
+
+// Lower-cases ASCII letters and digits into words; everything else separates words.
+template <typename F>
+void ForEachWord(string_view text, F&& f)
+{
+    string word;
+    uint32_t position = 0;
+    for (size_t i = 0; i <= text.size(); ++i)
+    {
+        char c = i < text.size() ? text[i] : ' ';
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) word += c;
+        else if (c >= 'A' && c <= 'Z') word += static_cast<char>(c - 'A' + 'a');
+        else if (!word.empty())
+        {
+            f(string_view(word), position++);
+            word.clear();
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Variable-byte integers: 7 bits per byte, high bit set on every byte but the last.
+
+inline void PutVarint(vector<uint8_t>& out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline uint32_t GetVarint(const uint8_t*& p)
+{
+    uint32_t value = *p & 0x7F;
+    for (int shift = 7; *p++ & 0x80; shift += 7) value |= uint32_t{ *p & 0x7Fu } << shift;
+    return value;
+}
+
+inline void SkipVarints(const uint8_t*& p, uint32_t count)
+{
+    while (count != 0) count -= (*p++ & 0x80) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// CRC-32 (IEEE), eight bytes per step (slicing-by-8); checksums every segment and its entries on each save and load.
+
+class Crc32
+{
+private:
+    uint32_t crc = 0xFFFFFFFFu;
+
+    // table[0] is the classic byte table; table[k][i] is the CRC of byte i followed by k zero bytes.
+    static const array<array<uint32_t, 256>, 8>& Table()
+    {
+        static const auto table = [] {
+            array<array<uint32_t, 256>, 8> t{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int k = 1; k < 8; ++k) t[k][i] = t[0][t[k - 1][i] & 0xFF] ^ (t[k - 1][i] >> 8);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+public:
+    void Update(const void* data, size_t size)
+    {
+        auto& t = Table();
+        auto p = static_cast<const uint8_t*>(data);
+        for (; size >= 8; p += 8, size -= 8)
+        {
+            uint32_t low = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | uint32_t{ p[3] } << 24);
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24]
+                ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        }
+        for (; size != 0; ++p, --size) crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+
+    uint32_t Value() const noexcept { return ~crc; }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Immutable index segment
+
+struct TermInfo
+{
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint64_t postings_offset;
+    uint32_t doc_count;
+    uint32_t skip_offset;     // first of this term's ceil(doc_count / block_size) skip entries
+};
+
+// Last entry number of a block and where the block starts, relative to the term's postings.
+struct Skip
+{
+    uint32_t last_doc;
+    uint32_t offset;
+};
+
+class Segment
+{
+public:
+    static constexpr uint32_t block_size = 128;
+
+    uint32_t first_doc = 0;   // entries [first_doc, end_doc) are indexed here
+    uint32_t end_doc = 0;
+    string term_chars;
+    vector<TermInfo> terms;   // sorted by name
+    vector<uint8_t> postings;
+    vector<Skip> skips;
+
+    string_view TermName(const TermInfo& t) const { return string_view(term_chars).substr(t.name_offset, t.name_length); }
+
+    const TermInfo* Find(string_view term) const
+    {
+        auto it = lower_bound(terms.begin(), terms.end(), term, [&](const TermInfo& t, string_view k) { return TermName(t) < k; });
+        return it != terms.end() && TermName(*it) == term ? &*it : nullptr;
+    }
+
+    // Checks that every offset in the dictionary and skip lists stays inside the segment, for segments read from disk.
+    bool Consistent() const
+    {
+        if (first_doc > end_doc) return false;
+        for (size_t i = 0; i < terms.size(); ++i)
+        {
+            const TermInfo& t = terms[i];
+            uint64_t blocks = (uint64_t{ t.doc_count } + block_size - 1) / block_size;
+            if (t.doc_count == 0 || uint64_t{ t.name_offset } + t.name_length > term_chars.size()
+                || t.postings_offset >= postings.size() || t.skip_offset + blocks > skips.size()) return false;
+            for (uint64_t b = 0; b < blocks; ++b)
+            {
+                const Skip& skip = skips[t.skip_offset + b];
+                if (t.postings_offset + skip.offset >= postings.size() || skip.last_doc < first_doc || skip.last_doc >= end_doc) return false;
+            }
+            if (i > 0 && !(TermName(terms[i - 1]) < TermName(t))) return false;
+        }
+        return true;
+    }
+
+    size_t BytesUsed() const
+    {
+        return term_chars.capacity() + terms.capacity() * sizeof(TermInfo) + postings.capacity() + skips.capacity() * sizeof(Skip);
+    }
+};
+
+// Builds a segment term by term; terms must come in sorted order, and a term's entries in increasing order.
+class SegmentWriter
+{
+private:
+    Segment segment;
+    TermInfo* term = nullptr;
+    uint32_t previous_doc = 0;
+
+public:
+    SegmentWriter(uint32_t first_doc, uint32_t end_doc)
+    {
+        segment.first_doc = first_doc;
+        segment.end_doc = end_doc;
+    }
+
+    void BeginTerm(string_view name)
+    {
+        segment.terms.push_back({ static_cast<uint32_t>(segment.term_chars.size()), static_cast<uint32_t>(name.size()),
+                                  segment.postings.size(), 0, static_cast<uint32_t>(segment.skips.size()) });
+        segment.term_chars += name;
+        term = &segment.terms.back();
+        previous_doc = 0;
+    }
+
+    // `positions` are the word positions of the term in entry `doc`, in increasing order.
+    void Add(uint32_t doc, const uint32_t* positions, uint32_t count)
+    {
+        if (term->doc_count % Segment::block_size == 0)
+        {
+            segment.skips.push_back({ doc, static_cast<uint32_t>(segment.postings.size() - term->postings_offset) });
+        }
+        PutVarint(segment.postings, doc - previous_doc);
+        PutVarint(segment.postings, count);
+        uint32_t previous_position = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            PutVarint(segment.postings, positions[i] - previous_position);
+            previous_position = positions[i];
+        }
+        segment.skips.back().last_doc = doc;
+        previous_doc = doc;
+        ++term->doc_count;
+    }
+
+    Segment Finish()
+    {
+        segment.postings.shrink_to_fit();
+        segment.skips.shrink_to_fit();
+        segment.terms.shrink_to_fit();
+        return move(segment);
+    }
+};
+
+// Walks one term's postings in one segment.
+class PostingCursor
+{
+private:
+    static constexpr uint32_t end = UINT32_MAX;
+
+    const uint8_t* base = nullptr;
+    const Skip* skips = nullptr;
+    uint32_t block_count = 0;
+    uint32_t doc_count = 0;
+
+    uint32_t block = 0;
+    uint32_t left_in_block = 0;
+    const uint8_t* p = nullptr;
+    uint32_t doc = end;
+    uint32_t freq = 0;
+    bool positions_read = true;
+
+    void LoadBlock(uint32_t b)
+    {
+        block = b;
+        p = base + skips[b].offset;
+        doc = b == 0 ? 0 : skips[b - 1].last_doc;
+        left_in_block = min(Segment::block_size, doc_count - b * Segment::block_size);
+        positions_read = true;
+    }
+
+public:
+    static constexpr uint32_t npos = end;
+
+    PostingCursor() = default;
+
+    PostingCursor(const Segment& segment, const TermInfo& info)
+        : base(segment.postings.data() + info.postings_offset), skips(segment.skips.data() + info.skip_offset),
+          block_count((info.doc_count + Segment::block_size - 1) / Segment::block_size), doc_count(info.doc_count)
+    {
+        LoadBlock(0);
+        Next();
+    }
+
+    uint32_t Doc() const noexcept { return doc; }
+    uint32_t DocCount() const noexcept { return doc_count; }
+
+    void Next()
+    {
+        if (!positions_read) SkipVarints(p, freq);
+        if (left_in_block == 0)
+        {
+            if (block + 1 >= block_count)
+            {
+                doc = end;
+                return;
+            }
+            LoadBlock(block + 1);
+        }
+        doc += GetVarint(p);
+        freq = GetVarint(p);
+        positions_read = false;
+        --left_in_block;
+    }
+
+    // Moves to the first entry >= target, skipping whole blocks whose last entry is smaller.
+    void SkipTo(uint32_t target)
+    {
+        if (doc >= target) return;
+        if (skips[block].last_doc < target)
+        {
+            const Skip* next = lower_bound(skips + block + 1, skips + block_count, target,
+                                           [](const Skip& s, uint32_t t) { return s.last_doc < t; });
+            if (next == skips + block_count)
+            {
+                doc = end;
+                return;
+            }
+            LoadBlock(static_cast<uint32_t>(next - skips));
+        }
+        do Next(); while (doc < target);
+    }
+
+    // Decodes the current entry's positions; call at most once per entry.
+    void Positions(vector<uint32_t>& out)
+    {
+        out.clear();
+        uint32_t position = 0;
+        for (uint32_t i = 0; i < freq; ++i) out.push_back(position += GetVarint(p));
+        positions_read = true;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The index
+
+class JournalIndex
+{
+private:
+    // One word of an entry added since the last seal. The buffer is a flat array of these,
+    // grouped by term only when it is sealed, so adding a word is one lookup and one append.
+    struct Occurrence
+    {
+        uint32_t term;
+        uint32_t doc;
+        uint32_t position;
+    };
+
+    // Lets the term ids be probed with a string_view, so a word already seen costs no allocation.
+    struct WordHash
+    {
+        using is_transparent = void;
+        size_t operator()(string_view w) const noexcept { return hash<string_view>{}(w); }
+    };
+
+    using SegmentList = vector<shared_ptr<const Segment>>;
+
+    const uint32_t seal_after;
+    const size_t merge_factor;
+
+    mutable mutex m;
+    condition_variable merge_wanted;
+    unordered_map<string, uint32_t, WordHash, equal_to<>> term_ids;   // every word seen so far
+    vector<string_view> term_names;                                    // keys of term_ids, by id
+    vector<Occurrence> buffer;
+    uint32_t buffer_first = 0;
+    uint32_t next_doc = 0;
+    shared_ptr<const SegmentList> segments = make_shared<SegmentList>();
+    shared_ptr<const Segment> tail;   // the buffer as a segment, for queries; not in `segments`
+    bool stopping = false;
+    atomic<uint64_t> merges{ 0 };
+    thread merger;
+
+    // Segments are tiered by size: tier k holds up to seal_after * merge_factor^k entries.
+    size_t Tier(const Segment& s) const
+    {
+        size_t tier = 0;
+        for (uint64_t limit = seal_after; s.end_doc - s.first_doc > limit; limit *= merge_factor) ++tier;
+        return tier;
+    }
+
+    // Index of the first run of merge_factor adjacent segments of the same tier, or SIZE_MAX.
+    size_t FindMergeRun(const SegmentList& list) const
+    {
+        for (size_t i = 0; i + merge_factor <= list.size(); ++i)
+        {
+            size_t tier = Tier(*list[i]);
+            size_t j = i + 1;
+            while (j < i + merge_factor && Tier(*list[j]) == tier) ++j;
+            if (j == i + merge_factor) return i;
+        }
+        return SIZE_MAX;
+    }
+
+    // Builds a segment of the entries in the buffer. Requires the lock.
+    Segment BuildBufferLocked() const
+    {
+        // Counting sort of the occurrences by term, in term name order; it is stable, so entries and positions stay sorted.
+        vector<uint32_t> start(term_names.size() + 1, 0);
+        for (auto& o : buffer) ++start[o.term + 1];
+        vector<uint32_t> used;
+        for (uint32_t t = 0; t < term_names.size(); ++t)
+        {
+            if (start[t + 1] != 0) used.push_back(t);
+        }
+        sort(used.begin(), used.end(), [&](uint32_t a, uint32_t b) { return term_names[a] < term_names[b]; });
+
+        vector<uint32_t> next(term_names.size(), 0);
+        uint32_t total = 0;
+        for (uint32_t t : used)
+        {
+            next[t] = total;
+            total += start[t + 1];
+        }
+        vector<Occurrence> grouped(buffer.size());
+        for (auto& o : buffer) grouped[next[o.term]++] = o;
+
+        SegmentWriter writer(buffer_first, next_doc);
+        vector<uint32_t> positions;
+        for (size_t i = 0; i < grouped.size();)
+        {
+            writer.BeginTerm(term_names[grouped[i].term]);
+            const uint32_t term = grouped[i].term;
+            while (i < grouped.size() && grouped[i].term == term)
+            {
+                const uint32_t doc = grouped[i].doc;
+                positions.clear();
+                for (; i < grouped.size() && grouped[i].term == term && grouped[i].doc == doc; ++i) positions.push_back(grouped[i].position);
+                writer.Add(doc, positions.data(), static_cast<uint32_t>(positions.size()));
+            }
+        }
+        return writer.Finish();
+    }
+
+    // Requires the lock.
+    void SealLocked()
+    {
+        if (next_doc == buffer_first) return;
+
+        auto list = make_shared<SegmentList>(*segments);
+        list->push_back(tail && tail->end_doc == next_doc ? tail : make_shared<const Segment>(BuildBufferLocked()));
+        segments = move(list);
+        buffer.clear();
+        buffer_first = next_doc;
+        tail.reset();
+        merge_wanted.notify_one();
+    }
+
+    static Segment Merge(const SegmentList& run)
+    {
+        SegmentWriter writer(run.front()->first_doc, run.back()->end_doc);
+
+        // k-way merge of the sorted term dictionaries
+        using Head = pair<string_view, size_t>;   // next term of segment i
+        priority_queue<Head, vector<Head>, greater<Head>> heads;
+        vector<size_t> at(run.size(), 0);
+        for (size_t i = 0; i < run.size(); ++i)
+        {
+            if (!run[i]->terms.empty()) heads.push({ run[i]->TermName(run[i]->terms[0]), i });
+        }
+
+        vector<uint32_t> positions;
+        while (!heads.empty())
+        {
+            string_view term = heads.top().first;
+            writer.BeginTerm(term);
+            // Segments cover increasing entry ranges, so visiting them in order keeps the entries sorted.
+            vector<size_t> with_term;
+            while (!heads.empty() && heads.top().first == term)
+            {
+                with_term.push_back(heads.top().second);
+                heads.pop();
+            }
+            sort(with_term.begin(), with_term.end());
+            for (size_t i : with_term)
+            {
+                const Segment& s = *run[i];
+                for (PostingCursor c(s, s.terms[at[i]]); c.Doc() != PostingCursor::npos; c.Next())
+                {
+                    uint32_t doc = c.Doc();
+                    c.Positions(positions);
+                    writer.Add(doc, positions.data(), static_cast<uint32_t>(positions.size()));
+                }
+                if (++at[i] < s.terms.size()) heads.push({ s.TermName(s.terms[at[i]]), i });
+            }
+        }
+        return writer.Finish();
+    }
+
+    void MergeLoop()
+    {
+        unique_lock<mutex> lock(m);
+        for (;;)
+        {
+            merge_wanted.wait(lock, [this] { return stopping || FindMergeRun(*segments) != SIZE_MAX; });
+            if (stopping) return;
+
+            auto current = segments;
+            size_t first = FindMergeRun(*current);
+            SegmentList run(current->begin() + first, current->begin() + first + merge_factor);
+            lock.unlock();
+            auto merged = make_shared<const Segment>(Merge(run));
+            lock.lock();
+
+            // Only this thread removes segments, and seals only append, so the run is still at the same place.
+            auto list = make_shared<SegmentList>(segments->begin(), segments->begin() + first);
+            list->push_back(move(merged));
+            list->insert(list->end(), segments->begin() + first + merge_factor, segments->end());
+            segments = move(list);
+            merges.fetch_add(1, memory_order_relaxed);
+        }
+    }
+
+    // The segments a query should see: the sealed ones, plus the buffer as a temporary segment if it is not empty.
+    shared_ptr<const SegmentList> Snapshot()
+    {
+        lock_guard<mutex> lock(m);
+        if (next_doc == buffer_first) return segments;
+        if (!tail || tail->end_doc != next_doc) tail = make_shared<const Segment>(BuildBufferLocked());
+        auto list = make_shared<SegmentList>(*segments);
+        list->push_back(tail);
+        return list;
+    }
+
+public:
+    explicit JournalIndex(uint32_t seal_after = 16384, size_t merge_factor = 4)
+        : seal_after(seal_after), merge_factor(merge_factor), merger([this] { MergeLoop(); })
+    {
+    }
+
+    JournalIndex(const JournalIndex&) = delete;
+    JournalIndex& operator=(const JournalIndex&) = delete;
+
+    ~JournalIndex()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        merge_wanted.notify_one();
+        merger.join();
+    }
+
+    // Indexes the next entry; returns its number.
+    uint32_t Add(string_view entry)
+    {
+        lock_guard<mutex> lock(m);
+        uint32_t doc = next_doc++;
+        ForEachWord(entry, [&](string_view word, uint32_t position) {
+            auto it = term_ids.find(word);
+            if (it == term_ids.end())
+            {
+                it = term_ids.emplace(string(word), static_cast<uint32_t>(term_names.size())).first;
+                term_names.push_back(it->first);
+            }
+            buffer.push_back({ it->second, doc, position });
+        });
+        if (next_doc - buffer_first >= seal_after) SealLocked();
+        return doc;
+    }
+
+    // Entries containing every term.
+    vector<uint32_t> And(const vector<string>& terms) { return Match(terms, false); }
+
+    // Entries containing the words of `phrase` next to each other, in order.
+    vector<uint32_t> Phrase(string_view phrase)
+    {
+        vector<string> terms;
+        ForEachWord(phrase, [&](string_view word, uint32_t) { terms.emplace_back(word); });
+        return Match(terms, true);
+    }
+
+    // Entries containing any of the terms.
+    vector<uint32_t> Or(const vector<string>& terms)
+    {
+        vector<uint32_t> result;
+        auto list = Snapshot();
+        for (auto& segment : *list)
+        {
+            auto later = [](const PostingCursor* a, const PostingCursor* b) { return a->Doc() > b->Doc(); };
+            vector<PostingCursor> cursors;
+            cursors.reserve(terms.size());
+            for (auto& term : terms)
+            {
+                if (const TermInfo* info = segment->Find(term)) cursors.emplace_back(*segment, *info);
+            }
+            priority_queue<PostingCursor*, vector<PostingCursor*>, decltype(later)> heap(later);
+            for (auto& c : cursors) heap.push(&c);
+            while (!heap.empty())
+            {
+                PostingCursor* c = heap.top();
+                heap.pop();
+                if (result.empty() || result.back() != c->Doc()) result.push_back(c->Doc());
+                c->Next();
+                if (c->Doc() != PostingCursor::npos) heap.push(c);
+            }
+        }
+        return result;
+    }
+
+    uint32_t EntryCount() const
+    {
+        lock_guard<mutex> lock(m);
+        return next_doc;
+    }
+
+    size_t SegmentCount() const
+    {
+        lock_guard<mutex> lock(m);
+        return segments->size();
+    }
+
+    uint64_t MergeCount() const noexcept { return merges.load(); }
+
+    size_t BytesUsed() const
+    {
+        lock_guard<mutex> lock(m);
+        size_t bytes = 0;
+        for (auto& s : *segments) bytes += s->BytesUsed();
+        return bytes;
+    }
+
+    // Waits until the background merger has nothing left to do; for benchmarks and before saving.
+    void WaitForMerges()
+    {
+        for (;;)
+        {
+            {
+                lock_guard<mutex> lock(m);
+                if (FindMergeRun(*segments) == SIZE_MAX) return;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    // Seals the buffer and returns the sealed segments, oldest first, for persistence.
+    shared_ptr<const vector<shared_ptr<const Segment>>> Segments()
+    {
+        lock_guard<mutex> lock(m);
+        SealLocked();
+        return segments;
+    }
+
+    // Takes over a segment loaded from disk. Segments must be adopted in order, before any entry is added.
+    void Adopt(Segment segment)
+    {
+        lock_guard<mutex> lock(m);
+        if (segment.first_doc != next_doc || next_doc != buffer_first) throw logic_error("JournalIndex: segments adopted out of order");
+        next_doc = buffer_first = segment.end_doc;
+        auto list = make_shared<SegmentList>(*segments);
+        list->push_back(make_shared<const Segment>(move(segment)));
+        segments = move(list);
+        merge_wanted.notify_one();
+    }
+
+private:
+    // AND of all terms with skip-pointer intersection; with `phrase`, also checks that the positions line up.
+    vector<uint32_t> Match(const vector<string>& terms, bool phrase)
+    {
+        vector<uint32_t> result;
+        if (terms.empty()) return result;
+        auto list = Snapshot();
+        vector<vector<uint32_t>> positions(terms.size());
+        vector<uint32_t> starts;
+
+        for (auto& segment : *list)
+        {
+            vector<PostingCursor> cursors;
+            vector<size_t> offset;   // word offset of each cursor's term within the phrase
+            bool missing = false;
+            for (size_t i = 0; i < terms.size() && !missing; ++i)
+            {
+                const TermInfo* info = segment->Find(terms[i]);
+                if (info) cursors.emplace_back(*segment, *info);
+                offset.push_back(i);
+                missing = info == nullptr;
+            }
+            if (missing) continue;
+
+            // The rarest term leads; the others skip to its entries.
+            vector<size_t> order(cursors.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cursors[a].DocCount() < cursors[b].DocCount(); });
+
+            PostingCursor& lead = cursors[order[0]];
+            while (lead.Doc() != PostingCursor::npos)
+            {
+                uint32_t candidate = lead.Doc();
+                bool all = true;
+                for (size_t k = 1; k < order.size(); ++k)
+                {
+                    PostingCursor& c = cursors[order[k]];
+                    c.SkipTo(candidate);
+                    if (c.Doc() != candidate)
+                    {
+                        all = false;
+                        candidate = c.Doc();
+                        break;
+                    }
+                }
+                if (all)
+                {
+                    bool match = true;
+                    if (phrase)
+                    {
+                        // Shift each term's positions back by its offset in the phrase; a common value is a match.
+                        // Positions before the offset cannot start the phrase, and shifting them would wrap around
+                        // and break the sort order set_intersection relies on, so they are dropped first.
+                        for (size_t i = 0; i < cursors.size(); ++i)
+                        {
+                            auto& ps = positions[i];
+                            cursors[i].Positions(ps);
+                            ps.erase(ps.begin(), lower_bound(ps.begin(), ps.end(), static_cast<uint32_t>(offset[i])));
+                            for (auto& p : ps) p -= static_cast<uint32_t>(offset[i]);
+                        }
+                        starts = positions[0];
+                        for (size_t i = 1; i < cursors.size() && !starts.empty(); ++i)
+                        {
+                            vector<uint32_t> common;
+                            set_intersection(starts.begin(), starts.end(), positions[i].begin(), positions[i].end(), back_inserter(common));
+                            starts.swap(common);
+                        }
+                        match = !starts.empty();
+                    }
+                    if (match) result.push_back(candidate);
+                    lead.Next();
+                }
+                else if (candidate == PostingCursor::npos)
+                {
+                    break;
+                }
+                else
+                {
+                    lead.SkipTo(candidate);
+                }
+            }
+        }
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Journal
+{
+    string title;
+    vector<string> entries;
+    JournalIndex* index = nullptr;
+
+    Journal(const string& title, JournalIndex* index = nullptr) : title(title), index(index) {}
+
+    void AddEntry(const string& entry)
+    {
+        entries.push_back(entry);
+        if (index) index->Add(entry);
+    }
+
+    vector<string> Search(const vector<uint32_t>& hits) const
+    {
+        vector<string> found;
+        for (uint32_t doc : hits) found.push_back(entries[doc]);
+        return found;
+    }
+};
+
+// Stores a journal as directory/entries.log plus one file per index segment in directory/index.
+// Segments are immutable, so a save only writes the segments that are not on disk yet and removes merged-away ones.
+// Each segment file records a checksum of the entries it indexes, so it is never used with a different journal's entries.
+struct PersistenceManager
+{
+    struct SegmentFileHeader
+    {
+        static constexpr char expected_magic[4] = { 'J', 'I', 'D', 'X' };
+        static constexpr uint32_t current_version = 3;
+
+        char magic[4];
+        uint32_t version;
+        uint32_t first_doc;
+        uint32_t end_doc;
+        uint64_t term_count;
+        uint64_t chars_size;
+        uint64_t postings_size;
+        uint64_t skip_count;
+        uint32_t checksum;           // CRC-32 of everything after the header
+        uint32_t entries_checksum;   // EntriesChecksum of the entries [first_doc, end_doc)
+
+        uint64_t BodySize() const
+        {
+            return term_count * sizeof(TermInfo) + chars_size + postings_size + skip_count * sizeof(Skip);
+        }
+    };
+
+    static uint32_t BodyChecksum(const Segment& s)
+    {
+        Crc32 crc;
+        crc.Update(s.terms.data(), s.terms.size() * sizeof(TermInfo));
+        crc.Update(s.term_chars.data(), s.term_chars.size());
+        crc.Update(s.postings.data(), s.postings.size());
+        crc.Update(s.skips.data(), s.skips.size() * sizeof(Skip));
+        return crc.Value();
+    }
+
+    static uint32_t EntriesChecksum(const vector<string>& entries, uint32_t first, uint32_t end)
+    {
+        Crc32 crc;
+        for (uint32_t doc = first; doc < end; ++doc)
+        {
+            uint32_t length = static_cast<uint32_t>(entries[doc].size());
+            crc.Update(&length, sizeof length);
+            crc.Update(entries[doc].data(), length);
+        }
+        return crc.Value();
+    }
+
+    static SegmentFileHeader HeaderFor(const Segment& s, const vector<string>& entries)
+    {
+        SegmentFileHeader header{};
+        memcpy(header.magic, SegmentFileHeader::expected_magic, sizeof header.magic);
+        header.version = SegmentFileHeader::current_version;
+        header.first_doc = s.first_doc;
+        header.end_doc = s.end_doc;
+        header.term_count = s.terms.size();
+        header.chars_size = s.term_chars.size();
+        header.postings_size = s.postings.size();
+        header.skip_count = s.skips.size();
+        header.checksum = BodyChecksum(s);
+        header.entries_checksum = EntriesChecksum(entries, s.first_doc, s.end_doc);
+        return header;
+    }
+
+    // True if `path` already holds exactly the segment described by `expected`.
+    static bool SegmentFileMatches(const filesystem::path& path, const SegmentFileHeader& expected)
+    {
+        error_code ec;
+        const uint64_t file_size = filesystem::file_size(path, ec);
+        if (ec || file_size != sizeof expected + expected.BodySize()) return false;
+        ifstream in(path, ios::binary);
+        SegmentFileHeader header{};
+        in.read(reinterpret_cast<char*>(&header), sizeof header);
+        return in && memcmp(&header, &expected, sizeof header) == 0;
+    }
+
+    static string SegmentFileName(const Segment& s)
+    {
+        return "segment-" + to_string(s.first_doc) + "-" + to_string(s.end_doc) + ".idx";
+    }
+
+    static void Save(const Journal& j, JournalIndex& index, const filesystem::path& directory)
+    {
+        filesystem::create_directories(directory / "index");
+
+        // Entries: [uint32 length][bytes], written through one buffered stream with no per-entry flush,
+        // under a temporary name and renamed, so a crash leaves the previously saved entries intact.
+        {
+            auto temporary = directory / "entries.log.tmp";
+            {
+                ofstream out(temporary, ios::binary | ios::trunc);
+                for (auto& e : j.entries)
+                {
+                    uint32_t length = static_cast<uint32_t>(e.size());
+                    out.write(reinterpret_cast<const char*>(&length), sizeof length);
+                    out.write(e.data(), length);
+                }
+                if (!out) throw runtime_error("PersistenceManager: cannot write entries");
+            }
+            filesystem::rename(temporary, directory / "entries.log");
+        }
+
+        auto segments = index.Segments();
+        vector<string> keep;
+        for (auto& s : *segments)
+        {
+            string name = SegmentFileName(*s);
+            keep.push_back(name);
+            // A file of the same name may belong to another journal saved here before; only an identical one is kept.
+            const SegmentFileHeader header = HeaderFor(*s, j.entries);
+            if (SegmentFileMatches(directory / "index" / name, header)) continue;
+
+            // Written under a temporary name and renamed, so a crash never leaves a partial segment behind.
+            auto temporary = directory / "index" / (name + ".tmp");
+            {
+                ofstream out(temporary, ios::binary | ios::trunc);
+                out.write(reinterpret_cast<const char*>(&header), sizeof header);
+                out.write(reinterpret_cast<const char*>(s->terms.data()), s->terms.size() * sizeof(TermInfo));
+                out.write(s->term_chars.data(), s->term_chars.size());
+                out.write(reinterpret_cast<const char*>(s->postings.data()), s->postings.size());
+                out.write(reinterpret_cast<const char*>(s->skips.data()), s->skips.size() * sizeof(Skip));
+                if (!out) throw runtime_error("PersistenceManager: cannot write " + name);
+            }
+            filesystem::rename(temporary, directory / "index" / name);
+        }
+
+        for (auto& file : filesystem::directory_iterator(directory / "index"))
+        {
+            if (find(keep.begin(), keep.end(), file.path().filename().string()) == keep.end()) filesystem::remove(file.path());
+        }
+    }
+
+    // Loads entries and index; entries the saved index does not cover yet are indexed on the way.
+    static void Load(Journal& j, JournalIndex& index, const filesystem::path& directory)
+    {
+        {
+            ifstream in(directory / "entries.log", ios::binary);
+            uint32_t length;
+            while (in.read(reinterpret_cast<char*>(&length), sizeof length))
+            {
+                string e(length, '\0');
+                if (!in.read(e.data(), length)) break;
+                j.entries.push_back(move(e));
+            }
+        }
+
+        vector<pair<uint32_t, filesystem::path>> files;
+        if (filesystem::exists(directory / "index"))
+        {
+            for (auto& file : filesystem::directory_iterator(directory / "index"))
+            {
+                unsigned first, end;
+                if (sscanf(file.path().filename().string().c_str(), "segment-%u-%u.idx", &first, &end) == 2) files.push_back({ first, file.path() });
+            }
+        }
+        sort(files.begin(), files.end());
+
+        for (auto& [first, path] : files)
+        {
+            // Any segment that fails a check ends the index here; the remaining entries are indexed below.
+            error_code ec;
+            const uint64_t file_size = filesystem::file_size(path, ec);
+            ifstream in(path, ios::binary);
+            SegmentFileHeader header{};
+            in.read(reinterpret_cast<char*>(&header), sizeof header);
+            if (ec || !in || memcmp(header.magic, SegmentFileHeader::expected_magic, sizeof header.magic) != 0
+                || header.version != SegmentFileHeader::current_version || header.first_doc != index.EntryCount()
+                || header.end_doc > j.entries.size()
+                || header.term_count > file_size || header.chars_size > file_size || header.postings_size > file_size || header.skip_count > file_size
+                || sizeof header + header.BodySize() != file_size)
+            {
+                break;
+            }
+
+            Segment s;
+            s.first_doc = header.first_doc;
+            s.end_doc = header.end_doc;
+            s.terms.resize(header.term_count);
+            s.term_chars.resize(header.chars_size);
+            s.postings.resize(header.postings_size);
+            s.skips.resize(header.skip_count);
+            in.read(reinterpret_cast<char*>(s.terms.data()), s.terms.size() * sizeof(TermInfo));
+            in.read(s.term_chars.data(), s.term_chars.size());
+            in.read(reinterpret_cast<char*>(s.postings.data()), s.postings.size());
+            in.read(reinterpret_cast<char*>(s.skips.data()), s.skips.size() * sizeof(Skip));
+            if (!in || BodyChecksum(s) != header.checksum || !s.Consistent()
+                || EntriesChecksum(j.entries, header.first_doc, header.end_doc) != header.entries_checksum)
+            {
+                break;
+            }
+            index.Adopt(move(s));
+        }
+
+        for (size_t doc = index.EntryCount(); doc < j.entries.size(); ++doc) index.Add(j.entries[doc]);
+        j.index = &index;
+    }
+};
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+using Clock = chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point begin)
+{
+    return chrono::duration<double, milli>(Clock::now() - begin).count();
+}
+
+// Synthetic entries: word frequencies follow a Zipf distribution over `vocabulary` made-up words.
+class EntryGenerator
+{
+private:
+    vector<string> words;
+    vector<double> cdf;
+    mt19937 rng{ 17 };
+
+public:
+    explicit EntryGenerator(size_t vocabulary)
+    {
+        double total = 0;
+        for (size_t rank = 1; rank <= vocabulary; ++rank)
+        {
+            string w;
+            for (size_t r = rank; r != 0; r /= 20) w += "bcdfghklmnprstvz"[r % 16], w += "aeiou"[r % 5];
+            words.push_back(w);
+            cdf.push_back(total += 1.0 / rank);
+        }
+        for (auto& c : cdf) c /= total;
+    }
+
+    const string& Word(size_t rank) const { return words[rank]; }
+
+    string Entry(size_t length)
+    {
+        string entry;
+        for (size_t i = 0; i < length; ++i)
+        {
+            double u = uniform_real_distribution<double>(0, 1)(rng);
+            size_t rank = min<size_t>(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), words.size() - 1);
+            if (i) entry += ' ';
+            entry += words[rank];
+        }
+        return entry;
+    }
+};
+
+// The only option without an index: tokenize every entry.
+vector<uint32_t> ScanAnd(const vector<string>& entries, const vector<string>& terms)
+{
+    vector<uint32_t> result;
+    vector<bool> seen(terms.size());
+    for (uint32_t doc = 0; doc < entries.size(); ++doc)
+    {
+        fill(seen.begin(), seen.end(), false);
+        ForEachWord(entries[doc], [&](string_view word, uint32_t) {
+            for (size_t i = 0; i < terms.size(); ++i) seen[i] = seen[i] || word == terms[i];
+        });
+        if (all_of(seen.begin(), seen.end(), [](bool b) { return b; })) result.push_back(doc);
+    }
+    return result;
+}
+
+// Entries containing the words of `phrase` next to each other, in order, found by tokenizing every entry.
+vector<uint32_t> ScanPhrase(const vector<string>& entries, string_view phrase)
+{
+    vector<string> terms;
+    ForEachWord(phrase, [&](string_view word, uint32_t) { terms.emplace_back(word); });
+    vector<uint32_t> result;
+    vector<string> words;
+    for (uint32_t doc = 0; doc < entries.size(); ++doc)
+    {
+        words.clear();
+        ForEachWord(entries[doc], [&](string_view word, uint32_t) { words.emplace_back(word); });
+        if (!terms.empty() && search(words.begin(), words.end(), terms.begin(), terms.end()) != words.end()) result.push_back(doc);
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    {
+        JournalIndex index;
+        Journal journal("My Journal", &index);
+        journal.AddEntry("I ate a bug.");
+        journal.AddEntry("I cried today.");
+        journal.AddEntry("Today I ate nothing, but the bug ate me.");
+        for (auto& e : journal.Search(index.And({ "ate", "bug" }))) cout << "ate AND bug: " << e << endl;
+        for (auto& e : journal.Search(index.Or({ "cried", "nothing" }))) cout << "cried OR nothing: " << e << endl;
+        for (auto& e : journal.Search(index.Phrase("ate a bug"))) cout << "\"ate a bug\": " << e << endl;
+
+        // Phrases whose words also occur earlier in an entry than their place in the phrase.
+        journal.AddEntry("bug x ate bug");
+        journal.AddEntry("ate bug");
+        for (const char* phrase : { "ate a bug", "ate bug", "bug ate", "the bug ate me", "i ate" })
+        {
+            bool same = index.Phrase(phrase) == ScanPhrase(journal.entries, phrase);
+            cout << "\"" << phrase << "\": " << (same ? "same entries as a full scan" : "MISMATCH with a full scan") << endl;
+        }
+    }
+
+    // Benchmark
+    const size_t entry_count = argc > 1 ? stoul(argv[1]) : 2'000'000;
+    const size_t words_per_entry = 12;
+    EntryGenerator generator(50'000);
+    vector<string> generated;
+    generated.reserve(entry_count);
+    for (size_t i = 0; i < entry_count; ++i) generated.push_back(generator.Entry(words_per_entry));
+
+    const filesystem::path directory = filesystem::temp_directory_path() / "journal-search-example";
+    filesystem::remove_all(directory);
+
+    JournalIndex index;
+    Journal journal("Big Journal", &index);
+    auto t = Clock::now();
+    for (auto& e : generated) journal.AddEntry(e);
+    index.Segments();   // seals the last partial buffer
+    double add_ms = MillisecondsSince(t);
+    t = Clock::now();
+    index.WaitForMerges();
+    double merge_wait_ms = MillisecondsSince(t);
+
+    size_t text_bytes = 0;
+    for (auto& e : journal.entries) text_bytes += e.size();
+    cout << endl << entry_count << " entries, " << text_bytes / (1024 * 1024) << " MB of text:" << endl;
+    cout << "  indexing: " << static_cast<size_t>(entry_count / (add_ms / 1000)) << " entries/s ("
+         << merge_wait_ms << " ms waiting for merges at the end)" << endl;
+    cout << "  index:    " << index.BytesUsed() / (1024 * 1024) << " MB in " << index.SegmentCount() << " segments after "
+         << index.MergeCount() << " background merges, " << double(index.BytesUsed()) / (entry_count * words_per_entry)
+         << " bytes per word occurrence" << endl;
+
+    // Queries: a rare and a common word, two common words, an OR, and a phrase taken from an entry.
+    const string& common = generator.Word(3);
+    const string& also_common = generator.Word(10);
+    const string& rare = generator.Word(20'000);
+    string phrase;
+    {
+        vector<string> words;
+        ForEachWord(journal.entries[entry_count / 2], [&](string_view w, uint32_t) { words.emplace_back(w); });
+        phrase = words[4] + " " + words[5] + " " + words[6];
+    }
+
+    // `scan` is the full-scan equivalent each indexed answer is checked against, where there is one.
+    struct Query { string label; function<vector<uint32_t>()> run; function<vector<uint32_t>()> scan; };
+    vector<Query> queries = {
+        { rare + " AND " + common, [&] { return index.And({ rare, common }); }, [&] { return ScanAnd(journal.entries, { rare, common }); } },
+        { common + " AND " + also_common, [&] { return index.And({ common, also_common }); }, [&] { return ScanAnd(journal.entries, { common, also_common }); } },
+        { rare + " OR " + also_common, [&] { return index.Or({ rare, also_common }); }, nullptr },
+        { "\"" + phrase + "\"", [&] { return index.Phrase(phrase); }, [&] { return ScanPhrase(journal.entries, phrase); } },
+        { "\"" + common + " " + common + "\"", [&] { return index.Phrase(common + " " + common); }, [&] { return ScanPhrase(journal.entries, common + " " + common); } },
+    };
+
+    cout << endl << "Queries:" << endl;
+    for (auto& q : queries)
+    {
+        const int repeats = 5;
+        vector<uint32_t> hits;
+        t = Clock::now();
+        for (int r = 0; r < repeats; ++r) hits = q.run();
+        double ms = MillisecondsSince(t) / repeats;
+        cout << "  " << q.label << ": " << hits.size() << " entries in " << ms << " ms";
+        if (q.scan)
+        {
+            t = Clock::now();
+            auto scanned = q.scan();
+            double scan_ms = MillisecondsSince(t);
+            cout << " (full scan: " << scan_ms << " ms" << (scanned == hits ? ", same entries)" : ", MISMATCH)");
+        }
+        cout << endl;
+    }
+
+    // Persistence: the index is saved with the entries, so loading does not re-index them.
+    t = Clock::now();
+    PersistenceManager::Save(journal, index, directory);
+    double save_ms = MillisecondsSince(t);
+    journal.AddEntry("One more entry after the save, about a " + rare + " and a bug.");
+    t = Clock::now();
+    PersistenceManager::Save(journal, index, directory);
+    double resave_ms = MillisecondsSince(t);
+
+    JournalIndex loaded_index;
+    Journal loaded("Big Journal");
+    t = Clock::now();
+    PersistenceManager::Load(loaded, loaded_index, directory);
+    double load_ms = MillisecondsSince(t);
+
+    t = Clock::now();
+    JournalIndex rebuilt;
+    for (auto& e : loaded.entries) rebuilt.Add(e);
+    rebuilt.Phrase("warm up");
+    double rebuild_ms = MillisecondsSince(t);
+
+    bool same = loaded_index.And({ rare, common }) == index.And({ rare, common })
+             && loaded_index.Phrase(phrase) == index.Phrase(phrase)
+             && loaded_index.And({ rare, "bug" }) == vector<uint32_t>{ static_cast<uint32_t>(entry_count) };
+    cout << endl << "Persistence:" << endl;
+    cout << "  save " << save_ms << " ms, save after one more entry " << resave_ms << " ms (the entries are rewritten, but only new index segments are)" << endl;
+    cout << "  load with index " << load_ms << " ms, load by re-indexing " << rebuild_ms << " ms; "
+         << (same ? "same answers as before the save" : "MISMATCH after load") << endl;
+
+    filesystem::remove_all(directory);
+    return 0;
+}
@@ -0,0 +1,454 @@
+// Parallel Streaming Filter
+
+// Builds on the Open/Closed example (openClosedPrinciple.cpp).
+// IFilter::Filter runs on one thread and returns a fully materialized vector<T*>.
+// On a catalog with millions of products that is one large allocation per query, idle cores while it runs,
+// and a caller who only wants the first few matches still waits for the whole scan.
+
+// Explanation of File:
+// ParallelFilter is another IFilter, so it is a drop-in extension rather than a modification.
+// The item range is cut into fixed-size chunks, and each chunk is one pool task. A task evaluates the specification
+// into its own buffer and publishes the buffer into the chunk's slot with a single atomic store. Nothing is locked:
+// each slot has exactly one writer and one reader.
+//
+// Stream() returns a lazy range. Its iterator walks the slots in order and waits only for the chunk it needs next,
+// so the first match is available as soon as the first chunk containing one is done.
+// Chunk tasks are submitted in order by the reader itself, at most `window` chunks ahead of the chunk it is reading,
+// so memory stays bounded however large the input is. A task never waits for the reader: a slow reader just leaves
+// pool threads free for other work, and any number of streams can share one pool.
+// With limit(k), no more chunks are submitted once the finished chunks hold k matches:
+// chunks are submitted in order, so the first k matches are guaranteed to be among those already submitted.
+//
+// Specifications are called from several threads at once, so IsSatisfied must not modify shared state.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+enum class Color { red, green, blue };
+enum class Size { small, medium, large };
+
+struct Product
+{
+    string name;
+    Color color;
+    Size size;
+};
+
+template <typename T>
+struct ISpecification
+{
+    virtual bool IsSatisfied(T* item) = 0;
+};
+
+template <typename T>
+struct IFilter
+{
+    virtual vector<T*> Filter(vector<T*> items, ISpecification<T>& spec) = 0;
+};
+
+struct BetterFilter : IFilter<Product>
+{
+    vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec) override
+    {
+        vector<Product*> result;
+        for (auto& item : items)
+        {
+            if (spec.IsSatisfied(item))
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+struct ColorSpecification : ISpecification<Product>
+{
+    Color color;
+    ColorSpecification(Color color) : color(color) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->color == color;
+    }
+};
+
+struct SizeSpecification : ISpecification<Product>
+{
+    Size size;
+    SizeSpecification(Size size) : size(size) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->size == size;
+    }
+};
+
+struct AndSpecification : ISpecification<Product>
+{
+    ISpecification<Product>& first;
+    ISpecification<Product>& second;
+    AndSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return first.IsSatisfied(item) && second.IsSatisfied(item);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+class ThreadPool
+{
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex m;
+    condition_variable wake;
+    bool stopping = false;
+
+public:
+    explicit ThreadPool(unsigned threads)
+    {
+        for (unsigned i = 0; i < max(1u, threads); ++i)
+        {
+            workers.emplace_back([this] {
+                for (;;)
+                {
+                    function<void()> task;
+                    {
+                        unique_lock<mutex> lock(m);
+                        wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                        if (stopping && tasks.empty()) return;
+                        task = move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    void Submit(function<void()> task)
+    {
+        {
+            lock_guard<mutex> lock(m);
+            tasks.push(move(task));
+        }
+        wake.notify_one();
+    }
+
+    unsigned Size() const { return static_cast<unsigned>(workers.size()); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class FilterStream
+{
+private:
+    struct Slot
+    {
+        vector<T*> matches;
+        atomic<bool> ready{ false };
+    };
+
+    // Shared between the reader and the chunk tasks. Tasks hold a shared_ptr so the state outlives an abandoned stream.
+    struct State : enable_shared_from_this<State>
+    {
+        ThreadPool& pool;
+        const vector<T*>& items;
+        ISpecification<T>& spec;
+        size_t chunk_size;
+        size_t window;
+        size_t limit;
+
+        size_t chunk_count;
+        unique_ptr<Slot[]> slots;
+
+        size_t submitted = 0;              // reader only: chunks handed to the pool
+        atomic<size_t> found{ 0 };
+        atomic<bool> cancelled{ false };
+        atomic<unsigned> running{ 0 };     // tasks submitted and not finished
+
+        State(ThreadPool& pool, const vector<T*>& items, ISpecification<T>& spec, size_t chunk_size, size_t window, size_t limit)
+            : pool(pool), items(items), spec(spec), chunk_size(chunk_size), window(window), limit(limit),
+              chunk_count((items.size() + chunk_size - 1) / chunk_size), slots(new Slot[chunk_count]) {}
+
+        // Called by the reader: submits chunks up to `window` ahead of `reading`.
+        void Submit(size_t reading)
+        {
+            const size_t horizon = min(chunk_count, reading + window);
+            while (submitted < horizon && !cancelled.load(memory_order_relaxed) && found.load(memory_order_relaxed) < limit)
+            {
+                running.fetch_add(1, memory_order_relaxed);
+                pool.Submit([s = this->shared_from_this(), chunk = submitted] { s->Work(chunk); });
+                ++submitted;
+            }
+        }
+
+        void Work(size_t chunk)
+        {
+            vector<T*> local;
+            size_t begin = chunk * chunk_size, end = min(items.size(), begin + chunk_size);
+            for (size_t i = begin; i < end && !cancelled.load(memory_order_relaxed); ++i)
+            {
+                if (spec.IsSatisfied(items[i])) local.push_back(items[i]);
+            }
+            found.fetch_add(local.size(), memory_order_relaxed);
+
+            Slot& slot = slots[chunk];
+            slot.matches = move(local);
+            slot.ready.store(true, memory_order_release);
+            slot.ready.notify_one();
+            if (running.fetch_sub(1, memory_order_acq_rel) == 1) running.notify_all();
+        }
+    };
+
+    shared_ptr<State> state;
+
+public:
+    // A chunk must hold at least one item, and at least one chunk must be in flight, or the reader would never get one.
+    static void CheckOptions(size_t chunk_size, size_t window)
+    {
+        if (chunk_size == 0) throw invalid_argument("FilterStream: chunk_size must be at least 1");
+        if (window == 0) throw invalid_argument("FilterStream: window must be at least 1");
+    }
+
+    FilterStream(ThreadPool& pool, const vector<T*>& items, ISpecification<T>& spec, size_t chunk_size, size_t window, size_t limit)
+        : state((CheckOptions(chunk_size, window), make_shared<State>(pool, items, spec, chunk_size, window, limit)))
+    {
+        state->Submit(0);
+    }
+
+    FilterStream(FilterStream&&) = default;
+    FilterStream& operator=(FilterStream&&) = delete;
+
+    // Cancels the submitted chunks and waits for them, because they read `items` and `spec`, which the caller owns.
+    ~FilterStream()
+    {
+        if (!state) return;
+        state->cancelled.store(true);
+        for (unsigned r = state->running.load(); r != 0; r = state->running.load())
+        {
+            state->running.wait(r);
+        }
+    }
+
+    class iterator
+    {
+    private:
+        State* s = nullptr;
+        size_t chunk = 0;
+        size_t pos = 0;
+        size_t emitted = 0;
+
+        // Moves to the next match, blocking only on the chunk that is needed next.
+        void Settle()
+        {
+            while (s)
+            {
+                if (emitted >= s->limit || chunk >= s->chunk_count)
+                {
+                    s = nullptr;
+                    return;
+                }
+                Slot& slot = s->slots[chunk];
+                slot.ready.wait(false, memory_order_acquire);
+                if (pos < slot.matches.size()) return;
+                vector<T*>().swap(slot.matches);
+                ++chunk;
+                pos = 0;
+                s->Submit(chunk);
+            }
+        }
+
+    public:
+        using value_type = T*;
+        using difference_type = ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(State* s) : s(s) { Settle(); }
+
+        T*& operator*() const { return s->slots[chunk].matches[pos]; }
+        iterator& operator++()
+        {
+            ++pos;
+            ++emitted;
+            Settle();
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(const iterator& other) const { return s == other.s; }
+    };
+
+    // Single pass: like a generator, the range can be iterated once.
+    iterator begin() { return iterator(state.get()); }
+    iterator end() { return iterator(); }
+};
+
+struct ParallelFilter : IFilter<Product>
+{
+    ThreadPool& pool;
+    size_t chunk_size;
+    size_t window;
+
+    ParallelFilter(ThreadPool& pool, size_t chunk_size = 16 * 1024, size_t window = 64)
+        : pool(pool), chunk_size(chunk_size), window(window)
+    {
+        FilterStream<Product>::CheckOptions(chunk_size, window);
+    }
+
+    FilterStream<Product> Stream(const vector<Product*>& items, ISpecification<Product>& spec,
+                                 size_t limit = numeric_limits<size_t>::max())
+    {
+        return FilterStream<Product>(pool, items, spec, chunk_size, window, limit);
+    }
+
+    // Callback sink: invoked on the calling thread, in item order, as chunks complete. Returns the number of matches.
+    template <typename Sink>
+    size_t ForEach(const vector<Product*>& items, ISpecification<Product>& spec, Sink&& sink,
+                   size_t limit = numeric_limits<size_t>::max())
+    {
+        size_t n = 0;
+        for (Product* p : Stream(items, spec, limit))
+        {
+            sink(p);
+            ++n;
+        }
+        return n;
+    }
+
+    vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec) override
+    {
+        vector<Product*> result;
+        ForEach(items, spec, [&](Product* p) { result.push_back(p); });
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+using Clock = chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point begin)
+{
+    return chrono::duration<double, milli>(Clock::now() - begin).count();
+}
+
+int main(int argc, char* argv[])
+{
+    ThreadPool pool(max(2u, thread::hardware_concurrency()));
+
+    Product apple{ "Apple", Color::green, Size::small };
+    Product tree{ "Tree", Color::green, Size::large };
+    Product house{ "House", Color::blue, Size::large };
+
+    vector<Product*> items{ &apple, &tree, &house };
+
+    ParallelFilter pf(pool);
+    ColorSpecification green(Color::green);
+
+    for (auto& item : pf.Stream(items, green))
+    {
+        cout << item->name << " is green." << endl;
+    }
+
+    // Benchmark
+    const size_t n = argc > 1 ? stoull(argv[1]) : 20'000'000;
+    mt19937 rng(3);
+    uniform_int_distribution<int> pick(0, 2);
+    vector<Product> catalog(n);
+    vector<Product*> big(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        catalog[i] = { string(), static_cast<Color>(pick(rng)), static_cast<Size>(pick(rng)) };
+        big[i] = &catalog[i];
+    }
+    // Make the query match only in the second half of the catalog, so time-to-first-match means something.
+    SizeSpecification large(Size::large);
+    ColorSpecification red(Color::red);
+    AndSpecification query(red, large);
+    for (size_t i = 0; i < n / 2; ++i)
+    {
+        if (catalog[i].color == Color::red) catalog[i].size = Size::small;
+    }
+
+    BetterFilter bf;
+    auto t = Clock::now();
+    auto expected = bf.Filter(big, query);
+    double better_ms = MillisecondsSince(t);
+
+    t = Clock::now();
+    auto all = pf.Filter(big, query);
+    double parallel_ms = MillisecondsSince(t);
+
+    t = Clock::now();
+    double first_ms = 0;
+    size_t streamed = 0;
+    for (Product* p : pf.Stream(big, query))
+    {
+        if (streamed++ == 0) first_ms = MillisecondsSince(t);
+        (void)p;
+    }
+    double stream_ms = MillisecondsSince(t);
+
+    t = Clock::now();
+    vector<Product*> top;
+    pf.ForEach(big, query, [&](Product* p) { top.push_back(p); }, 10);
+    double limit_ms = MillisecondsSince(t);
+
+    // Two streams on the same pool, read in lockstep. Chunk tasks never wait for their reader, so one stream's
+    // tasks cannot hold every pool thread while the reader waits on the other stream.
+    t = Clock::now();
+    size_t lockstep = 0;
+    {
+        auto first = pf.Stream(big, query), second = pf.Stream(big, query);
+        for (auto a = first.begin(), b = second.begin(); a != first.end() && b != second.end(); ++a, ++b)
+        {
+            if (*a == *b) ++lockstep;
+        }
+    }
+    double lockstep_ms = MillisecondsSince(t);
+
+    bool same = all == expected && streamed == expected.size() && lockstep == expected.size()
+                && equal(top.begin(), top.end(), expected.begin());
+
+    cout << endl << n << " products, query: red AND large (matches only in the second half), "
+         << pool.Size() << " workers" << endl;
+    cout << "  BetterFilter (materialized):     " << better_ms << " ms, " << expected.size() << " matches" << endl;
+    cout << "  ParallelFilter::Filter:          " << parallel_ms << " ms" << endl;
+    cout << "  ParallelFilter::Stream:          first match after " << first_ms << " ms, all after " << stream_ms << " ms" << endl;
+    cout << "  ParallelFilter limit(10):        " << limit_ms << " ms" << endl;
+    cout << "  two streams read in lockstep:    " << lockstep_ms << " ms" << endl;
+    cout << "  results " << (same ? "match" : "DO NOT match") << " BetterFilter" << endl;
+
+    return 0;
+}
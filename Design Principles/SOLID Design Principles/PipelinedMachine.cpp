@@ -0,0 +1,557 @@
+// Pipelined Machine
+// Builds on the Interface Segregation example (InterfaceSegregation.cpp).
+// Machine there forwards Print and Scan one document at a time, so while the printer is busy the scanner sits idle,
+// and Document is only a forward declaration.
+
+// Explanation of File:
+// Document is a real payload: a page raster plus the bookkeeping each stage adds to it.
+// PipelinedMachine is built from the same segregated interfaces (IScanner, IProcessor, IPrinter and optionally IFax)
+// and runs each of them as a concurrent stage:
+//  - Every stage has its own number of workers. Between two stages with m and n workers there are m * n
+//    single-producer single-consumer ring buffers, one per (producer, consumer) pair, so no queue ever needs a lock.
+//    Producers deal documents round-robin over their output rings; consumers take turns over their input rings.
+//  - Documents travel as unique_ptr<Document>, so handing one to the next stage moves a pointer and never copies pages.
+//  - The rings are bounded. A full ring stops its producer (a stall); an empty one idles its consumer.
+//    Both are timed per stage, together with busy time, throughput and ring depth, so the report shows which stage
+//    is the bottleneck: it is the one that is busy while the stage before it stalls and the one after it idles.
+// Devices only need to be safe to call from several workers at once if their stage has more than one worker.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include<fstream>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+struct Document
+{
+    uint64_t id = 0;
+    string name;
+    uint32_t width = 0, height = 0;
+    vector<uint8_t> pixels;        // 8-bit grey raster, filled by the scanner
+    uint64_t ink = 0;              // set by processing: dark pixels after thresholding
+    bool printed = false;
+    bool faxed = false;
+};
+
+struct IScanner
+{
+    virtual void Scan(Document& doc) = 0;
+};
+
+struct IProcessor
+{
+    virtual void Process(Document& doc) = 0;
+};
+
+struct IPrinter
+{
+    virtual void Print(Document& doc) = 0;
+};
+
+struct IFax
+{
+    virtual void Fax(Document& doc) = 0;
+};
+
+// This is how you would extend/combine the interfaces to make a more complex interface
+struct IMachine : IPrinter, IScanner {};
+
+// The synchronous Machine from InterfaceSegregation.cpp, kept as the baseline
+struct Machine : IMachine
+{
+    IPrinter& printer;
+    IScanner& scanner;
+
+    Machine(IPrinter& printer, IScanner& scanner) : printer(printer), scanner(scanner) {}
+
+    void Print(Document& doc) override
+    {
+        printer.Print(doc);
+    }
+
+    void Scan(Document& doc) override
+    {
+        scanner.Scan(doc);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Bounded single-producer single-consumer ring
+
+#ifdef __cpp_lib_hardware_interference_size
+constexpr size_t cache_line = hardware_destructive_interference_size;
+#else
+constexpr size_t cache_line = 64;
+#endif
+
+template <typename T>
+class SpscQueue
+{
+private:
+    vector<T> slots;
+    const size_t mask;
+
+    // Producer and consumer indices live on separate cache lines, each next to the other side's cached copy.
+    alignas(cache_line) atomic<size_t> head{ 0 };   // next slot to pop, written by the consumer
+    size_t cached_tail = 0;
+    alignas(cache_line) atomic<size_t> tail{ 0 };   // next slot to push, written by the producer
+    size_t cached_head = 0;
+    alignas(cache_line) atomic<bool> closed{ false };
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscQueue(size_t capacity) : slots(bit_ceil(max<size_t>(capacity, 2))), mask(slots.size() - 1) {}
+
+    static size_t bit_ceil(size_t n)
+    {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    // Producer side. Returns false when full, leaving `item` untouched.
+    bool TryPush(T& item)
+    {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - cached_head == slots.size())
+        {
+            cached_head = head.load(memory_order_acquire);
+            if (t - cached_head == slots.size()) return false;
+        }
+        slots[t & mask] = move(item);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool TryPop(T& item)
+    {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == cached_tail)
+        {
+            cached_tail = tail.load(memory_order_acquire);
+            if (h == cached_tail) return false;
+        }
+        item = move(slots[h & mask]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    // Producer side: no more items will be pushed.
+    void Close() { closed.store(true, memory_order_release); }
+
+    // Consumer side: closed and drained.
+    bool Finished()
+    {
+        return closed.load(memory_order_acquire) && head.load(memory_order_relaxed) == tail.load(memory_order_acquire);
+    }
+
+    // Approximate; either side may be moving.
+    size_t Depth() const
+    {
+        return tail.load(memory_order_relaxed) - head.load(memory_order_relaxed);
+    }
+
+    size_t Capacity() const noexcept { return slots.size(); }
+};
+
+// Spins briefly, then yields, then sleeps: cheap when the other side is about to move, harmless when it is not.
+class Backoff
+{
+private:
+    unsigned attempts = 0;
+
+public:
+    void Wait()
+    {
+        if (attempts < 64) ++attempts;
+        else if (attempts < 128)
+        {
+            ++attempts;
+            this_thread::yield();
+        }
+        else this_thread::sleep_for(chrono::microseconds(50));
+    }
+
+    void Reset() noexcept { attempts = 0; }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Pipeline
+
+struct StageOptions
+{
+    unsigned workers = 1;
+    size_t queue_capacity = 32;   // of each ring into this stage
+};
+
+struct StageStats
+{
+    string name;
+    unsigned workers = 0;
+    uint64_t documents = 0;
+    double busy_ms = 0;           // in the device call, summed over workers
+    double stall_ms = 0;          // waiting for room downstream
+    double idle_ms = 0;           // waiting for input
+    double average_depth = 0;     // of the input rings, sampled at every take
+    size_t max_depth = 0;
+    size_t capacity = 0;          // total over the input rings
+};
+
+struct PipelineStats
+{
+    double wall_ms = 0;
+    uint64_t documents = 0;
+    vector<StageStats> stages;
+
+    void Print(ostream& os) const
+    {
+        os << "  " << documents << " documents in " << wall_ms << " ms (" << documents / (wall_ms / 1000) << " documents/s)" << endl;
+        for (auto& s : stages)
+        {
+            char line[256];
+            snprintf(line, sizeof line, "    %-8s x%u: %6.0f docs/s per worker, busy %5.1f%%, stalled %5.1f%%, idle %5.1f%%, queue depth avg %5.1f max %zu/%zu",
+                     s.name.c_str(), s.workers, s.busy_ms > 0 ? s.documents / (s.busy_ms / 1000) : 0.0,
+                     100 * s.busy_ms / (wall_ms * s.workers), 100 * s.stall_ms / (wall_ms * s.workers), 100 * s.idle_ms / (wall_ms * s.workers),
+                     s.average_depth, s.max_depth, s.capacity);
+            os << line << endl;
+        }
+    }
+};
+
+class PipelinedMachine : public IMachine
+{
+private:
+    using DocumentPtr = unique_ptr<Document>;
+    using Rings = vector<vector<unique_ptr<SpscQueue<DocumentPtr>>>>;   // [producer][consumer]
+
+    struct Stage
+    {
+        string name;
+        function<void(Document&)> run;
+        StageOptions options;
+    };
+
+    struct WorkerStats
+    {
+        uint64_t documents = 0;
+        Clock::duration busy{}, stall{}, idle{};
+        uint64_t depth_sum = 0;
+        size_t max_depth = 0;
+    };
+
+    IScanner& scanner;
+    IProcessor& processor;
+    IPrinter& printer;
+    IFax* fax;
+    vector<Stage> stages;
+
+public:
+    // Every stage needs at least one worker; throws invalid_argument naming the first stage that has none.
+    PipelinedMachine(IScanner& scanner, IProcessor& processor, IPrinter& printer, IFax* fax = nullptr,
+                     StageOptions scan = {}, StageOptions process = {}, StageOptions print = {}, StageOptions send = {})
+        : scanner(scanner), processor(processor), printer(printer), fax(fax)
+    {
+        stages.push_back({ "scan", [this](Document& d) { this->scanner.Scan(d); }, scan });
+        stages.push_back({ "process", [this](Document& d) { this->processor.Process(d); }, process });
+        stages.push_back({ "print", [this](Document& d) { this->printer.Print(d); }, print });
+        if (fax) stages.push_back({ "fax", [this](Document& d) { this->fax->Fax(d); }, send });
+        for (auto& stage : stages)
+        {
+            if (stage.options.workers == 0) throw invalid_argument("PipelinedMachine: stage '" + stage.name + "' has no workers");
+        }
+    }
+
+    // Single documents still go straight to the device, as in Machine.
+    void Print(Document& doc) override { printer.Print(doc); }
+    void Scan(Document& doc) override { scanner.Scan(doc); }
+
+    // Runs `count` new documents through every stage. Finished documents are handed to `done`, from the workers
+    // of the last stage; unless it is null, it must be safe to call from several threads if that stage has several.
+    PipelineStats Run(uint64_t count, const function<void(DocumentPtr)>& done = nullptr)
+    {
+        const size_t n = stages.size();
+
+        // rings[s] connects stage s - 1 to stage s; stage 0 takes documents from a counter instead.
+        vector<Rings> rings(n);
+        for (size_t s = 1; s < n; ++s)
+        {
+            rings[s].resize(stages[s - 1].options.workers);
+            for (auto& row : rings[s])
+            {
+                for (unsigned c = 0; c < stages[s].options.workers; ++c)
+                {
+                    row.push_back(make_unique<SpscQueue<DocumentPtr>>(stages[s].options.queue_capacity));
+                }
+            }
+        }
+
+        atomic<uint64_t> next_id{ 0 };
+        vector<vector<WorkerStats>> stats(n);
+        for (size_t s = 0; s < n; ++s) stats[s].resize(stages[s].options.workers);
+
+        auto worker = [&](size_t s, unsigned w) {
+            WorkerStats& st = stats[s][w];
+            const bool first = s == 0, last = s + 1 == n;
+            const unsigned producers = first ? 0 : stages[s - 1].options.workers;
+            const unsigned consumers = last ? 0 : stages[s + 1].options.workers;
+            unsigned next_input = 0, next_output = w % max(consumers, 1u);
+            Backoff backoff;
+
+            for (;;)
+            {
+                // Take a document
+                DocumentPtr doc;
+                if (first)
+                {
+                    uint64_t id = next_id.fetch_add(1, memory_order_relaxed);
+                    if (id >= count) break;
+                    doc = make_unique<Document>();
+                    doc->id = id;
+                    doc->name = "Document " + to_string(id);
+                }
+                else
+                {
+                    auto wait_begin = Clock::now();
+                    bool finished = false;
+                    for (;;)
+                    {
+                        bool all_finished = true;
+                        for (unsigned k = 0; k < producers && !doc; ++k)
+                        {
+                            auto& ring = *rings[s][(next_input + k) % producers][w];
+                            size_t depth = ring.Depth();
+                            if (ring.TryPop(doc))
+                            {
+                                st.depth_sum += depth;
+                                st.max_depth = max(st.max_depth, depth);
+                                next_input = (next_input + k + 1) % producers;
+                            }
+                            else all_finished = all_finished && ring.Finished();
+                        }
+                        if (doc) break;
+                        if (all_finished)
+                        {
+                            finished = true;
+                            break;
+                        }
+                        backoff.Wait();
+                    }
+                    backoff.Reset();
+                    st.idle += Clock::now() - wait_begin;
+                    if (finished) break;
+                }
+
+                // Work on it
+                auto work_begin = Clock::now();
+                stages[s].run(*doc);
+                st.busy += Clock::now() - work_begin;
+                ++st.documents;
+
+                // Hand it on
+                if (last)
+                {
+                    if (done) done(move(doc));
+                    continue;
+                }
+                auto stall_begin = Clock::now();
+                for (;;)
+                {
+                    bool pushed = false;
+                    for (unsigned k = 0; k < consumers && !pushed; ++k)
+                    {
+                        pushed = rings[s + 1][w][(next_output + k) % consumers]->TryPush(doc);
+                        if (pushed) next_output = (next_output + k + 1) % consumers;
+                    }
+                    if (pushed) break;
+                    backoff.Wait();
+                }
+                backoff.Reset();
+                st.stall += Clock::now() - stall_begin;
+            }
+
+            if (!last)
+            {
+                for (auto& ring : rings[s + 1][w]) ring->Close();
+            }
+        };
+
+        auto begin = Clock::now();
+        vector<thread> threads;
+        for (size_t s = 0; s < n; ++s)
+        {
+            for (unsigned w = 0; w < stages[s].options.workers; ++w) threads.emplace_back(worker, s, w);
+        }
+        for (auto& t : threads) t.join();
+
+        PipelineStats result;
+        result.wall_ms = chrono::duration<double, milli>(Clock::now() - begin).count();
+        auto ms = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+        for (size_t s = 0; s < n; ++s)
+        {
+            StageStats st;
+            st.name = stages[s].name;
+            st.workers = stages[s].options.workers;
+            uint64_t depth_sum = 0;
+            for (auto& w : stats[s])
+            {
+                st.documents += w.documents;
+                st.busy_ms += ms(w.busy);
+                st.stall_ms += ms(w.stall);
+                st.idle_ms += ms(w.idle);
+                depth_sum += w.depth_sum;
+                st.max_depth = max(st.max_depth, w.max_depth);
+            }
+            st.average_depth = s == 0 || st.documents == 0 ? 0 : double(depth_sum) / st.documents;
+            if (s != 0) st.capacity = rings[s].size() * rings[s][0].size() * rings[s][0][0]->Capacity();
+            result.stages.push_back(st);
+        }
+        result.documents = result.stages.back().documents;
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Synthetic devices: scanning, printing and faxing are mostly waiting on hardware; processing is CPU work.
+
+void DeviceDelay(chrono::microseconds d)
+{
+    if (d.count() > 0) this_thread::sleep_for(d);
+}
+
+struct SyntheticScanner : IScanner
+{
+    chrono::microseconds delay;
+    uint32_t width, height;
+
+    SyntheticScanner(chrono::microseconds delay, uint32_t width = 256, uint32_t height = 256) : delay(delay), width(width), height(height) {}
+
+    void Scan(Document& doc) override
+    {
+        DeviceDelay(delay);
+        doc.width = width;
+        doc.height = height;
+        doc.pixels.resize(size_t{ width } * height);
+        uint32_t x = static_cast<uint32_t>(doc.id * 2654435761u) | 1;
+        for (auto& p : doc.pixels)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            p = static_cast<uint8_t>(x);
+        }
+    }
+};
+
+struct ThresholdProcessor : IProcessor
+{
+    int passes;
+
+    explicit ThresholdProcessor(int passes) : passes(passes) {}
+
+    // A few passes of a 1-D blur followed by a threshold; the number of passes sets the CPU cost.
+    void Process(Document& doc) override
+    {
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            for (size_t i = 1; i + 1 < doc.pixels.size(); ++i)
+            {
+                doc.pixels[i] = static_cast<uint8_t>((doc.pixels[i - 1] + 2 * doc.pixels[i] + doc.pixels[i + 1]) / 4);
+            }
+        }
+        doc.ink = count_if(doc.pixels.begin(), doc.pixels.end(), [](uint8_t p) { return p < 128; });
+    }
+};
+
+struct SyntheticPrinter : IPrinter
+{
+    chrono::microseconds delay;
+
+    explicit SyntheticPrinter(chrono::microseconds delay) : delay(delay) {}
+
+    void Print(Document& doc) override
+    {
+        DeviceDelay(delay);
+        doc.printed = true;
+    }
+};
+
+struct SyntheticFax : IFax
+{
+    chrono::microseconds delay;
+
+    explicit SyntheticFax(chrono::microseconds delay) : delay(delay) {}
+
+    void Fax(Document& doc) override
+    {
+        DeviceDelay(delay);
+        doc.faxed = true;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const uint64_t documents = argc > 1 ? stoull(argv[1]) : 2000;
+
+    SyntheticScanner scanner(chrono::microseconds(300));
+    ThresholdProcessor processor(2);
+    SyntheticPrinter printer(chrono::microseconds(900));
+    SyntheticFax fax(chrono::microseconds(400));
+
+    // Baseline: one document at a time through every device
+    Machine machine(printer, scanner);
+    auto t = Clock::now();
+    uint64_t ink = 0;
+    for (uint64_t i = 0; i < documents; ++i)
+    {
+        Document doc;
+        doc.id = i;
+        machine.Scan(doc);
+        processor.Process(doc);
+        machine.Print(doc);
+        fax.Fax(doc);
+        ink += doc.ink;
+    }
+    double sequential_ms = chrono::duration<double, milli>(Clock::now() - t).count();
+    cout << "Sequential Machine:" << endl;
+    cout << "  " << documents << " documents in " << sequential_ms << " ms (" << documents / (sequential_ms / 1000) << " documents/s)" << endl;
+
+    // One worker per stage: throughput is set by the slowest stage (print), and the report shows it
+    atomic<uint64_t> pipelined_ink{ 0 }, complete{ 0 };
+    auto collect = [&](unique_ptr<Document> doc) {
+        pipelined_ink += doc->ink;
+        complete += doc->printed && doc->faxed;
+    };
+    {
+        PipelinedMachine pipeline(scanner, processor, printer, &fax);
+        cout << endl << "Pipelined Machine, one worker per stage:" << endl;
+        pipeline.Run(documents, collect).Print(cout);
+    }
+    cout << "  " << (pipelined_ink == ink && complete == documents ? "same results as the sequential machine" : "MISMATCH") << endl;
+
+    // Giving the bottleneck stage more workers moves the bottleneck
+    pipelined_ink = 0;
+    complete = 0;
+    {
+        PipelinedMachine pipeline(scanner, processor, printer, &fax, { 1, 32 }, { 1, 32 }, { 3, 32 }, { 2, 32 });
+        cout << endl << "Pipelined Machine, 3 print and 2 fax workers:" << endl;
+        pipeline.Run(documents, collect).Print(cout);
+    }
+    cout << "  " << (pipelined_ink == ink && complete == documents ? "same results as the sequential machine" : "MISMATCH") << endl;
+
+    return 0;
+}
@@ -0,0 +1,759 @@
+// Bitmap Indexes and a Specification Query Planner
+
+// Builds on the Open/Closed example (openClosedPrinciple.cpp).
+// BetterFilter answers every query by asking ISpecification::IsSatisfied about every product.
+// When a catalog is filtered again and again on the same few attributes, most of that work is repeated.
+
+// Explanation of File:
+// Catalog can keep an optional bitmap index per attribute (Color, Size). An index holds one compressed bitmap
+// of product ids per attribute value and is updated as products are added and removed.
+// The bitmaps are Roaring-style: ids are split by their high 16 bits into chunks, and each chunk is stored
+// either as a sorted array of 16-bit values (sparse) or as a 65536-bit bitmap (dense), whichever is smaller.
+//
+// Planner turns a specification tree into a plan:
+//  - A leaf with an index becomes an index lookup.
+//  - And becomes an intersection, cheapest (most selective) input first. Children without an index are not scanned;
+//    they are checked only against the products that survive the intersection.
+//  - Or becomes a union, and Not becomes "all live products minus the child".
+//  - Anything else falls back to a scan that calls IsSatisfied.
+// Every plan node carries a selectivity estimate, taken exactly from bitmap cardinalities for index lookups
+// and combined assuming independence for And/Or (except a union of values of one attribute, which is an exact sum).
+
+
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include<vector>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <random>
+#include <bit>
+#include <iomanip>
+
+using namespace std;
+
+enum class Color : uint8_t { red, green, blue };
+enum class Size : uint8_t { small, medium, large };
+
+struct Product
+{
+    string name;
+    Color color;
+    Size size;
+};
+
+template <typename T>
+struct ISpecification
+{
+    virtual bool IsSatisfied(T* item) = 0;
+};
+
+template <typename T>
+struct IFilter
+{
+    virtual vector<T*> Filter(vector<T*> items, ISpecification<T>& spec) = 0;
+};
+
+struct BetterFilter : IFilter<Product>
+{
+    vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec) override
+    {
+        vector<Product*> result;
+        for (auto& item : items)
+        {
+            if (spec.IsSatisfied(item))
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Compressed bitmap
+
+class RoaringBitmap
+{
+private:
+    // Chunks with more than this many values are stored as a bitmap (8 KB) instead of an array (2 bytes per value).
+    static constexpr size_t array_limit = 4096;
+    static constexpr size_t bitmap_words = 65536 / 64;
+
+    struct Chunk
+    {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        vector<uint16_t> array;
+        vector<uint64_t> bits;
+
+        bool IsBitmap() const noexcept { return !bits.empty(); }
+
+        bool Contains(uint16_t v) const noexcept
+        {
+            if (IsBitmap())
+            {
+                return (bits[v / 64] >> (v % 64)) & 1;
+            }
+            return binary_search(array.begin(), array.end(), v);
+        }
+
+        bool Add(uint16_t v)
+        {
+            if (IsBitmap())
+            {
+                uint64_t& w = bits[v / 64];
+                uint64_t bit = uint64_t{ 1 } << (v % 64);
+                if (w & bit) return false;
+                w |= bit;
+            }
+            else
+            {
+                auto it = lower_bound(array.begin(), array.end(), v);
+                if (it != array.end() && *it == v) return false;
+                array.insert(it, v);
+            }
+            ++cardinality;
+            Normalize();
+            return true;
+        }
+
+        bool Remove(uint16_t v)
+        {
+            if (IsBitmap())
+            {
+                uint64_t& w = bits[v / 64];
+                uint64_t bit = uint64_t{ 1 } << (v % 64);
+                if (!(w & bit)) return false;
+                w &= ~bit;
+            }
+            else
+            {
+                auto it = lower_bound(array.begin(), array.end(), v);
+                if (it == array.end() || *it != v) return false;
+                array.erase(it);
+            }
+            --cardinality;
+            Normalize();
+            return true;
+        }
+
+        // Switches representation when the cardinality crosses array_limit.
+        void Normalize()
+        {
+            if (!IsBitmap() && cardinality > array_limit)
+            {
+                bits.assign(bitmap_words, 0);
+                for (auto v : array) bits[v / 64] |= uint64_t{ 1 } << (v % 64);
+                vector<uint16_t>().swap(array);
+            }
+            else if (IsBitmap() && cardinality <= array_limit)
+            {
+                array.reserve(cardinality);
+                ForEach([this](uint16_t v) { array.push_back(v); });
+                vector<uint64_t>().swap(bits);
+            }
+        }
+
+        void Recount()
+        {
+            cardinality = 0;
+            for (auto w : bits) cardinality += popcount(w);
+        }
+
+        template <typename F>
+        void ForEach(F&& f) const
+        {
+            if (IsBitmap())
+            {
+                for (size_t i = 0; i < bitmap_words; ++i)
+                {
+                    for (uint64_t w = bits[i]; w != 0; w &= w - 1)
+                    {
+                        f(static_cast<uint16_t>(i * 64 + countr_zero(w)));
+                    }
+                }
+            }
+            else
+            {
+                for (auto v : array) f(v);
+            }
+        }
+    };
+
+    enum class SetOp { intersect, unite, subtract };
+
+    static Chunk Combine(const Chunk& a, const Chunk& b, SetOp op)
+    {
+        Chunk out;
+        out.key = a.key;
+        if (a.IsBitmap() && b.IsBitmap())
+        {
+            out.bits.resize(bitmap_words);
+            for (size_t i = 0; i < bitmap_words; ++i)
+            {
+                out.bits[i] = op == SetOp::intersect ? a.bits[i] & b.bits[i]
+                            : op == SetOp::unite     ? a.bits[i] | b.bits[i]
+                                                     : a.bits[i] & ~b.bits[i];
+            }
+            out.Recount();
+        }
+        else if (!a.IsBitmap() && !b.IsBitmap())
+        {
+            if (op == SetOp::intersect)
+                set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), back_inserter(out.array));
+            else if (op == SetOp::unite)
+                set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), back_inserter(out.array));
+            else
+                set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), back_inserter(out.array));
+            out.cardinality = static_cast<uint32_t>(out.array.size());
+        }
+        else if (op == SetOp::intersect || (op == SetOp::subtract && !a.IsBitmap()))
+        {
+            // Probe the array side against the other chunk.
+            const Chunk& small = a.IsBitmap() ? b : a;
+            const Chunk& other = a.IsBitmap() ? a : b;
+            for (auto v : small.array)
+            {
+                if (other.Contains(v) == (op == SetOp::intersect)) out.array.push_back(v);
+            }
+            out.cardinality = static_cast<uint32_t>(out.array.size());
+        }
+        else
+        {
+            // Union with a bitmap, or bitmap minus array: start from the bitmap and apply the array.
+            const Chunk& dense = a.IsBitmap() ? a : b;
+            const Chunk& sparse = a.IsBitmap() ? b : a;
+            out.bits = dense.bits;
+            for (auto v : sparse.array)
+            {
+                if (op == SetOp::unite) out.bits[v / 64] |= uint64_t{ 1 } << (v % 64);
+                else out.bits[v / 64] &= ~(uint64_t{ 1 } << (v % 64));
+            }
+            out.Recount();
+        }
+        out.Normalize();
+        return out;
+    }
+
+    static RoaringBitmap Combine(const RoaringBitmap& a, const RoaringBitmap& b, SetOp op)
+    {
+        RoaringBitmap out;
+        size_t i = 0, j = 0;
+        while (i < a.chunks_.size() || j < b.chunks_.size())
+        {
+            bool has_a = i < a.chunks_.size(), has_b = j < b.chunks_.size();
+            if (has_a && (!has_b || a.chunks_[i].key < b.chunks_[j].key))
+            {
+                if (op != SetOp::intersect) out.chunks_.push_back(a.chunks_[i]);
+                ++i;
+            }
+            else if (has_b && (!has_a || b.chunks_[j].key < a.chunks_[i].key))
+            {
+                if (op == SetOp::unite) out.chunks_.push_back(b.chunks_[j]);
+                ++j;
+            }
+            else
+            {
+                Chunk c = Combine(a.chunks_[i], b.chunks_[j], op);
+                if (c.cardinality != 0) out.chunks_.push_back(move(c));
+                ++i, ++j;
+            }
+        }
+        return out;
+    }
+
+    vector<Chunk> chunks_;
+
+    vector<Chunk>::iterator FindChunk(uint16_t key)
+    {
+        return lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& c, uint16_t k) { return c.key < k; });
+    }
+
+public:
+    bool Add(uint32_t id)
+    {
+        uint16_t key = static_cast<uint16_t>(id >> 16);
+        auto it = FindChunk(key);
+        if (it == chunks_.end() || it->key != key)
+        {
+            it = chunks_.insert(it, Chunk{});
+            it->key = key;
+        }
+        return it->Add(static_cast<uint16_t>(id));
+    }
+
+    bool Remove(uint32_t id)
+    {
+        uint16_t key = static_cast<uint16_t>(id >> 16);
+        auto it = FindChunk(key);
+        if (it == chunks_.end() || it->key != key) return false;
+        bool removed = it->Remove(static_cast<uint16_t>(id));
+        if (it->cardinality == 0) chunks_.erase(it);
+        return removed;
+    }
+
+    bool Contains(uint32_t id) const
+    {
+        uint16_t key = static_cast<uint16_t>(id >> 16);
+        auto it = lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& c, uint16_t k) { return c.key < k; });
+        return it != chunks_.end() && it->key == key && it->Contains(static_cast<uint16_t>(id));
+    }
+
+    size_t Cardinality() const noexcept
+    {
+        size_t n = 0;
+        for (auto& c : chunks_) n += c.cardinality;
+        return n;
+    }
+
+    size_t BytesUsed() const noexcept
+    {
+        size_t n = 0;
+        for (auto& c : chunks_) n += sizeof(Chunk) + c.array.capacity() * 2 + c.bits.capacity() * 8;
+        return n;
+    }
+
+    template <typename F>
+    void ForEach(F&& f) const
+    {
+        for (auto& c : chunks_)
+        {
+            uint32_t high = uint32_t{ c.key } << 16;
+            c.ForEach([&](uint16_t low) { f(high | low); });
+        }
+    }
+
+    friend RoaringBitmap operator&(const RoaringBitmap& a, const RoaringBitmap& b) { return Combine(a, b, SetOp::intersect); }
+    friend RoaringBitmap operator|(const RoaringBitmap& a, const RoaringBitmap& b) { return Combine(a, b, SetOp::unite); }
+    friend RoaringBitmap operator-(const RoaringBitmap& a, const RoaringBitmap& b) { return Combine(a, b, SetOp::subtract); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Catalog with optional, incrementally maintained indexes
+
+enum class Attribute { color, size };
+
+// One bitmap per attribute value; the attribute enums have three values each.
+struct BitmapIndex
+{
+    RoaringBitmap by_value[3];
+};
+
+struct Catalog
+{
+    vector<Product> products;   // id = position; removed slots stay until the catalog is rebuilt
+    RoaringBitmap live;
+    unique_ptr<BitmapIndex> color_index;
+    unique_ptr<BitmapIndex> size_index;
+
+    static uint8_t ValueOf(const Product& p, Attribute a)
+    {
+        return a == Attribute::color ? static_cast<uint8_t>(p.color) : static_cast<uint8_t>(p.size);
+    }
+
+    unique_ptr<BitmapIndex>& IndexFor(Attribute a) { return a == Attribute::color ? color_index : size_index; }
+    const BitmapIndex* IndexFor(Attribute a) const { return (a == Attribute::color ? color_index : size_index).get(); }
+
+    // Builds the index from the current live products; after that Add/Remove keep it up to date.
+    void EnableIndex(Attribute a)
+    {
+        auto index = make_unique<BitmapIndex>();
+        live.ForEach([&](uint32_t id) { index->by_value[ValueOf(products[id], a)].Add(id); });
+        IndexFor(a) = move(index);
+    }
+
+    uint32_t Add(const Product& p)
+    {
+        uint32_t id = static_cast<uint32_t>(products.size());
+        products.push_back(p);
+        live.Add(id);
+        if (color_index) color_index->by_value[ValueOf(p, Attribute::color)].Add(id);
+        if (size_index) size_index->by_value[ValueOf(p, Attribute::size)].Add(id);
+        return id;
+    }
+
+    void Remove(uint32_t id)
+    {
+        if (!live.Remove(id)) return;
+        const Product& p = products[id];
+        if (color_index) color_index->by_value[ValueOf(p, Attribute::color)].Remove(id);
+        if (size_index) size_index->by_value[ValueOf(p, Attribute::size)].Remove(id);
+    }
+
+    size_t Count() const { return live.Cardinality(); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Plans
+
+struct PlanNode
+{
+    double selectivity = 1.0;   // estimated fraction of live products that match
+    virtual ~PlanNode() = default;
+
+    // Ids of matching products, restricted to `candidates` when given.
+    virtual RoaringBitmap Execute(Catalog& catalog, const RoaringBitmap* candidates) = 0;
+    virtual bool UsesIndex() const = 0;
+    virtual void Explain(ostream& os, int depth) const = 0;
+
+protected:
+    void Line(ostream& os, int depth, const string& what) const
+    {
+        os << string(depth * 2 + 2, ' ') << what << "  (est. " << fixed << setprecision(3) << selectivity * 100 << "%)" << endl;
+    }
+};
+
+struct IndexLookupNode : PlanNode
+{
+    const BitmapIndex& index;
+    const RoaringBitmap& bitmap;
+    string label;
+
+    IndexLookupNode(const BitmapIndex& index, uint8_t value, string label, size_t live)
+        : index(index), bitmap(index.by_value[value]), label(move(label))
+    {
+        selectivity = live == 0 ? 0.0 : double(bitmap.Cardinality()) / live;
+    }
+
+    RoaringBitmap Execute(Catalog&, const RoaringBitmap* candidates) override
+    {
+        return candidates ? bitmap & *candidates : bitmap;
+    }
+
+    bool UsesIndex() const override { return true; }
+    void Explain(ostream& os, int depth) const override { Line(os, depth, "IndexLookup " + label); }
+};
+
+struct ScanNode : PlanNode
+{
+    ISpecification<Product>& spec;
+
+    // Without statistics a scanned predicate is assumed to keep half of its input.
+    explicit ScanNode(ISpecification<Product>& spec) : spec(spec) { selectivity = 0.5; }
+
+    RoaringBitmap Execute(Catalog& catalog, const RoaringBitmap* candidates) override
+    {
+        RoaringBitmap result;
+        (candidates ? *candidates : catalog.live).ForEach([&](uint32_t id) {
+            if (spec.IsSatisfied(&catalog.products[id])) result.Add(id);
+        });
+        return result;
+    }
+
+    bool UsesIndex() const override { return false; }
+    void Explain(ostream& os, int depth) const override { Line(os, depth, "Scan IsSatisfied"); }
+};
+
+struct IntersectNode : PlanNode
+{
+    vector<unique_ptr<PlanNode>> children;
+
+    explicit IntersectNode(vector<unique_ptr<PlanNode>> nodes) : children(move(nodes))
+    {
+        // Indexed inputs first, most selective first; scans last, so they only see surviving candidates.
+        stable_sort(children.begin(), children.end(), [](auto& a, auto& b) {
+            if (a->UsesIndex() != b->UsesIndex()) return a->UsesIndex();
+            return a->selectivity < b->selectivity;
+        });
+        for (auto& c : children) selectivity *= c->selectivity;
+    }
+
+    RoaringBitmap Execute(Catalog& catalog, const RoaringBitmap* candidates) override
+    {
+        RoaringBitmap current = children.front()->Execute(catalog, candidates);
+        for (size_t i = 1; i < children.size() && current.Cardinality() != 0; ++i)
+        {
+            current = children[i]->Execute(catalog, &current);
+        }
+        return current;
+    }
+
+    bool UsesIndex() const override { return children.front()->UsesIndex(); }
+
+    void Explain(ostream& os, int depth) const override
+    {
+        Line(os, depth, "Intersect");
+        for (auto& c : children) c->Explain(os, depth + 1);
+    }
+};
+
+struct UnionNode : PlanNode
+{
+    vector<unique_ptr<PlanNode>> children;
+
+    explicit UnionNode(vector<unique_ptr<PlanNode>> nodes) : children(move(nodes))
+    {
+        // Different values of the same attribute never overlap, so their selectivities add up exactly.
+        // Anything else is combined assuming independence.
+        auto* first = dynamic_cast<IndexLookupNode*>(children.front().get());
+        bool same_index = first && all_of(children.begin(), children.end(), [&](auto& c) {
+            auto* lookup = dynamic_cast<IndexLookupNode*>(c.get());
+            return lookup && &lookup->index == &first->index;
+        });
+        double sum = 0.0, none = 1.0;
+        for (auto& c : children)
+        {
+            sum += c->selectivity;
+            none *= 1.0 - c->selectivity;
+        }
+        selectivity = same_index ? min(1.0, sum) : 1.0 - none;
+    }
+
+    RoaringBitmap Execute(Catalog& catalog, const RoaringBitmap* candidates) override
+    {
+        RoaringBitmap result;
+        for (auto& c : children) result = result | c->Execute(catalog, candidates);
+        return result;
+    }
+
+    bool UsesIndex() const override
+    {
+        return all_of(children.begin(), children.end(), [](auto& c) { return c->UsesIndex(); });
+    }
+
+    void Explain(ostream& os, int depth) const override
+    {
+        Line(os, depth, "Union");
+        for (auto& c : children) c->Explain(os, depth + 1);
+    }
+};
+
+struct ComplementNode : PlanNode
+{
+    unique_ptr<PlanNode> child;
+
+    explicit ComplementNode(unique_ptr<PlanNode> node) : child(move(node)) { selectivity = 1.0 - child->selectivity; }
+
+    RoaringBitmap Execute(Catalog& catalog, const RoaringBitmap* candidates) override
+    {
+        const RoaringBitmap& universe = candidates ? *candidates : catalog.live;
+        return universe - child->Execute(catalog, candidates);
+    }
+
+    bool UsesIndex() const override { return child->UsesIndex(); }
+
+    void Explain(ostream& os, int depth) const override
+    {
+        Line(os, depth, "Complement");
+        child->Explain(os, depth + 1);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Specifications
+// Specifications that the planner understands implement PlannableSpecification.
+// Any other ISpecification still works; the planner simply scans for it.
+
+struct PlannableSpecification : ISpecification<Product>
+{
+    virtual unique_ptr<PlanNode> Plan(const Catalog& catalog) = 0;
+};
+
+unique_ptr<PlanNode> PlanFor(ISpecification<Product>& spec, const Catalog& catalog)
+{
+    if (auto* plannable = dynamic_cast<PlannableSpecification*>(&spec))
+    {
+        return plannable->Plan(catalog);
+    }
+    return make_unique<ScanNode>(spec);
+}
+
+template <Attribute A, typename V>
+struct AttributeSpecification : PlannableSpecification
+{
+    V value;
+    AttributeSpecification(V value) : value(value) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return Catalog::ValueOf(*item, A) == static_cast<uint8_t>(value);
+    }
+
+    unique_ptr<PlanNode> Plan(const Catalog& catalog) override
+    {
+        if (const BitmapIndex* index = catalog.IndexFor(A))
+        {
+            string label = string(A == Attribute::color ? "color" : "size") + " = " + to_string(static_cast<int>(value));
+            return make_unique<IndexLookupNode>(*index, static_cast<uint8_t>(value), label, catalog.Count());
+        }
+        auto scan = make_unique<ScanNode>(*this);
+        scan->selectivity = 1.0 / 3;
+        return scan;
+    }
+};
+
+using ColorSpecification = AttributeSpecification<Attribute::color, Color>;
+using SizeSpecification = AttributeSpecification<Attribute::size, Size>;
+
+struct AndSpecification : PlannableSpecification
+{
+    ISpecification<Product>& first;
+    ISpecification<Product>& second;
+    AndSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+
+    bool IsSatisfied(Product* item) override { return first.IsSatisfied(item) && second.IsSatisfied(item); }
+
+    unique_ptr<PlanNode> Plan(const Catalog& catalog) override
+    {
+        vector<unique_ptr<PlanNode>> children;
+        children.push_back(PlanFor(first, catalog));
+        children.push_back(PlanFor(second, catalog));
+        return make_unique<IntersectNode>(move(children));
+    }
+};
+
+struct OrSpecification : PlannableSpecification
+{
+    ISpecification<Product>& first;
+    ISpecification<Product>& second;
+    OrSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+
+    bool IsSatisfied(Product* item) override { return first.IsSatisfied(item) || second.IsSatisfied(item); }
+
+    unique_ptr<PlanNode> Plan(const Catalog& catalog) override
+    {
+        vector<unique_ptr<PlanNode>> children;
+        children.push_back(PlanFor(first, catalog));
+        children.push_back(PlanFor(second, catalog));
+        // One side without an index means every product must be looked at anyway; scan once instead of twice.
+        if (!children[0]->UsesIndex() || !children[1]->UsesIndex())
+        {
+            auto scan = make_unique<ScanNode>(*this);
+            scan->selectivity = UnionNode(move(children)).selectivity;
+            return scan;
+        }
+        return make_unique<UnionNode>(move(children));
+    }
+};
+
+struct NotSpecification : PlannableSpecification
+{
+    ISpecification<Product>& spec;
+    NotSpecification(ISpecification<Product>& spec) : spec(spec) {}
+
+    bool IsSatisfied(Product* item) override { return !spec.IsSatisfied(item); }
+
+    unique_ptr<PlanNode> Plan(const Catalog& catalog) override
+    {
+        return make_unique<ComplementNode>(PlanFor(spec, catalog));
+    }
+};
+
+// A predicate with no index: the planner can only scan for it.
+struct NamePrefixSpecification : ISpecification<Product>
+{
+    string prefix;
+    NamePrefixSpecification(string prefix) : prefix(move(prefix)) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->name.compare(0, prefix.size(), prefix) == 0;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename F>
+double Milliseconds(F&& f)
+{
+    auto begin = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char* argv[])
+{
+    Catalog catalog;
+    catalog.EnableIndex(Attribute::color);
+    catalog.EnableIndex(Attribute::size);
+
+    uint32_t apple = catalog.Add({ "Apple", Color::green, Size::small });
+    catalog.Add({ "Tree", Color::green, Size::large });
+    catalog.Add({ "House", Color::blue, Size::large });
+
+    ColorSpecification green(Color::green);
+    PlanFor(green, catalog)->Execute(catalog, nullptr).ForEach([&](uint32_t id) {
+        cout << catalog.products[id].name << " is green." << endl;
+    });
+
+    catalog.Remove(apple);
+    PlanFor(green, catalog)->Execute(catalog, nullptr).ForEach([&](uint32_t id) {
+        cout << catalog.products[id].name << " is still green after Apple was removed." << endl;
+    });
+
+    // Benchmark catalog
+    const size_t n = argc > 1 ? stoull(argv[1]) : 5'000'000;
+    mt19937 rng(7);
+    uniform_int_distribution<int> pick(0, 2);
+    uniform_int_distribution<int> letter('A', 'Z');
+    // Skewed sizes so the planner has something to choose between.
+    discrete_distribution<int> pick_size({ 70, 25, 5 });
+
+    Catalog big;
+    big.EnableIndex(Attribute::color);
+    big.EnableIndex(Attribute::size);
+    big.products.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        big.Add({ string(1, static_cast<char>(letter(rng))) + "-item", static_cast<Color>(pick(rng)), static_cast<Size>(pick_size(rng)) });
+    }
+    // Remove a few percent so the indexes have seen deletions too.
+    for (uint32_t id = 0; id < n; id += 37)
+    {
+        big.Remove(id);
+    }
+
+    vector<Product*> items;
+    big.live.ForEach([&](uint32_t id) { items.push_back(&big.products[id]); });
+
+    SizeSpecification large(Size::large);
+    SizeSpecification small(Size::small);
+    ColorSpecification red(Color::red);
+    ColorSpecification blue(Color::blue);
+    NotSpecification not_small(small);
+    OrSpecification red_or_blue(red, blue);
+    NamePrefixSpecification starts_with_a("A");
+    AndSpecification green_and_large(green, large);
+    AndSpecification green_not_small(green, not_small);
+    AndSpecification red_or_blue_large(red_or_blue, large);
+    AndSpecification large_named_a(large, starts_with_a);
+
+    struct Query { const char* label; ISpecification<Product>& spec; };
+    Query queries[] = {
+        { "green", green },
+        { "green AND large", green_and_large },
+        { "green AND NOT small", green_not_small },
+        { "(red OR blue) AND large", red_or_blue_large },
+        { "large AND name starts with A", large_named_a },
+        { "name starts with A", starts_with_a },
+    };
+
+    size_t index_bytes = 0;
+    for (auto* index : { big.color_index.get(), big.size_index.get() })
+    {
+        for (auto& b : index->by_value) index_bytes += b.BytesUsed();
+    }
+    cout << endl << big.Count() << " live products, indexes use " << index_bytes / 1024 << " KB" << endl;
+
+    BetterFilter bf;
+    for (auto& q : queries)
+    {
+        auto plan = PlanFor(q.spec, big);
+        RoaringBitmap result;
+        double planned_ms = Milliseconds([&] { plan = PlanFor(q.spec, big); result = plan->Execute(big, nullptr); });
+        vector<Product*> filtered;
+        double filter_ms = Milliseconds([&] { filtered = bf.Filter(items, q.spec); });
+
+        cout << endl << "Query: " << q.label << endl;
+        plan->Explain(cout, 0);
+        cout << "  actual " << fixed << setprecision(3) << 100.0 * result.Cardinality() / big.Count() << "%"
+             << (result.Cardinality() == filtered.size() ? "" : "  (MISMATCH with BetterFilter)") << endl;
+        cout << "  planner: " << setprecision(2) << planned_ms << " ms, BetterFilter: " << filter_ms << " ms" << endl;
+    }
+
+    return 0;
+}
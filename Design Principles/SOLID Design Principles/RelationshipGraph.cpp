@@ -0,0 +1,1412 @@
+// Relationship Graph Store
+
+// Builds on the Dependency Inversion example (DependencyInversion.cpp).
+// Relationships keeps every relation as a tuple<Person, Relationship, Person>, so each relation stores two full
+// copies of both names, and FinalAllChildrenOf compares a std::string against every tuple in the list.
+// Because Research only depends on the RelationshipBrowser abstraction, the low-level module can be replaced
+// without touching the high-level one. This file does exactly that.
+
+// Explanation of File:
+// RelationshipGraph is a second low-level module behind the same RelationshipBrowser interface.
+//  - NameTable interns every name once and hands out dense 32-bit ids.
+//  - Each relationship type has its own Adjacency in CSR form: offsets[id] .. offsets[id + 1] index into one
+//    flat array of neighbour ids, so an edge costs 4 bytes and a lookup touches only the neighbours it returns.
+//  - New edges go into a delta buffer (per-node lists threaded through one array). When the delta grows past a fraction of the CSR,
+//    the two are merged into a new CSR in one linear pass, so the amortized cost per added edge stays constant.
+// FinalAllChildrenOf is O(children). ForEachChildOf avoids even the Person copies.
+//
+// Multi-hop queries (descendants, common ancestors, everyone within k hops) are exposed through a second abstraction,
+// LineageBrowser, so high-level code never has to loop over FinalAllChildrenOf itself.
+// They run as a level-synchronous parallel BFS: the current frontier, the next frontier and the visited set are bitmaps,
+// and each level is split by bitmap word ranges across the caller and a process-wide set of helper threads, which are
+// started once and reused by every level of every traversal. Each level runs in one of two directions:
+//  - top-down:  every frontier vertex pushes to its unvisited neighbours (cheap while the frontier is small);
+//  - bottom-up: every unvisited vertex looks for any neighbour in the frontier and stops at the first one
+//               (cheap once the frontier is a large part of the graph).
+// The direction is switched per level from the edge counts of the frontier and of the unvisited part of the graph, and
+// from the number of unvisited vertices: a bottom-up level checks each of them at least once, so on sparse graphs such
+// as family trees (one or two parents per person) it never pays, and the traversal stays top-down. The example also
+// runs a dense pedigree (16 parents per person), where it switches to bottom-up and back.
+// TraversalOptions lets a caller cap the depth, give the query a visit budget or cancel it from another thread.
+//
+// Rebuilding a large graph edge by edge at startup is slow, so a compacted graph can be saved as a snapshot:
+// the name pool, the name hash table and the CSR arrays written out unchanged, behind a versioned, checksummed header.
+// RelationshipSnapshot maps such a file and answers FinalAllChildrenOf from it directly; opening costs one mmap
+// and a header check, and pages are read from disk only as queries touch them.
+
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include<vector>
+#include<fstream>
+#include <tuple>
+#include <string_view>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <bit>
+#include <memory>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <limits>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+enum class Relationship
+{
+    parent,
+    child,
+    sibling
+};
+
+struct Person
+{
+    string name;
+};
+
+struct RelationshipBrowser
+{
+    virtual vector<Person> FinalAllChildrenOf(const string& name) = 0;
+};
+
+struct LineageBrowser
+{
+    virtual vector<Person> FindAllDescendantsOf(const string& name) = 0;
+    virtual vector<Person> FindCommonAncestorsOf(const string& first, const string& second) = 0;
+    virtual vector<Person> FindEveryoneWithinHopsOf(const string& name, size_t hops) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Low-level module from DependencyInversion.cpp, kept as the baseline
+struct Relationships : RelationshipBrowser
+{
+    vector<tuple<Person, Relationship, Person>> relations;
+
+    void AddParentAndChild(const Person& parent, const Person& child)
+    {
+        relations.push_back({ parent, Relationship::parent, child });
+        relations.push_back({ child, Relationship::child, parent });
+    }
+
+    vector <Person> FinalAllChildrenOf(const string& name)
+    {
+        vector<Person> result;
+        for (auto&& [first, rel, second] : relations)
+        {
+            if (first.name == name && rel == Relationship::parent)
+            {
+                result.push_back(second);
+            }
+        }
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Names are hashed with a fixed function (FNV-1a plus a final mix) rather than std::hash, whose values may change
+// between library builds: a snapshot stores the lookup table as it is and probes it without rehashing.
+inline uint64_t HashName(string_view name) noexcept
+{
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : name) h = (h ^ c) * 1099511628211ull;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ (h >> 33);
+}
+
+// Read-only view of an interned name table. It can point into a NameTable or straight into a mapped snapshot.
+struct NameTableView
+{
+    static constexpr uint64_t empty = 0;
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    const char* chars = nullptr;
+    const uint32_t* offsets = nullptr;
+    const uint64_t* slots = nullptr;   // (hash >> 32) << 32 | (id + 1), or empty
+    size_t mask = 0;
+    uint32_t size = 0;
+    size_t chars_size = 0;
+
+    static uint32_t IdOf(uint64_t slot) noexcept { return static_cast<uint32_t>(slot) - 1; }
+
+    // `id` must be below size. Offsets outside the character pool (a damaged snapshot) give an empty name.
+    string_view Name(uint32_t id) const noexcept
+    {
+        const uint32_t begin = offsets[id], end = offsets[id + 1];
+        return begin <= end && end <= chars_size ? string_view(chars + begin, end - begin) : string_view();
+    }
+
+    static constexpr size_t no_slot = SIZE_MAX;
+
+    // The slot holding `name`, or the empty slot where it would go. Probes at most every slot once, and skips slots
+    // whose id is out of range, so a full or damaged table (from a snapshot file) yields no_slot instead of a hang
+    // or an out-of-bounds read.
+    size_t SlotOf(string_view name, uint64_t h) const
+    {
+        size_t i = h & mask;
+        for (size_t probes = 0; probes <= mask; ++probes, i = (i + 1) & mask)
+        {
+            if (slots[i] == empty) return i;
+            if ((slots[i] ^ h) >> 32 == 0 && IdOf(slots[i]) < size && Name(IdOf(slots[i])) == name) return i;
+        }
+        return no_slot;
+    }
+
+    uint32_t Find(string_view name) const
+    {
+        if (slots == nullptr) return npos;
+        size_t i = SlotOf(name, HashName(name));
+        return i == no_slot || slots[i] == empty ? npos : IdOf(slots[i]);
+    }
+};
+
+// Interned names: all characters in one pool, looked up through an open-addressing table of ids.
+// Each slot also keeps the upper half of the name's hash, so probing past other names rarely touches the pool.
+class NameTable
+{
+private:
+    static constexpr uint64_t empty = NameTableView::empty;
+
+    vector<char> chars;
+    vector<uint32_t> offsets{ 0 };
+    vector<uint64_t> slots;      // (hash >> 32) << 32 | (id + 1), or empty
+    size_t mask = 0;
+
+    static uint64_t Slot(uint64_t h, uint32_t id) noexcept { return (h >> 32 << 32) | (uint64_t{ id } + 1); }
+    static uint32_t IdOf(uint64_t slot) noexcept { return NameTableView::IdOf(slot); }
+
+    void Grow()
+    {
+        slots.assign(slots.empty() ? 1024 : slots.size() * 2, empty);
+        mask = slots.size() - 1;
+        for (uint32_t id = 0; id < Size(); ++id)
+        {
+            uint64_t h = HashName(Name(id));
+            size_t i = h & mask;
+            while (slots[i] != empty) i = (i + 1) & mask;
+            slots[i] = Slot(h, id);
+        }
+    }
+
+public:
+    static constexpr uint32_t npos = NameTableView::npos;
+
+    uint32_t Size() const noexcept { return static_cast<uint32_t>(offsets.size() - 1); }
+
+    NameTableView View() const noexcept
+    {
+        return { chars.data(), offsets.data(), slots.empty() ? nullptr : slots.data(), mask, Size(), chars.size() };
+    }
+
+    string_view Name(uint32_t id) const noexcept
+    {
+        return string_view(chars.data() + offsets[id], offsets[id + 1] - offsets[id]);
+    }
+
+    uint32_t Find(string_view name) const { return View().Find(name); }
+
+    uint32_t Intern(string_view name)
+    {
+        if ((Size() + 1) * 10 > slots.size() * 7) Grow();
+        uint64_t h = HashName(name);
+        size_t i = View().SlotOf(name, h);
+        if (slots[i] != empty) return IdOf(slots[i]);
+
+        uint32_t id = Size();
+        chars.insert(chars.end(), name.begin(), name.end());
+        offsets.push_back(static_cast<uint32_t>(chars.size()));
+        slots[i] = Slot(h, id);
+        return id;
+    }
+
+    void Reserve(size_t names, size_t total_chars)
+    {
+        chars.reserve(total_chars);
+        offsets.reserve(names + 1);
+        while ((names + 1) * 10 > slots.size() * 7) Grow();
+    }
+
+    const vector<char>& Chars() const noexcept { return chars; }
+    const vector<uint32_t>& Offsets() const noexcept { return offsets; }
+    const vector<uint64_t>& Slots() const noexcept { return slots; }
+
+    size_t BytesUsed() const noexcept
+    {
+        return chars.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(uint64_t);
+    }
+};
+
+// Adjacency for one relationship type: a compacted CSR plus a delta of edges added since the last compaction.
+// The delta is a set of per-node linked lists threaded through one array, so adding an edge never allocates per node.
+class Adjacency
+{
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct DeltaEdge
+    {
+        uint32_t to;
+        uint32_t next;   // previous delta edge of the same node, or none
+    };
+
+    vector<uint32_t> offsets{ 0 };
+    vector<uint32_t> targets;
+    vector<uint32_t> delta_head;   // newest delta edge per node, or none
+    vector<DeltaEdge> delta;
+
+public:
+    void Add(uint32_t from, uint32_t to)
+    {
+        if (from >= delta_head.size())
+        {
+            delta_head.resize(max<size_t>(size_t{ from } + 1, delta_head.size() * 2), none);
+        }
+        delta.push_back({ to, delta_head[from] });
+        delta_head[from] = static_cast<uint32_t>(delta.size() - 1);
+    }
+
+    // A compaction costs O(nodes + edges). Waiting until the delta is a quarter of that size
+    // keeps the amortized cost per added edge constant.
+    bool NeedsCompaction(uint32_t node_count) const noexcept
+    {
+        return delta.size() > max<size_t>(size_t{ 1 } << 16, (targets.size() + node_count) / 4);
+    }
+
+    void Compact(uint32_t node_count)
+    {
+        if (delta.empty() && (targets.empty() || offsets.size() == size_t{ node_count } + 1)) return;
+
+        auto old_degree = [&](uint32_t id) { return id + 1 < offsets.size() ? offsets[id + 1] - offsets[id] : 0; };
+        auto head = [&](uint32_t id) { return id < delta_head.size() ? delta_head[id] : none; };
+
+        vector<uint32_t> new_offsets(size_t{ node_count } + 1, 0);
+        for (uint32_t id = 0; id < node_count; ++id)
+        {
+            uint32_t degree = old_degree(id);
+            for (uint32_t e = head(id); e != none; e = delta[e].next) ++degree;
+            new_offsets[id + 1] = new_offsets[id] + degree;
+        }
+
+        vector<uint32_t> new_targets(new_offsets.back());
+        for (uint32_t id = 0; id < node_count; ++id)
+        {
+            uint32_t out = new_offsets[id];
+            if (id + 1 < offsets.size())
+            {
+                out = static_cast<uint32_t>(copy(targets.begin() + offsets[id], targets.begin() + offsets[id + 1], new_targets.begin() + out) - new_targets.begin());
+            }
+            // Delta lists run newest first; fill from the back to keep insertion order.
+            uint32_t back = new_offsets[id + 1];
+            for (uint32_t e = head(id); e != none; e = delta[e].next) new_targets[--back] = delta[e].to;
+        }
+
+        offsets = move(new_offsets);
+        targets = move(new_targets);
+        fill(delta_head.begin(), delta_head.end(), none);
+        delta.clear();
+    }
+
+    // Releases the delta buffers entirely; for a store that is done loading.
+    void ShrinkToFit()
+    {
+        vector<uint32_t>().swap(delta_head);
+        vector<DeltaEdge>().swap(delta);
+    }
+
+    template <typename F>
+    void ForEach(uint32_t from, F&& f) const
+    {
+        if (from + 1 < offsets.size())
+        {
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; ++i) f(targets[i]);
+        }
+        if (!delta.empty() && from < delta_head.size() && delta_head[from] != none)
+        {
+            // Rare path: collect the newest-first list so children come out in insertion order.
+            vector<uint32_t> recent;
+            for (uint32_t e = delta_head[from]; e != none; e = delta[e].next) recent.push_back(delta[e].to);
+            for (auto it = recent.rbegin(); it != recent.rend(); ++it) f(*it);
+        }
+    }
+
+    // Stops at the first neighbour for which pred returns true.
+    template <typename Pred>
+    bool AnyOf(uint32_t from, Pred&& pred) const
+    {
+        if (from + 1 < offsets.size())
+        {
+            for (uint32_t i = offsets[from]; i < offsets[from + 1]; ++i)
+            {
+                if (pred(targets[i])) return true;
+            }
+        }
+        if (!delta.empty() && from < delta_head.size())
+        {
+            for (uint32_t e = delta_head[from]; e != none; e = delta[e].next)
+            {
+                if (pred(delta[e].to)) return true;
+            }
+        }
+        return false;
+    }
+
+    size_t Degree(uint32_t from) const
+    {
+        size_t degree = from + 1 < offsets.size() ? offsets[from + 1] - offsets[from] : 0;
+        if (!delta.empty() && from < delta_head.size())
+        {
+            for (uint32_t e = delta_head[from]; e != none; e = delta[e].next) ++degree;
+        }
+        return degree;
+    }
+
+    size_t EdgeCount() const noexcept { return targets.size() + delta.size(); }
+
+    // The CSR arrays. offsets may be shorter than node_count + 1 when the last nodes have no edges.
+    bool IsCompact() const noexcept { return delta.empty(); }
+    const vector<uint32_t>& Offsets() const noexcept { return offsets; }
+    const vector<uint32_t>& Targets() const noexcept { return targets; }
+
+    size_t BytesUsed() const noexcept
+    {
+        return (offsets.capacity() + targets.capacity() + delta_head.capacity()) * sizeof(uint32_t)
+             + delta.capacity() * sizeof(DeltaEdge);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Traversal support
+
+// Fixed-size bitmap whose bits can be set from several threads.
+class AtomicBitmap
+{
+private:
+    vector<atomic<uint64_t>> words;
+
+public:
+    explicit AtomicBitmap(size_t bits) : words((bits + 63) / 64) {}
+
+    size_t WordCount() const noexcept { return words.size(); }
+    uint64_t Word(size_t w) const noexcept { return words[w].load(memory_order_relaxed); }
+
+    bool Test(uint32_t i) const noexcept { return (Word(i / 64) >> (i % 64)) & 1; }
+
+    // Returns true if this call changed the bit.
+    bool Set(uint32_t i) noexcept
+    {
+        uint64_t bit = uint64_t{ 1 } << (i % 64);
+        if (Word(i / 64) & bit) return false;
+        return !(words[i / 64].fetch_or(bit, memory_order_relaxed) & bit);
+    }
+
+    void Clear() noexcept
+    {
+        for (auto& w : words) w.store(0, memory_order_relaxed);
+    }
+
+    void Swap(AtomicBitmap& other) noexcept { words.swap(other.words); }
+};
+
+// Helper threads for ParallelForWords, started once and parked between jobs. A job runs on the caller plus some of
+// them; one traversal level is one job. If another traversal is using them, a job simply runs on the caller alone.
+class WordWorkers
+{
+private:
+    vector<thread> threads;
+    mutex busy;                            // held by the caller whose job the helpers are running
+    mutex m;
+    condition_variable wake, finished;
+    const function<void()>* job = nullptr;
+    uint64_t generation = 0;
+    unsigned wanted = 0;                   // helpers still to join the current job
+    unsigned active = 0;                   // helpers that have not finished it
+    bool stopping = false;
+
+    void Loop()
+    {
+        unique_lock<mutex> lock(m);
+        uint64_t seen = 0;
+        for (;;)
+        {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            if (wanted == 0) continue;
+            --wanted;
+            const function<void()>& work = *job;
+            lock.unlock();
+            work();
+            lock.lock();
+            if (--active == 0) finished.notify_one();
+        }
+    }
+
+public:
+    explicit WordWorkers(unsigned helpers)
+    {
+        for (unsigned i = 0; i < helpers; ++i) threads.emplace_back([this] { Loop(); });
+    }
+
+    ~WordWorkers()
+    {
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    WordWorkers(const WordWorkers&) = delete;
+    WordWorkers& operator=(const WordWorkers&) = delete;
+
+    // Runs `work` on the calling thread and on up to `helpers` helper threads, and returns once every copy has returned.
+    void Run(unsigned helpers, const function<void()>& work)
+    {
+        unique_lock<mutex> claim(busy, try_to_lock);
+        helpers = claim.owns_lock() ? min<unsigned>(helpers, static_cast<unsigned>(threads.size())) : 0;
+        if (helpers != 0)
+        {
+            {
+                lock_guard<mutex> lock(m);
+                job = &work;
+                wanted = active = helpers;
+                ++generation;
+            }
+            wake.notify_all();
+        }
+        work();
+        if (helpers != 0)
+        {
+            unique_lock<mutex> lock(m);
+            finished.wait(lock, [&] { return active == 0; });
+        }
+    }
+
+    static WordWorkers& Shared()
+    {
+        static WordWorkers workers(max(1u, thread::hardware_concurrency()) - 1);
+        return workers;
+    }
+};
+
+// Runs f(first_word, last_word) over [0, words) in blocks claimed dynamically by up to `threads` threads, including
+// the caller. Returning from this function is the level barrier of the BFS.
+template <typename F>
+void ParallelForWords(size_t words, unsigned threads, F&& f)
+{
+    const size_t block = 256;
+    atomic<size_t> next{ 0 };
+    const function<void()> work = [&] {
+        for (size_t begin = next.fetch_add(block); begin < words; begin = next.fetch_add(block))
+        {
+            f(begin, min(words, begin + block));
+        }
+    };
+    size_t blocks = (words + block - 1) / block;
+    size_t helpers = threads > 1 && blocks > 1 ? min<size_t>(threads, blocks) - 1 : 0;
+    if (helpers == 0) work();
+    else WordWorkers::Shared().Run(static_cast<unsigned>(helpers), work);
+}
+
+struct TraversalOptions
+{
+    size_t max_depth = SIZE_MAX;                // hops from the start vertices
+    size_t visit_budget = SIZE_MAX;             // stop once about this many vertices have been visited
+    const atomic<bool>* cancelled = nullptr;    // checked between blocks of work
+    bool direction_optimizing = true;           // false: always top-down
+    unsigned threads = max(1u, thread::hardware_concurrency());
+};
+
+enum class TraversalStatus { complete, cancelled, budget_exhausted };
+
+struct TraversalResult
+{
+    vector<uint32_t> ids;          // visited vertices in id order, not including the start vertices
+    TraversalStatus status = TraversalStatus::complete;
+    size_t levels = 0;
+    size_t bottom_up_levels = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Graph-backed low-level module
+struct RelationshipGraph : RelationshipBrowser, LineageBrowser
+{
+    NameTable names;
+    Adjacency edges[3];   // indexed by Relationship
+
+    Adjacency& EdgesOf(Relationship r) { return edges[static_cast<int>(r)]; }
+    const Adjacency& EdgesOf(Relationship r) const { return edges[static_cast<int>(r)]; }
+
+    void AddParentAndChild(const Person& parent, const Person& child)
+    {
+        uint32_t p = names.Intern(parent.name);
+        uint32_t c = names.Intern(child.name);
+        EdgesOf(Relationship::parent).Add(p, c);
+        EdgesOf(Relationship::child).Add(c, p);
+        for (auto& adjacency : edges)
+        {
+            if (adjacency.NeedsCompaction(names.Size())) adjacency.Compact(names.Size());
+        }
+    }
+
+    // Folds every delta buffer into its CSR and releases the buffers. Compaction also happens automatically
+    // as deltas grow; call this after a bulk load.
+    void Compact()
+    {
+        for (auto& adjacency : edges)
+        {
+            adjacency.Compact(names.Size());
+            adjacency.ShrinkToFit();
+        }
+    }
+
+    template <typename F>
+    void ForEachChildOf(string_view name, F&& f) const
+    {
+        uint32_t id = names.Find(name);
+        if (id == NameTable::npos) return;
+        EdgesOf(Relationship::parent).ForEach(id, [&](uint32_t child) { f(names.Name(child)); });
+    }
+
+    vector<Person> FinalAllChildrenOf(const string& name) override
+    {
+        vector<Person> result;
+        ForEachChildOf(name, [&](string_view child) { result.push_back(Person{ string(child) }); });
+        return result;
+    }
+
+    // Level-synchronous BFS from `sources`. `forward` holds the adjacencies followed top-down,
+    // `backward` the same edges seen from the other end, used to find a frontier parent bottom-up.
+    TraversalResult Traverse(const vector<uint32_t>& sources, const vector<const Adjacency*>& forward,
+                             const vector<const Adjacency*>& backward, const TraversalOptions& options) const
+    {
+        // Beamer et al.'s thresholds: go bottom-up when a growing frontier's edges exceed 1/alpha of the unexplored
+        // edges, go back top-down when a shrinking frontier falls below 1/beta of the vertices. Bottom-up additionally
+        // requires more frontier edges than unvisited vertices, since it visits every unvisited vertex; Beamer's alpha
+        // assumes most of them find a frontier parent after a few of many edges, which low-degree graphs do not give.
+        const size_t alpha = 14, beta = 24;
+
+        const uint32_t n = names.Size();
+        AtomicBitmap visited(n), frontier(n), next(n);
+        TraversalResult result;
+
+        auto degree = [&](uint32_t v) {
+            size_t d = 0;
+            for (auto* adjacency : forward) d += adjacency->Degree(v);
+            return d;
+        };
+
+        size_t frontier_size = 0, frontier_edges = 0, unexplored_edges = 0;
+        for (auto* adjacency : forward) unexplored_edges += adjacency->EdgeCount();
+        for (uint32_t s : sources)
+        {
+            if (visited.Set(s))
+            {
+                frontier.Set(s);
+                ++frontier_size;
+                frontier_edges += degree(s);
+            }
+        }
+        atomic<size_t> visited_count{ frontier_size };
+
+        auto stop_requested = [&] {
+            return (options.cancelled && options.cancelled->load(memory_order_relaxed))
+                || visited_count.load(memory_order_relaxed) >= options.visit_budget;
+        };
+
+        bool bottom_up = false;
+        size_t previous_size = 0;
+        while (frontier_size != 0 && result.levels < options.max_depth && !stop_requested())
+        {
+            if (options.direction_optimizing)
+            {
+                const bool growing = frontier_size > previous_size;
+                const size_t unvisited = n - visited_count.load(memory_order_relaxed);
+                if (!bottom_up && growing && frontier_edges > unexplored_edges / alpha && frontier_edges > unvisited) bottom_up = true;
+                else if (bottom_up && !growing && frontier_size < n / beta) bottom_up = false;
+            }
+            previous_size = frontier_size;
+            unexplored_edges -= min(unexplored_edges, frontier_edges);
+
+            atomic<size_t> next_size{ 0 }, next_edges{ 0 };
+            ParallelForWords(visited.WordCount(), options.threads, [&](size_t first, size_t last) {
+                if (stop_requested()) return;
+                size_t found = 0, found_edges = 0;
+                auto visit = [&](uint32_t u) {
+                    next.Set(u);
+                    ++found;
+                    found_edges += degree(u);
+                };
+                for (size_t w = first; w < last; ++w)
+                {
+                    if (!bottom_up)
+                    {
+                        for (uint64_t bits = frontier.Word(w); bits != 0; bits &= bits - 1)
+                        {
+                            uint32_t v = static_cast<uint32_t>(w * 64 + countr_zero(bits));
+                            for (auto* adjacency : forward)
+                            {
+                                adjacency->ForEach(v, [&](uint32_t u) {
+                                    if (visited.Set(u)) visit(u);
+                                });
+                            }
+                        }
+                    }
+                    else
+                    {
+                        uint64_t unvisited = ~visited.Word(w);
+                        if (w + 1 == visited.WordCount() && n % 64 != 0) unvisited &= (uint64_t{ 1 } << (n % 64)) - 1;
+                        for (; unvisited != 0; unvisited &= unvisited - 1)
+                        {
+                            uint32_t v = static_cast<uint32_t>(w * 64 + countr_zero(unvisited));
+                            bool reached = false;
+                            for (auto* adjacency : backward)
+                            {
+                                reached = reached || adjacency->AnyOf(v, [&](uint32_t u) { return frontier.Test(u); });
+                            }
+                            // This thread owns word w during a bottom-up level, so the Set cannot race.
+                            if (reached && visited.Set(v)) visit(v);
+                        }
+                    }
+                }
+                next_size.fetch_add(found, memory_order_relaxed);
+                next_edges.fetch_add(found_edges, memory_order_relaxed);
+                visited_count.fetch_add(found, memory_order_relaxed);
+            });
+
+            result.bottom_up_levels += bottom_up;
+            ++result.levels;
+            frontier.Swap(next);
+            next.Clear();
+            frontier_size = next_size.load();
+            frontier_edges = next_edges.load();
+        }
+
+        if (options.cancelled && options.cancelled->load()) result.status = TraversalStatus::cancelled;
+        else if (visited_count.load() >= options.visit_budget && frontier_size != 0) result.status = TraversalStatus::budget_exhausted;
+
+        for (size_t w = 0; w < visited.WordCount(); ++w)
+        {
+            for (uint64_t bits = visited.Word(w); bits != 0; bits &= bits - 1)
+            {
+                result.ids.push_back(static_cast<uint32_t>(w * 64 + countr_zero(bits)));
+            }
+        }
+        for (uint32_t s : sources)
+        {
+            auto it = lower_bound(result.ids.begin(), result.ids.end(), s);
+            if (it != result.ids.end() && *it == s) result.ids.erase(it);
+        }
+        return result;
+    }
+
+    TraversalResult Descendants(string_view name, const TraversalOptions& options = {}) const
+    {
+        uint32_t id = names.Find(name);
+        if (id == NameTable::npos) return {};
+        return Traverse({ id }, { &EdgesOf(Relationship::parent) }, { &EdgesOf(Relationship::child) }, options);
+    }
+
+    TraversalResult Ancestors(string_view name, const TraversalOptions& options = {}) const
+    {
+        uint32_t id = names.Find(name);
+        if (id == NameTable::npos) return {};
+        return Traverse({ id }, { &EdgesOf(Relationship::child) }, { &EdgesOf(Relationship::parent) }, options);
+    }
+
+    TraversalResult CommonAncestors(string_view first, string_view second, const TraversalOptions& options = {}) const
+    {
+        TraversalResult a = Ancestors(first, options);
+        TraversalResult b = Ancestors(second, options);
+        TraversalResult result;
+        set_intersection(a.ids.begin(), a.ids.end(), b.ids.begin(), b.ids.end(), back_inserter(result.ids));
+        result.status = a.status != TraversalStatus::complete ? a.status : b.status;
+        result.levels = max(a.levels, b.levels);
+        result.bottom_up_levels = a.bottom_up_levels + b.bottom_up_levels;
+        return result;
+    }
+
+    // Relationships are followed in both directions, so this includes parents, children, siblings, cousins, ...
+    TraversalResult WithinHops(string_view name, size_t hops, TraversalOptions options = {}) const
+    {
+        uint32_t id = names.Find(name);
+        if (id == NameTable::npos) return {};
+        options.max_depth = min(options.max_depth, hops);
+        vector<const Adjacency*> both{ &EdgesOf(Relationship::parent), &EdgesOf(Relationship::child) };
+        return Traverse({ id }, both, both, options);
+    }
+
+    vector<Person> ToPeople(const TraversalResult& result) const
+    {
+        vector<Person> people;
+        people.reserve(result.ids.size());
+        for (uint32_t id : result.ids) people.push_back(Person{ string(names.Name(id)) });
+        return people;
+    }
+
+    vector<Person> FindAllDescendantsOf(const string& name) override { return ToPeople(Descendants(name)); }
+
+    vector<Person> FindCommonAncestorsOf(const string& first, const string& second) override
+    {
+        return ToPeople(CommonAncestors(first, second));
+    }
+
+    vector<Person> FindEveryoneWithinHopsOf(const string& name, size_t hops) override
+    {
+        return ToPeople(WithinHops(name, hops));
+    }
+
+    size_t BytesUsed() const noexcept
+    {
+        size_t bytes = names.BytesUsed();
+        for (auto& adjacency : edges) bytes += adjacency.BytesUsed();
+        return bytes;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Snapshots
+//
+// A snapshot is the RelationshipGraph's arrays written out as they are, so loading one is a single mmap:
+//
+//   SnapshotHeader (64-byte aligned, fixed size)
+//   name offsets      uint32[names + 1]
+//   name characters   char[offsets[names]]
+//   name slots        uint64[slot_count]           the NameTable's hash table, probed in place
+//   per relationship: CSR offsets uint32[names + 1], CSR targets uint32[edges]
+//
+// Every section starts on a 64-byte boundary. The header has its own CRC and is always checked on open,
+// together with the section bounds; the CRC of everything after the header costs one pass over the file,
+// so it is checked only when asked for (Verify).
+
+// CRC-32 (IEEE), slicing-by-8.
+class Crc32
+{
+private:
+    static const array<array<uint32_t, 256>, 8>& Tables()
+    {
+        static const auto tables = [] {
+            array<array<uint32_t, 256>, 8> t{};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+                t[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                for (int k = 1; k < 8; ++k) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    uint32_t crc = 0xFFFFFFFFu;
+
+public:
+    void Update(const void* data, size_t size) noexcept
+    {
+        auto& t = Tables();
+        auto* p = static_cast<const unsigned char*>(data);
+        for (; size >= 8; p += 8, size -= 8)
+        {
+            uint32_t lo, hi;
+            memcpy(&lo, p, 4);
+            memcpy(&hi, p + 4, 4);
+            lo ^= crc;
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+                ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        }
+        for (; size != 0; ++p, --size) crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+    }
+
+    uint32_t Value() const noexcept { return ~crc; }
+
+    static uint32_t Of(const void* data, size_t size) noexcept
+    {
+        Crc32 c;
+        c.Update(data, size);
+        return c.Value();
+    }
+};
+
+struct SnapshotSection
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct alignas(64) SnapshotHeader
+{
+    static constexpr char expected_magic[8] = { 'R', 'E', 'L', 'S', 'N', 'A', 'P', '\0' };
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t native_byte_order = 0x01020304;
+    static constexpr size_t alignment = 64;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // written as native_byte_order; reads back differently on the other endianness
+    uint64_t file_size;
+    uint32_t name_count;
+    uint32_t relationship_count;
+    uint64_t slot_count;        // power of two, or 0 for a graph without names
+    SnapshotSection name_offsets;
+    SnapshotSection name_chars;
+    SnapshotSection name_slots;
+    SnapshotSection adjacency_offsets[3];
+    SnapshotSection adjacency_targets[3];
+    uint32_t payload_crc;       // everything after the header
+    uint32_t header_crc;        // this header with header_crc = 0
+};
+
+// Writes a graph as a snapshot. The graph must be compacted first.
+void SaveSnapshot(const RelationshipGraph& graph, const string& path)
+{
+    for (auto& adjacency : graph.edges)
+    {
+        if (!adjacency.IsCompact()) throw logic_error("SaveSnapshot: compact the graph before saving it");
+    }
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) throw runtime_error("SaveSnapshot: cannot create " + path);
+
+    SnapshotHeader header{};
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);   // placeholder, rewritten at the end
+
+    Crc32 payload;
+    uint64_t position = sizeof header;
+    auto write = [&](const void* data, uint64_t size) {
+        out.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+        payload.Update(data, size);
+        position += size;
+    };
+    auto section = [&](const void* data, uint64_t size) {
+        static const char zeros[SnapshotHeader::alignment] = {};
+        write(zeros, (SnapshotHeader::alignment - position % SnapshotHeader::alignment) % SnapshotHeader::alignment);
+        SnapshotSection s{ position, size };
+        write(data, size);
+        return s;
+    };
+
+    const NameTable& names = graph.names;
+    const uint32_t n = names.Size();
+    header.name_offsets = section(names.Offsets().data(), names.Offsets().size() * sizeof(uint32_t));
+    header.name_chars = section(names.Chars().data(), names.Chars().size());
+    header.name_slots = section(names.Slots().data(), names.Slots().size() * sizeof(uint64_t));
+
+    for (int r = 0; r < 3; ++r)
+    {
+        // Adjacency omits trailing nodes without edges; the snapshot always has an offset per node.
+        vector<uint32_t> offsets = graph.edges[r].Offsets();
+        offsets.resize(size_t{ n } + 1, offsets.back());
+        auto& targets = graph.edges[r].Targets();
+        header.adjacency_offsets[r] = section(offsets.data(), offsets.size() * sizeof(uint32_t));
+        header.adjacency_targets[r] = section(targets.data(), targets.size() * sizeof(uint32_t));
+    }
+
+    memcpy(header.magic, SnapshotHeader::expected_magic, sizeof header.magic);
+    header.version = SnapshotHeader::current_version;
+    header.byte_order = SnapshotHeader::native_byte_order;
+    header.file_size = position;
+    header.name_count = n;
+    header.relationship_count = 3;
+    header.slot_count = names.Slots().size();
+    header.payload_crc = payload.Value();
+    header.header_crc = Crc32::Of(&header, sizeof header);
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    if (!out.flush()) throw runtime_error("SaveSnapshot: write to " + path + " failed");
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const string& path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER length{};
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length)) throw runtime_error("MappedFile: cannot open " + path);
+        size = static_cast<size_t>(length.QuadPart);
+        if (size == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (data == nullptr) throw runtime_error("MappedFile: cannot map " + path);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st {};
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            if (fd >= 0) close(fd);
+            throw runtime_error("MappedFile: cannot open " + path);
+        }
+        size = static_cast<size_t>(st.st_size);
+        if (size != 0)
+        {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                close(fd);
+                throw runtime_error("MappedFile: cannot map " + path);
+            }
+            data = static_cast<const char*>(p);
+        }
+        close(fd);   // the mapping keeps the file alive
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) munmap(const_cast<char*>(data), size);
+#endif
+    }
+
+    const char* Data() const noexcept { return data; }
+    size_t Size() const noexcept { return size; }
+};
+
+// Snapshot-backed low-level module: answers queries straight from the mapped file.
+// Opening one checks the header and section bounds and does nothing else; no record is parsed or copied.
+class RelationshipSnapshot : public RelationshipBrowser
+{
+private:
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    NameTableView names;
+    const uint32_t* offsets[3] = {};
+    const uint32_t* targets[3] = {};
+    uint64_t target_count[3] = {};
+
+    template <typename T>
+    const T* SectionData(const SnapshotSection& s, uint64_t expected_size) const
+    {
+        if (s.offset % SnapshotHeader::alignment != 0 || s.size != expected_size
+            || s.offset < sizeof(SnapshotHeader) || s.offset > file.Size() || s.size > file.Size() - s.offset)
+        {
+            throw runtime_error("RelationshipSnapshot: section out of bounds");
+        }
+        return reinterpret_cast<const T*>(file.Data() + s.offset);
+    }
+
+public:
+    explicit RelationshipSnapshot(const string& path) : file(path)
+    {
+        if (file.Size() < sizeof(SnapshotHeader)) throw runtime_error("RelationshipSnapshot: " + path + " is too short");
+        header = reinterpret_cast<const SnapshotHeader*>(file.Data());
+
+        SnapshotHeader copy = *header;
+        copy.header_crc = 0;
+        if (memcmp(header->magic, SnapshotHeader::expected_magic, sizeof header->magic) != 0)
+            throw runtime_error("RelationshipSnapshot: " + path + " is not a snapshot");
+        if (header->byte_order != SnapshotHeader::native_byte_order)
+            throw runtime_error("RelationshipSnapshot: " + path + " was written on a machine of the other endianness");
+        if (header->version != SnapshotHeader::current_version)
+            throw runtime_error("RelationshipSnapshot: unsupported version " + to_string(header->version));
+        if (Crc32::Of(&copy, sizeof copy) != header->header_crc || header->file_size != file.Size())
+            throw runtime_error("RelationshipSnapshot: " + path + " is damaged or truncated");
+        if (header->relationship_count != 3 || (header->slot_count & (header->slot_count - 1)) != 0)
+            throw runtime_error("RelationshipSnapshot: malformed header");
+
+        // A graph without names has no slot table; names.slots stays null and every Find misses.
+        const uint64_t n = header->name_count;
+        names.offsets = SectionData<uint32_t>(header->name_offsets, (n + 1) * sizeof(uint32_t));
+        names.chars = SectionData<char>(header->name_chars, header->name_chars.size);
+        names.chars_size = header->name_chars.size;
+        if (header->slot_count != 0)
+        {
+            names.slots = SectionData<uint64_t>(header->name_slots, header->slot_count * sizeof(uint64_t));
+            names.mask = header->slot_count - 1;
+        }
+        names.size = header->name_count;
+        if (names.offsets[n] != names.chars_size) throw runtime_error("RelationshipSnapshot: malformed name table");
+        for (int r = 0; r < 3; ++r)
+        {
+            offsets[r] = SectionData<uint32_t>(header->adjacency_offsets[r], (n + 1) * sizeof(uint32_t));
+            targets[r] = SectionData<uint32_t>(header->adjacency_targets[r], header->adjacency_targets[r].size);
+            target_count[r] = header->adjacency_targets[r].size / sizeof(uint32_t);
+        }
+    }
+
+    // Checks the payload CRC. Without it a damaged file can return wrong answers; queries still never read out of bounds.
+    bool Verify() const
+    {
+        return Crc32::Of(file.Data() + sizeof(SnapshotHeader), file.Size() - sizeof(SnapshotHeader)) == header->payload_crc;
+    }
+
+    uint32_t Size() const noexcept { return names.size; }
+    size_t FileSize() const noexcept { return file.Size(); }
+
+    template <typename F>
+    void ForEachChildOf(string_view name, F&& f) const
+    {
+        uint32_t id = names.Find(name);
+        if (id == NameTableView::npos) return;
+        const int r = static_cast<int>(Relationship::parent);
+        const uint32_t begin = offsets[r][id], end = offsets[r][id + 1];
+        if (begin > end || end > target_count[r]) throw runtime_error("RelationshipSnapshot: damaged adjacency for " + string(name));
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const uint32_t child = targets[r][i];
+            if (child >= names.size) throw runtime_error("RelationshipSnapshot: damaged adjacency for " + string(name));
+            f(names.Name(child));
+        }
+    }
+
+    vector<Person> FinalAllChildrenOf(const string& name) override
+    {
+        vector<Person> result;
+        ForEachChildOf(name, [&](string_view child) { result.push_back(Person{ string(child) }); });
+        return result;
+    }
+};
+
+// Evicts a file from the page cache so the next mapping of it starts cold. Returns false where that is not possible.
+bool DropFromPageCache(const string& path)
+{
+#if defined(_WIN32)
+    (void)path;
+    return false;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool dropped = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#endif
+}
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// High-level Module: unchanged from DependencyInversion.cpp, works with either low-level module.
+struct Research //high-level module
+{
+    Research(RelationshipBrowser& browser)
+    {
+        for (auto& child : browser.FinalAllChildrenOf("John"))
+        {
+            cout << "John has a child called " << child.name << endl;
+        }
+    }
+};
+
+// Another high-level module, depending only on the LineageBrowser abstraction.
+struct FamilyTree
+{
+    FamilyTree(LineageBrowser& browser)
+    {
+        for (auto& p : browser.FindAllDescendantsOf("Anna"))
+        {
+            cout << "Anna is an ancestor of " << p.name << endl;
+        }
+        for (auto& p : browser.FindCommonAncestorsOf("Chris", "Sara"))
+        {
+            cout << "Chris and Sara share the ancestor " << p.name << endl;
+        }
+        for (auto& p : browser.FindEveryoneWithinHopsOf("Matt", 2))
+        {
+            cout << p.name << " is within two relations of Matt" << endl;
+        }
+    }
+};
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+using Clock = chrono::steady_clock;
+
+double MillisecondsSince(Clock::time_point begin)
+{
+    return chrono::duration<double, milli>(Clock::now() - begin).count();
+}
+
+// One random family tree of `people` people: everyone except Person0 has one parent with a smaller index.
+vector<pair<uint32_t, uint32_t>> RandomFamilies(uint32_t people)
+{
+    mt19937 rng(11);
+    vector<pair<uint32_t, uint32_t>> links;
+    links.reserve(people);
+    for (uint32_t child = 1; child < people; ++child)
+    {
+        links.push_back({ uniform_int_distribution<uint32_t>(0, child - 1)(rng), child });
+    }
+    return links;
+}
+
+// A dense pedigree: everyone from Person<parents> on has `parents` random parents with smaller indices.
+// Person0's descendants take in most of it within a few levels, which is where bottom-up pays.
+vector<pair<uint32_t, uint32_t>> RandomClans(uint32_t people, uint32_t parents)
+{
+    mt19937 rng(13);
+    vector<pair<uint32_t, uint32_t>> links;
+    links.reserve(size_t{ people } * parents);
+    for (uint32_t child = parents; child < people; ++child)
+    {
+        for (uint32_t k = 0; k < parents; ++k) links.push_back({ uniform_int_distribution<uint32_t>(0, child - 1)(rng), child });
+    }
+    return links;
+}
+
+string NameOf(uint32_t i) { return "Person" + to_string(i); }
+
+int main(int argc, char* argv[])
+{
+    Person parent{ "John" };
+    Person child1{ "Chris" };
+    Person child2{ "Matt" };
+
+    RelationshipGraph graph;
+    graph.AddParentAndChild(parent, child1);
+    graph.AddParentAndChild(parent, child2);
+
+    Research _(graph);
+
+    Person grandparent{ "Anna" };
+    Person cousin{ "Sara" };
+    Person aunt{ "Lucy" };
+    graph.AddParentAndChild(grandparent, parent);
+    graph.AddParentAndChild(grandparent, aunt);
+    graph.AddParentAndChild(aunt, cousin);
+    FamilyTree __(graph);
+
+    // Benchmark
+    const uint32_t people = argc > 1 ? static_cast<uint32_t>(stoul(argv[1])) : 10'000'000;
+    const uint32_t baseline_people = min<uint32_t>(people, 1'000'000);
+    const int queries = 1000;
+
+    auto links = RandomFamilies(people);
+
+    RelationshipGraph big;
+    big.names.Reserve(people, size_t{ people } * 14);
+    auto t = Clock::now();
+    for (auto [p, c] : links)
+    {
+        big.AddParentAndChild(Person{ NameOf(p) }, Person{ NameOf(c) });
+    }
+    big.Compact();
+    double build_ms = MillisecondsSince(t);
+
+    mt19937 rng(5);
+    vector<string> probes;
+    for (int i = 0; i < queries; ++i)
+    {
+        probes.push_back(NameOf(uniform_int_distribution<uint32_t>(0, baseline_people - 1)(rng)));
+    }
+
+    size_t found = 0;
+    t = Clock::now();
+    for (auto& name : probes) found += big.FinalAllChildrenOf(name).size();
+    double graph_query_us = MillisecondsSince(t) * 1000 / queries;
+
+    size_t edges = big.EdgesOf(Relationship::parent).EdgeCount() + big.EdgesOf(Relationship::child).EdgeCount();
+    size_t edge_bytes = big.BytesUsed() - big.names.BytesUsed();
+
+    cout << endl << "RelationshipGraph, " << big.names.Size() << " people, " << edges << " directed edges:" << endl;
+    cout << "  build:  " << build_ms << " ms" << endl;
+    cout << "  memory: " << big.BytesUsed() / (1024 * 1024) << " MB total, "
+         << double(edge_bytes) / edges << " bytes per edge (incl. offsets)" << endl;
+    cout << "  FinalAllChildrenOf: " << graph_query_us << " us/query (" << found << " children over " << queries << " queries)" << endl;
+
+    // The tuple-based baseline scans everything, so it is measured on a smaller population.
+    Relationships baseline;
+    for (auto [p, c] : links)
+    {
+        if (c >= baseline_people) break;
+        baseline.AddParentAndChild(Person{ NameOf(p) }, Person{ NameOf(c) });
+    }
+    const int baseline_queries = 20;
+    size_t baseline_found = 0, graph_found = 0;
+    t = Clock::now();
+    for (int i = 0; i < baseline_queries; ++i) baseline_found += baseline.FinalAllChildrenOf(probes[i]).size();
+    double baseline_query_us = MillisecondsSince(t) * 1000 / baseline_queries;
+    for (int i = 0; i < baseline_queries; ++i)
+    {
+        big.ForEachChildOf(probes[i], [&](string_view child) {
+            uint32_t id = static_cast<uint32_t>(stoul(string(child.substr(6))));
+            graph_found += id < baseline_people;
+        });
+    }
+
+    cout << "Relationships (tuples), " << baseline_people << " people:" << endl;
+    cout << "  FinalAllChildrenOf: " << baseline_query_us << " us/query"
+         << (baseline_found == graph_found ? " (same children as the graph)" : " (MISMATCH)") << endl;
+
+
+    // Multi-hop queries on the large graph
+    auto report = [](const char* label, const TraversalResult& r, double ms) {
+        static const char* status[] = { "complete", "cancelled", "budget exhausted" };
+        cout << "  " << label << ": " << r.ids.size() << " people, " << r.levels << " levels ("
+             << r.bottom_up_levels << " bottom-up), " << ms << " ms, " << status[static_cast<int>(r.status)] << endl;
+    };
+
+    cout << endl << "Traversals (" << TraversalOptions{}.threads << " threads):" << endl;
+    TraversalOptions top_down_only;
+    top_down_only.direction_optimizing = false;
+
+    // The two full traversals alternate and each reports its best of three runs, so neither pays for running first.
+    TraversalResult all_top_down, all_optimized;
+    double top_down_ms = numeric_limits<double>::max(), optimized_ms = numeric_limits<double>::max();
+    for (int run = 0; run < 3; ++run)
+    {
+        t = Clock::now();
+        all_top_down = big.Descendants(NameOf(0), top_down_only);
+        top_down_ms = min(top_down_ms, MillisecondsSince(t));
+        t = Clock::now();
+        all_optimized = big.Descendants(NameOf(0));
+        optimized_ms = min(optimized_ms, MillisecondsSince(t));
+    }
+    report("descendants of Person0, top-down only      ", all_top_down, top_down_ms);
+    report("descendants of Person0, direction-optimizing", all_optimized, optimized_ms);
+    if (all_top_down.ids != all_optimized.ids) cout << "  MISMATCH between directions" << endl;
+
+    // The family trees above are too sparse for bottom-up to pay. A pedigree with many parents per person is not.
+    // Below its youngest member hangs a line of only children, where the frontier is one person per level, so the
+    // traversal has to switch to bottom-up and back again, and still find the same people as top-down.
+    const uint32_t clan_people = min<uint32_t>(people, 200'000), clan_parents = 16, line = 30;
+    auto clan_links = RandomClans(clan_people, clan_parents);
+    for (uint32_t c = clan_people; c < clan_people + line; ++c) clan_links.push_back({ c - 1, c });
+    RelationshipGraph clans;
+    for (auto [p, c] : clan_links) clans.AddParentAndChild(Person{ NameOf(p) }, Person{ NameOf(c) });
+    clans.Compact();
+    TraversalResult clan_top_down, clan_optimized;
+    double clan_top_down_ms = numeric_limits<double>::max(), clan_optimized_ms = numeric_limits<double>::max();
+    for (int run = 0; run < 3; ++run)
+    {
+        t = Clock::now();
+        clan_top_down = clans.Descendants(NameOf(0), top_down_only);
+        clan_top_down_ms = min(clan_top_down_ms, MillisecondsSince(t));
+        t = Clock::now();
+        clan_optimized = clans.Descendants(NameOf(0));
+        clan_optimized_ms = min(clan_optimized_ms, MillisecondsSince(t));
+    }
+    cout << "  (pedigree of " << clan_people << " people with " << clan_parents << " parents each, then a line of " << line << ")" << endl;
+    report("descendants of Person0, top-down only      ", clan_top_down, clan_top_down_ms);
+    report("descendants of Person0, direction-optimizing", clan_optimized, clan_optimized_ms);
+    if (clan_top_down.ids != clan_optimized.ids) cout << "  MISMATCH between directions" << endl;
+    // Staying bottom-up down the line would make most levels bottom-up.
+    if (clan_optimized.bottom_up_levels == 0 || clan_optimized.bottom_up_levels > clan_optimized.levels / 2)
+    {
+        cerr << "  direction-optimizing traversal did not switch to bottom-up and back on the pedigree" << endl;
+        return 1;
+    }
+
+    string deep_a = NameOf(people - 1), deep_b = NameOf(people - 2);
+    t = Clock::now();
+    auto common = big.CommonAncestors(deep_a, deep_b);
+    report(("common ancestors of " + deep_a + " and " + deep_b).c_str(), common, MillisecondsSince(t));
+
+    t = Clock::now();
+    auto near = big.WithinHops(NameOf(1), 3);
+    report("everyone within 3 hops of Person1          ", near, MillisecondsSince(t));
+
+    TraversalOptions budgeted;
+    budgeted.visit_budget = 100'000;
+    t = Clock::now();
+    auto partial = big.Descendants(NameOf(0), budgeted);
+    report("descendants of Person0, budget 100000      ", partial, MillisecondsSince(t));
+
+    atomic<bool> cancel{ false };
+    TraversalOptions cancellable;
+    cancellable.cancelled = &cancel;
+    thread canceller([&] {
+        this_thread::sleep_for(chrono::milliseconds(5));
+        cancel = true;
+    });
+    t = Clock::now();
+    auto cancelled = big.WithinHops(NameOf(0), SIZE_MAX, cancellable);
+    canceller.join();
+    report("everyone reachable from Person0, cancelled ", cancelled, MillisecondsSince(t));
+
+
+    // Snapshots: save the large graph once, then compare opening it against rebuilding it
+    string path = (filesystem::temp_directory_path() / "relationships.snapshot").string();
+    t = Clock::now();
+    SaveSnapshot(big, path);
+    double save_ms = MillisecondsSince(t);
+
+    auto open_and_query = [&](double& open_ms, double& first_query_ms) {
+        auto begin = Clock::now();
+        auto snapshot = make_unique<RelationshipSnapshot>(path);
+        open_ms = MillisecondsSince(begin);
+        begin = Clock::now();
+        snapshot->FinalAllChildrenOf(probes[0]);
+        first_query_ms = MillisecondsSince(begin);
+        return snapshot;
+    };
+    auto query_all = [&](RelationshipSnapshot& snapshot, size_t& children) {
+        auto begin = Clock::now();
+        for (auto& name : probes) children += snapshot.FinalAllChildrenOf(name).size();
+        return MillisecondsSince(begin) * 1000 / queries;
+    };
+
+    bool cold = DropFromPageCache(path);
+    double cold_open_ms, cold_first_ms, warm_open_ms, warm_first_ms;
+    size_t cold_found = 0, warm_found = 0;
+    auto cold_snapshot = open_and_query(cold_open_ms, cold_first_ms);
+    double cold_query_us = query_all(*cold_snapshot, cold_found);
+    cold_snapshot.reset();
+
+    auto snapshot = open_and_query(warm_open_ms, warm_first_ms);
+    double warm_query_us = query_all(*snapshot, warm_found);
+
+    t = Clock::now();
+    bool intact = snapshot->Verify();
+    double verify_ms = MillisecondsSince(t);
+
+    cout << endl << "Snapshot of " << snapshot->Size() << " people, " << snapshot->FileSize() / (1024 * 1024) << " MB:" << endl;
+    cout << "  save:    " << save_ms << " ms" << endl;
+    cout << "  rebuild: " << build_ms << " ms (AddParentAndChild for every link, as above)" << endl;
+    cout << "  " << (cold ? "cold" : "first") << " start: open " << cold_open_ms << " ms + first query " << cold_first_ms
+         << " ms, then " << cold_query_us << " us/query" << (cold ? "" : " (could not drop the page cache)") << endl;
+    cout << "  warm start: open " << warm_open_ms << " ms + first query " << warm_first_ms
+         << " ms, then " << warm_query_us << " us/query" << endl;
+    cout << "  checksum:   " << (intact ? "ok" : "MISMATCH") << ", verified in " << verify_ms << " ms" << endl;
+    cout << "  answers:    " << (cold_found == found && warm_found == found ? "same children as the graph" : "MISMATCH") << endl;
+
+    snapshot.reset();
+
+    // An empty graph round-trips as well; its snapshot has no name slots
+    {
+        RelationshipGraph empty;
+        SaveSnapshot(empty, path);
+        RelationshipSnapshot reopened(path);
+        cout << "  empty graph: " << (reopened.Size() == 0 && reopened.FinalAllChildrenOf("John").empty() ? "saved and reopened" : "MISMATCH") << endl;
+    }
+    filesystem::remove(path);
+
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include<vector>
 #include<fstream>
 
+#include "../../Common/Tracing.h"
+
 using namespace std;
 
 struct Journal
@@ -30,6 +32,8 @@ struct PersistenceManager
 {
     static void Save(const Journal& j, const string& filename)
     {
+        TRACE_SCOPE("PersistenceManager::Save");
+        TRACE_COUNTER("PersistenceManager::Save entries", j.entries.size());
         ofstream ofs(filename);
         for (auto& e : j.entries)
         {
@@ -42,6 +46,8 @@ struct PersistenceManager
 
 int main()
 {
+    tracing::Session trace_session;
+
     Journal journal("My Journal");
     journal.AddEntry("I ate a bug.");
     journal.AddEntry("I cried today.");
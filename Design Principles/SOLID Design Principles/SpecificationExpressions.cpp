@@ -0,0 +1,751 @@
+// Fused Specification Expressions
+
+// Builds on the Open/Closed example (openClosedPrinciple.cpp).
+// ISpecification<T>::IsSatisfied is virtual, so a query composed from And/Or/Not specifications is a tree of virtual
+// calls: every item pays one indirect call per node it visits, and the compiler cannot inline or simplify across them.
+
+// Explanation of File:
+// Specifications are written as ordinary C++ expressions over field placeholders:
+//     (color == Color::green && size != Size::small) || name_contains("oak")
+// Each operator builds a small value type (Compare, And, Or, Not) instead of evaluating anything, so the whole query
+// is one type known at compile time. Its operator() is inlined into the filter loop, and && and || still short-circuit.
+//
+// Reordering hints: every expression type has a compile-time `cost`. Comparisons cost 1, name_contains costs 16,
+// And/Or add up their children. Because specifications have no side effects, And and Or evaluate the cheaper child
+// first, so the expensive one runs only on the items the cheap one could not decide.
+// with_cost<N>(expr) overrides an expression's cost. A predicate that rejects almost everything can be given a low
+// cost so it runs first, even if it is not the cheapest.
+//
+// AnySpecification is the type-erased form, for queries that are only known at run time (QueryParser builds one from
+// text). It also implements ISpecification<Product>, so it plugs into BetterFilter unchanged. Evaluating it one item at a
+// time costs a virtual call per node like the original. Its own Filter evaluates in blocks of 1024 items instead, passing a
+// selection vector (the indices still in play) from node to node:
+//  - And runs its second child only on what its first child selected.
+//  - Or runs its second child only on what its first child rejected.
+// So there is one virtual call per node per block, not per item. An AnySpecification wrapping a fused expression runs
+// that expression's inlined loop over the whole block.
+//
+// main() compares nested virtual specifications, fused expressions and both AnySpecification paths on a large catalog.
+
+
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include<vector>
+#include <span>
+#include <memory>
+#include <functional>
+#include <concepts>
+#include <type_traits>
+#include <stdexcept>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+enum class Color { red, green, blue };
+enum class Size { small, medium, large };
+
+struct Product
+{
+    string name;
+    Color color;
+    Size size;
+};
+
+template <typename T>
+struct ISpecification
+{
+    virtual bool IsSatisfied(T* item) = 0;
+};
+
+template <typename T>
+struct IFilter
+{
+    virtual vector<T*> Filter(vector<T*> items, ISpecification<T>& spec) = 0;
+};
+
+struct BetterFilter : IFilter<Product>
+{
+    vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec) override
+    {
+        vector<Product*> result;
+        for (auto& item : items)
+        {
+            if (spec.IsSatisfied(item))
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+struct ColorSpecification : ISpecification<Product>
+{
+    Color color;
+    ColorSpecification(Color color) : color(color) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->color == color;
+    }
+};
+
+struct SizeSpecification : ISpecification<Product>
+{
+    Size size;
+    SizeSpecification(Size size) : size(size) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->size == size;
+    }
+};
+
+struct NameContainsSpecification : ISpecification<Product>
+{
+    string needle;
+    NameContainsSpecification(string needle) : needle(move(needle)) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return item->name.find(needle) != string::npos;
+    }
+};
+
+struct AndSpecification : ISpecification<Product>
+{
+    ISpecification<Product>& first;
+    ISpecification<Product>& second;
+    AndSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return first.IsSatisfied(item) && second.IsSatisfied(item);
+    }
+};
+
+struct OrSpecification : ISpecification<Product>
+{
+    ISpecification<Product>& first;
+    ISpecification<Product>& second;
+    OrSpecification(ISpecification<Product>& first, ISpecification<Product>& second) : first(first), second(second) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return first.IsSatisfied(item) || second.IsSatisfied(item);
+    }
+};
+
+struct NotSpecification : ISpecification<Product>
+{
+    ISpecification<Product>& spec;
+    NotSpecification(ISpecification<Product>& spec) : spec(spec) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return !spec.IsSatisfied(item);
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Expression templates
+
+// Every expression node derives from Expression<itself>; the operators below only accept such types.
+template <typename E>
+struct Expression {};
+
+template <typename E>
+concept SpecExpression = derived_from<E, Expression<E>> && requires(const E& e, const Product& item)
+{
+    { e(item) } -> convertible_to<bool>;
+    { E::cost } -> convertible_to<unsigned>;
+};
+
+template <auto Member, typename Op, unsigned Cost>
+struct Compare : Expression<Compare<Member, Op, Cost>>
+{
+    using Value = remove_cvref_t<decltype(declval<const Product&>().*Member)>;
+    static constexpr unsigned cost = Cost;
+
+    Value value;
+    constexpr explicit Compare(Value value) : value(value) {}
+
+    bool operator()(const Product& item) const
+    {
+        return Op{}(item.*Member, value);
+    }
+};
+
+// A placeholder for one Product field; comparing it with a value makes a Compare expression.
+template <auto Member, unsigned Cost = 1>
+struct Field
+{
+    using Value = remove_cvref_t<decltype(declval<const Product&>().*Member)>;
+
+    friend constexpr auto operator==(Field, Value value) { return Compare<Member, equal_to<>, Cost>(value); }
+    friend constexpr auto operator!=(Field, Value value) { return Compare<Member, not_equal_to<>, Cost>(value); }
+};
+
+namespace fields
+{
+    inline constexpr Field<&Product::color> color{};
+    inline constexpr Field<&Product::size> size{};
+}
+
+struct NameContains : Expression<NameContains>
+{
+    static constexpr unsigned cost = 16;
+
+    string needle;
+    explicit NameContains(string needle) : needle(move(needle)) {}
+
+    bool operator()(const Product& item) const
+    {
+        return item.name.find(needle) != string::npos;
+    }
+};
+
+inline NameContains name_contains(string needle)
+{
+    return NameContains(move(needle));
+}
+
+template <SpecExpression L, SpecExpression R>
+struct And : Expression<And<L, R>>
+{
+    static constexpr unsigned cost = L::cost + R::cost;
+
+    L left;
+    R right;
+    And(L left, R right) : left(move(left)), right(move(right)) {}
+
+    bool operator()(const Product& item) const
+    {
+        if constexpr (R::cost < L::cost)
+            return right(item) && left(item);
+        else
+            return left(item) && right(item);
+    }
+};
+
+template <SpecExpression L, SpecExpression R>
+struct Or : Expression<Or<L, R>>
+{
+    static constexpr unsigned cost = L::cost + R::cost;
+
+    L left;
+    R right;
+    Or(L left, R right) : left(move(left)), right(move(right)) {}
+
+    bool operator()(const Product& item) const
+    {
+        if constexpr (R::cost < L::cost)
+            return right(item) || left(item);
+        else
+            return left(item) || right(item);
+    }
+};
+
+template <SpecExpression E>
+struct Not : Expression<Not<E>>
+{
+    static constexpr unsigned cost = E::cost;
+
+    E expr;
+    explicit Not(E expr) : expr(move(expr)) {}
+
+    bool operator()(const Product& item) const
+    {
+        return !expr(item);
+    }
+};
+
+// Overrides the cost And/Or use to order their children.
+template <unsigned Cost, SpecExpression E>
+struct WithCost : Expression<WithCost<Cost, E>>
+{
+    static constexpr unsigned cost = Cost;
+
+    E expr;
+    explicit WithCost(E expr) : expr(move(expr)) {}
+
+    bool operator()(const Product& item) const
+    {
+        return expr(item);
+    }
+};
+
+template <unsigned Cost, SpecExpression E>
+WithCost<Cost, E> with_cost(E expr)
+{
+    return WithCost<Cost, E>(move(expr));
+}
+
+template <SpecExpression L, SpecExpression R>
+And<L, R> operator&&(L left, R right)
+{
+    return And<L, R>(move(left), move(right));
+}
+
+template <SpecExpression L, SpecExpression R>
+Or<L, R> operator||(L left, R right)
+{
+    return Or<L, R>(move(left), move(right));
+}
+
+template <SpecExpression E>
+Not<E> operator!(E expr)
+{
+    return Not<E>(move(expr));
+}
+
+// Filters with a fused expression: the whole query is inlined into this loop.
+struct ExpressionFilter
+{
+    template <SpecExpression E>
+    vector<Product*> Filter(span<Product* const> items, const E& spec) const
+    {
+        vector<Product*> result;
+        for (auto& item : items)
+        {
+            if (spec(*item))
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Type erasure for queries built at run time
+
+class AnySpecification : public ISpecification<Product>
+{
+public:
+    static constexpr size_t block_size = 1024;
+    using Index = uint16_t;
+
+    template <SpecExpression E>
+    AnySpecification(E expr) : impl(make_shared<const Model<E>>(move(expr))) {}
+
+    bool IsSatisfied(Product* item) override
+    {
+        return impl->Test(*item);
+    }
+
+    // Static cost of a wrapped expression; runtime combinators add up their children like And/Or do.
+    unsigned Cost() const
+    {
+        return impl->cost;
+    }
+
+    vector<Product*> Filter(span<Product* const> items) const
+    {
+        vector<Product*> result;
+        Index candidates[block_size];
+        Index selected[block_size];
+        for (size_t i = 0; i < block_size; ++i)
+        {
+            candidates[i] = static_cast<Index>(i);
+        }
+        for (size_t start = 0; start < items.size(); start += block_size)
+        {
+            auto block = items.subspan(start, min(block_size, items.size() - start));
+            size_t n = impl->Select(block, candidates, block.size(), selected);
+            for (size_t i = 0; i < n; ++i)
+            {
+                result.push_back(block[selected[i]]);
+            }
+        }
+        return result;
+    }
+
+    friend AnySpecification operator&&(AnySpecification left, AnySpecification right)
+    {
+        return AnySpecification(make_shared<const AndNode>(CheapFirst(move(left), move(right))));
+    }
+
+    friend AnySpecification operator||(AnySpecification left, AnySpecification right)
+    {
+        return AnySpecification(make_shared<const OrNode>(CheapFirst(move(left), move(right))));
+    }
+
+    friend AnySpecification operator!(AnySpecification spec)
+    {
+        return AnySpecification(make_shared<const NotNode>(move(spec.impl)));
+    }
+
+private:
+    struct Concept
+    {
+        unsigned cost;
+        explicit Concept(unsigned cost) : cost(cost) {}
+        virtual ~Concept() = default;
+
+        virtual bool Test(const Product& item) const = 0;
+
+        // Writes to `out`, in ascending order, the candidates (indices into `block`) that satisfy the specification.
+        // `out` may alias `in`.
+        virtual size_t Select(span<Product* const> block, const Index* in, size_t count, Index* out) const = 0;
+    };
+
+    template <typename E>
+    struct Model : Concept
+    {
+        E expr;
+        explicit Model(E expr) : Concept(E::cost), expr(move(expr)) {}
+
+        bool Test(const Product& item) const override
+        {
+            return expr(item);
+        }
+
+        size_t Select(span<Product* const> block, const Index* in, size_t count, Index* out) const override
+        {
+            size_t n = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                Index index = in[i];
+                out[n] = index;
+                n += expr(*block[index]) ? 1 : 0;
+            }
+            return n;
+        }
+    };
+
+    using Node = shared_ptr<const Concept>;
+
+    // Ordered pair for runtime combinators: the cheaper child runs first.
+    static pair<Node, Node> CheapFirst(AnySpecification left, AnySpecification right)
+    {
+        if (right.Cost() < left.Cost())
+            return { move(right.impl), move(left.impl) };
+        return { move(left.impl), move(right.impl) };
+    }
+
+    // Candidates in `all` that are not in `subset`; both ascending.
+    static size_t Difference(const Index* all, size_t all_count, const Index* subset, size_t subset_count, Index* out)
+    {
+        size_t n = 0, j = 0;
+        for (size_t i = 0; i < all_count; ++i)
+        {
+            if (j < subset_count && subset[j] == all[i])
+                ++j;
+            else
+                out[n++] = all[i];
+        }
+        return n;
+    }
+
+    struct AndNode : Concept
+    {
+        Node first, second;
+        explicit AndNode(pair<Node, Node> ordered)
+            : Concept(ordered.first->cost + ordered.second->cost), first(move(ordered.first)), second(move(ordered.second)) {}
+
+        bool Test(const Product& item) const override
+        {
+            return first->Test(item) && second->Test(item);
+        }
+
+        size_t Select(span<Product* const> block, const Index* in, size_t count, Index* out) const override
+        {
+            size_t n = first->Select(block, in, count, out);
+            return n == 0 ? 0 : second->Select(block, out, n, out);
+        }
+    };
+
+    struct OrNode : Concept
+    {
+        Node first, second;
+        explicit OrNode(pair<Node, Node> ordered)
+            : Concept(ordered.first->cost + ordered.second->cost), first(move(ordered.first)), second(move(ordered.second)) {}
+
+        bool Test(const Product& item) const override
+        {
+            return first->Test(item) || second->Test(item);
+        }
+
+        size_t Select(span<Product* const> block, const Index* in, size_t count, Index* out) const override
+        {
+            Index accepted[block_size];
+            Index rest[block_size];
+            size_t a = first->Select(block, in, count, accepted);
+            size_t r = Difference(in, count, accepted, a, rest);
+            size_t b = r == 0 ? 0 : second->Select(block, rest, r, rest);
+            // Merge the two ascending selections.
+            return static_cast<size_t>(merge(accepted, accepted + a, rest, rest + b, out) - out);
+        }
+    };
+
+    struct NotNode : Concept
+    {
+        Node spec;
+        explicit NotNode(Node spec) : Concept(spec->cost), spec(move(spec)) {}
+
+        bool Test(const Product& item) const override
+        {
+            return !spec->Test(item);
+        }
+
+        size_t Select(span<Product* const> block, const Index* in, size_t count, Index* out) const override
+        {
+            Index accepted[block_size];
+            size_t a = spec->Select(block, in, count, accepted);
+            return Difference(in, count, accepted, a, out);
+        }
+    };
+
+    explicit AnySpecification(shared_ptr<const Concept> impl) : impl(move(impl)) {}
+
+    shared_ptr<const Concept> impl;
+};
+
+// Parses queries such as "color == green && size != small || name ~ oak" into an AnySpecification.
+// Clauses are `color`/`size` with == or !=, or `name ~ text`; && binds tighter than ||; no parentheses.
+struct QueryParser
+{
+    static AnySpecification Parse(string_view query)
+    {
+        vector<AnySpecification> alternatives;
+        for (string_view alternative : Split(query, "||"))
+        {
+            vector<AnySpecification> clauses;
+            for (string_view clause : Split(alternative, "&&"))
+            {
+                clauses.push_back(ParseClause(Trim(clause)));
+            }
+            AnySpecification conjunction = clauses.front();
+            for (size_t i = 1; i < clauses.size(); ++i)
+            {
+                conjunction = conjunction && clauses[i];
+            }
+            alternatives.push_back(conjunction);
+        }
+        AnySpecification result = alternatives.front();
+        for (size_t i = 1; i < alternatives.size(); ++i)
+        {
+            result = result || alternatives[i];
+        }
+        return result;
+    }
+
+private:
+    static vector<string_view> Split(string_view text, string_view separator)
+    {
+        vector<string_view> parts;
+        size_t start = 0;
+        for (size_t at; (at = text.find(separator, start)) != string_view::npos; start = at + separator.size())
+        {
+            parts.push_back(text.substr(start, at - start));
+        }
+        parts.push_back(text.substr(start));
+        return parts;
+    }
+
+    static string_view Trim(string_view text)
+    {
+        size_t first = text.find_first_not_of(' ');
+        size_t last = text.find_last_not_of(' ');
+        return first == string_view::npos ? string_view() : text.substr(first, last - first + 1);
+    }
+
+    static AnySpecification ParseClause(string_view clause)
+    {
+        size_t op_at = clause.find_first_of("=!~");
+        if (op_at == string_view::npos)
+            throw invalid_argument("expected ==, != or ~ in '" + string(clause) + "'");
+        string_view field = Trim(clause.substr(0, op_at));
+        bool negate = clause[op_at] == '!';
+        size_t op_length = clause[op_at] == '~' ? 1 : 2;
+        string_view value = Trim(clause.substr(op_at + op_length));
+
+        if (field == "name" && clause[op_at] == '~')
+            return name_contains(string(value));
+        if (field == "color")
+        {
+            Color color = ParseColor(value);
+            return negate ? AnySpecification(fields::color != color) : AnySpecification(fields::color == color);
+        }
+        if (field == "size")
+        {
+            Size size = ParseSize(value);
+            return negate ? AnySpecification(fields::size != size) : AnySpecification(fields::size == size);
+        }
+        throw invalid_argument("unknown clause '" + string(clause) + "'");
+    }
+
+    static Color ParseColor(string_view value)
+    {
+        if (value == "red") return Color::red;
+        if (value == "green") return Color::green;
+        if (value == "blue") return Color::blue;
+        throw invalid_argument("unknown color '" + string(value) + "'");
+    }
+
+    static Size ParseSize(string_view value)
+    {
+        if (value == "small") return Size::small;
+        if (value == "medium") return Size::medium;
+        if (value == "large") return Size::large;
+        throw invalid_argument("unknown size '" + string(value) + "'");
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+vector<Product*> FilterVirtual(span<Product* const> items, ISpecification<Product>& spec)
+{
+    // BetterFilter's loop without its copy of the input, so only predicate evaluation is compared.
+    vector<Product*> result;
+    for (auto& item : items)
+    {
+        if (spec.IsSatisfied(item))
+        {
+            result.push_back(item);
+        }
+    }
+    return result;
+}
+
+template <typename Run>
+void Measure(const char* query, const char* variant, size_t items, size_t expected, Run run)
+{
+    using Clock = chrono::steady_clock;
+    double best = 1e300;
+    size_t matches = 0;
+    // Each trial repeats the query over at least ~4M items so small catalogs are timed over a measurable interval.
+    const size_t repeats = max<size_t>(1, 4'000'000 / items);
+    for (int trial = 0; trial < 5; ++trial)
+    {
+        auto start = Clock::now();
+        for (size_t r = 0; r < repeats; ++r)
+        {
+            matches = run().size();
+        }
+        best = min(best, chrono::duration<double, nano>(Clock::now() - start).count() / repeats);
+    }
+    printf("%-34s %-34s %8.2f ns/item %9zu matches%s\n", query, variant, best / items, matches, matches == expected ? "" : "  MISMATCH");
+}
+
+void RunBenchmark(size_t n)
+{
+    const auto& color = fields::color;
+    const auto& size = fields::size;
+
+    const char* woods[] = { "Pine", "Birch", "Maple", "Walnut", "Cherry", "Ash", "Elm", "Oak" };
+    const char* kinds[] = { "Table", "Chair", "Shelf", "Desk", "Stool", "Bench", "Cabinet", "Bed" };
+    mt19937 rng(42);
+    vector<Product> catalog;
+    catalog.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        // Long names so the substring search is clearly the expensive predicate.
+        catalog.push_back({ string(woods[rng() % 8]) + " " + kinds[rng() % 8] + " #" + to_string(i) + " (solid, hand-finished)",
+                            static_cast<Color>(rng() % 3), static_cast<Size>(rng() % 3) });
+    }
+    vector<Product*> all;
+    all.reserve(n);
+    for (auto& product : catalog)
+    {
+        all.push_back(&product);
+    }
+    // Shuffle so products are not visited in allocation order.
+    shuffle(all.begin(), all.end(), rng);
+    span<Product* const> view(all);
+
+    printf("\n%zu products, best of 5\n", n);
+
+    ExpressionFilter ef;
+
+    ColorSpecification green(Color::green), red(Color::red), blue(Color::blue);
+    SizeSpecification small(Size::small), large(Size::large);
+    NameContainsSpecification oak_name("Oak");
+    NotSpecification not_small(small);
+
+    {
+        const char* q = "green && !small";
+        AndSpecification nested(green, not_small);
+        auto fused = color == Color::green && size != Size::small;
+        AnySpecification erased = fused;
+        AnySpecification parsed = QueryParser::Parse("color == green && size != small");
+        size_t expected = FilterVirtual(view, nested).size();
+
+        Measure(q, "nested virtual", n, expected, [&] { return FilterVirtual(view, nested); });
+        Measure(q, "fused expression", n, expected, [&] { return ef.Filter(view, fused); });
+        Measure(q, "AnySpecification, per item", n, expected, [&] { return FilterVirtual(view, erased); });
+        Measure(q, "AnySpecification, blocks", n, expected, [&] { return erased.Filter(view); });
+        Measure(q, "parsed at run time, blocks", n, expected, [&] { return parsed.Filter(view); });
+    }
+    {
+        const char* q = "green && !small || red && large";
+        AndSpecification left(green, not_small);
+        AndSpecification right(red, large);
+        OrSpecification nested(left, right);
+        auto fused = (color == Color::green && size != Size::small) || (color == Color::red && size == Size::large);
+        AnySpecification erased = fused;
+        AnySpecification parsed = QueryParser::Parse("color == green && size != small || color == red && size == large");
+        size_t expected = FilterVirtual(view, nested).size();
+
+        Measure(q, "nested virtual", n, expected, [&] { return FilterVirtual(view, nested); });
+        Measure(q, "fused expression", n, expected, [&] { return ef.Filter(view, fused); });
+        Measure(q, "AnySpecification, per item", n, expected, [&] { return FilterVirtual(view, erased); });
+        Measure(q, "AnySpecification, blocks", n, expected, [&] { return erased.Filter(view); });
+        Measure(q, "parsed at run time, blocks", n, expected, [&] { return parsed.Filter(view); });
+    }
+    {
+        // Written expensive-first: the cost hints move the color test in front of the substring search.
+        const char* q = "name ~ Oak && blue";
+        AndSpecification nested(oak_name, blue);
+        auto fused = name_contains("Oak") && color == Color::blue;
+        auto forced = with_cost<0>(name_contains("Oak")) && color == Color::blue;
+        AnySpecification parsed = QueryParser::Parse("name ~ Oak && color == blue");
+        size_t expected = FilterVirtual(view, nested).size();
+
+        Measure(q, "nested virtual (as written)", n, expected, [&] { return FilterVirtual(view, nested); });
+        Measure(q, "fused, reordered by cost", n, expected, [&] { return ef.Filter(view, fused); });
+        Measure(q, "fused, with_cost<0> keeps order", n, expected, [&] { return ef.Filter(view, forced); });
+        Measure(q, "parsed at run time, blocks", n, expected, [&] { return parsed.Filter(view); });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Local names for the placeholders; `size` would otherwise be ambiguous with std::size.
+    const auto& color = fields::color;
+    const auto& size = fields::size;
+
+    Product apple{ "Apple", Color::green, Size::small };
+    Product tree{ "Tree", Color::green, Size::large };
+    Product house{ "House", Color::blue, Size::large };
+    Product oak{ "Oak Table", Color::red, Size::large };
+
+    vector<Product*> items{ &apple, &tree, &house, &oak };
+
+    ExpressionFilter ef;
+    auto query = (color == Color::green && size != Size::small) || name_contains("Oak");
+    for (auto& item : ef.Filter(items, query))
+    {
+        cout << item->name << " is green and not small, or oak." << endl;
+    }
+
+    // A runtime-built query plugs into the original BetterFilter through ISpecification.
+    BetterFilter bf;
+    AnySpecification large_blue = QueryParser::Parse("size == large && color == blue");
+    for (auto& item : bf.Filter(items, large_blue))
+    {
+        cout << item->name << " is large and blue." << endl;
+    }
+
+    // A catalog that fits in cache shows the cost of evaluation itself; a large one adds a cache miss per product.
+    RunBenchmark(8'192);
+    RunBenchmark(argc > 1 ? stoull(argv[1]) : 2'000'000);
+
+    return 0;
+}
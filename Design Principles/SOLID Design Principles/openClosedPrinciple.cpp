@@ -11,6 +11,8 @@
 #include<vector>
 #include<fstream>
 
+#include "../../Common/Tracing.h"
+
 using namespace std;
 
 enum class Color { red, green, blue };
@@ -62,6 +64,7 @@ struct BetterFilter : IFilter<Product>
 {
     vector<Product*> Filter(vector<Product*> items, ISpecification<Product>& spec) override
     {
+        TRACE_SCOPE("BetterFilter::Filter");
         vector<Product*> result;
         for (auto& item : items)
         {
@@ -70,6 +73,7 @@ struct BetterFilter : IFilter<Product>
                 result.push_back(item);
             }
         }
+        TRACE_COUNTER("BetterFilter::Filter matches", result.size());
         return result;
     }
 };
@@ -89,6 +93,8 @@ struct ColorSpecification : ISpecification<Product>
 
 int main()
 {
+    tracing::Session trace_session;
+
     Product apple{ "Apple", Color::green, Size::small };
     Product tree{ "Tree", Color::green, Size::large };
     Product house{ "House", Color::blue, Size::large };